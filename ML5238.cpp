@@ -0,0 +1,454 @@
+#include "ML5238.h"
+#include "ML5238_balance.h"
+#include "ML5238_guard.h"
+#include "ML5238_regs.h"
+
+namespace drivers {
+
+using namespace ml5238;
+
+namespace {
+
+// Typical NMC open circuit voltage, SOC 0%..100% in 10% steps
+const uint16_t OCV_MV[11] = { 3000, 3450, 3550, 3600, 3650, 3700, 3780, 3870, 3960, 4060, 4180 };
+
+ML5238_TopBalance default_policy;
+
+}  // namespace
+
+ML5238::ML5238(ML5238_Port &port)
+    : _port(port), _policy(&default_policy), _guard(nullptr), _imon_zero_mV(IMON_OFFSET_MV), _charge_mAs(0), _charge_rem_mAus(0),
+      _transactions(0), _scan_next(0), _calibrating(false), _charge_on(false), _discharge_on(false) {
+    _state = ML5238_State();
+    for (uint8_t i = 0; i < REG_COUNT; ++i) _reg[i] = REG_RESET[i];
+}
+
+void ML5238::begin(const ML5238_Config &cfg) {
+    start(cfg, nullptr, 0);
+}
+
+void ML5238::begin(const ML5238_Config &cfg, const ML5238_Retained &kept, uint16_t tolerance_mV) {
+    start(cfg, &kept, tolerance_mV);
+}
+
+ML5238_Retained ML5238::retained() const {
+    ML5238_Retained r;
+    r.charge_mAs = _charge_mAs;
+    r.imon_zero_mV = _imon_zero_mV;
+    r.mean_mV = _state.mean_mV;
+    return r;
+}
+
+void ML5238::start(const ML5238_Config &cfg, const ML5238_Retained *kept, uint16_t tolerance_mV) {
+    _cfg = cfg;
+    _state = ML5238_State();
+    _low.clear();
+    _high.clear();
+    _spread.clear();
+    _charge_on = false;
+    _discharge_on = false;
+    if (_guard) _guard->reset();
+
+    write(REG_FET, 0);
+    write(REG_CBALH, 0);
+    write(REG_CBALL, 0);
+    write(REG_VMON, 0);
+    write(REG_SETSC, _cfg.setsc & SETSC_MASK);
+    write(REG_RSENSE, RSENSE_ESC | RSENSE_ISC);
+
+    if (kept) {
+        write(REG_IMON, (uint8_t)(IMON_OUT | (_cfg.gim ? IMON_GIM : 0)));
+        _imon_zero_mV = kept->imon_zero_mV;
+    } else {
+        calibrate_current();
+    }
+    read_status();
+    measure_current();
+    scan_cells();
+
+    const int32_t drift = kept ? (int32_t)_state.mean_mV - kept->mean_mV : 0;
+    const int32_t full = (int32_t)(_cfg.capacity_mAh * 3600);
+    if (kept && drift <= (int32_t)tolerance_mV && drift >= -(int32_t)tolerance_mV && kept->charge_mAs <= full) {
+        _charge_mAs = kept->charge_mAs;
+        _state.soc_permille = full ? (uint16_t)((int64_t)_charge_mAs * 1000 / full) : 0;
+    } else {
+        _state.soc_permille = ocv_soc_permille(_state.mean_mV);
+        _charge_mAs = (int32_t)((uint64_t)_cfg.capacity_mAh * 3600 * _state.soc_permille / 1000);
+    }
+    _charge_rem_mAus = 0;
+    _state.time_us = _port.micros();
+    protect();
+}
+
+uint8_t ML5238::read(uint8_t reg) {
+    if (reg >= REG_COUNT) return 0;
+    uint8_t tx[2] = { spi_cmd(reg, SPI_READ), 0 };
+    uint8_t rx[2] = { 0, 0 };
+    _port.transfer(tx, rx, 1);
+    ++_transactions;
+    if (_guard) _guard->was_read(reg, rx[1], _port.micros());
+    return rx[1];
+}
+
+bool ML5238::write(uint8_t reg, uint8_t val) {
+    uint32_t now = 0;
+    if (_guard) {
+        now = _port.micros();
+        const uint8_t rule = _guard->check_write(reg, val, now);
+        if (rule != ML5238_RULE_OK) {
+            _guard->refused(rule);
+            return false;
+        }
+    }
+    if (reg >= REG_COUNT) return false;     // TEST registers are never touched
+    uint8_t tx[2] = { spi_cmd(reg, SPI_WRITE), val };
+    _port.transfer(tx, 0, 1);
+    ++_transactions;
+    _reg[reg] = val;
+    if (_guard) _guard->wrote(reg, val, now);
+    return true;
+}
+
+void ML5238::update(uint8_t reg, uint8_t val) {
+    if (reg < REG_COUNT && _reg[reg] != val) write(reg, val);
+}
+
+void ML5238_Batch::compile() {
+    _checked = false;
+    for (uint8_t f = 0; f < _n; ++f)
+        if (!is_read(f) && ML5238_Guard::has_rules(reg(f))) _checked = true;
+    _compiled = true;
+}
+
+bool ML5238::run(ML5238_Batch &batch) {
+    if (!batch._n) return true;
+    uint32_t now = 0;
+    if (_guard) {
+        now = _port.micros();
+        const uint8_t rule = batch._compiled && !batch._checked ? (uint8_t)ML5238_RULE_OK : _guard->check(batch, now);
+        if (rule != ML5238_RULE_OK) {
+            _guard->refused(rule);
+            return false;
+        }
+    }
+    _port.transfer(batch._tx, batch._rx, batch._n);
+    _transactions += batch._n;
+    for (uint8_t f = 0; f < batch._n; ++f)
+        if (!batch.is_read(f)) _reg[batch.reg(f)] = batch.data(f);
+    if (_guard) _guard->apply(batch, now);
+    return true;
+}
+
+void ML5238::scan_cells() {
+    // A cell with its balancing switch on reads as the drop over the switch
+    const uint16_t bal = _state.balance;
+    if (bal) {
+        write(REG_CBALH, 0);
+        write(REG_CBALL, 0);
+    }
+    const uint16_t mask = cells();
+    for (uint8_t i = 0; i < CELLS_MAX; ++i) {
+        if (!(mask & (1U << i))) {
+            _state.cell_mV[i] = 0;
+            continue;
+        }
+        write(REG_VMON, vmon_select(i));
+        _port.delay_us(_cfg.vmon_settle_us);
+        _state.cell_mV[i] = (uint16_t)(_port.vmon_mV() * VMON_GAIN_DIV);
+    }
+    write(REG_VMON, 0);
+    take_scan();
+    if (bal) {
+        write(REG_CBALH, balance_h(bal));
+        write(REG_CBALL, balance_l(bal));
+    }
+}
+
+void ML5238::take_scan() {
+    const uint16_t mask = cells();
+    ML5238_ScanStats st;
+    for (uint8_t i = 0; i < CELLS_MAX; ++i)
+        if (mask & (1U << i)) st.add(i, _state.cell_mV[i]);
+    _state.min_mV = st.n ? st.min_mV : 0;
+    _state.max_mV = st.max_mV;
+    _state.mean_mV = st.mean_mV();
+    _state.spread_mV = st.spread_mV();
+    _state.min_cell = st.min_cell;
+    _state.max_cell = st.max_cell;
+    _low.push(_state.min_mV);
+    _high.push(_state.max_mV);
+    _spread.push(_state.spread_mV);
+    _state.low_mV = _low.value();
+    _state.high_mV = _high.value();
+    _state.spread_max_mV = _spread.value();
+}
+
+void ML5238::measure_current() {
+    take_current(_port.imon_mV());
+}
+
+int32_t ML5238::imon_to_mA(uint16_t imon_mV) const {
+    const int32_t gain = _cfg.gim ? IMON_GAIN_HI : IMON_GAIN_LO;
+    const int32_t dv_mV = (int32_t)imon_mV - _imon_zero_mV;
+    // VIMON = (ISENSE x RSENSE) x GIM + 1.0
+    return (int32_t)((int64_t)dv_mV * 1000000 / ((int32_t)_cfg.rsense_uohm * gain));
+}
+
+void ML5238::take_current(uint16_t imon_mV) {
+    _state.current_mA = imon_to_mA(imon_mV);
+}
+
+void ML5238::read_status() {
+    take_status(read(REG_STATUS));
+}
+
+void ML5238::take_status(uint8_t status) {
+    _state.status = status;
+    // The LSI clears DF and CF on its own after a short, follow the pin state
+    _reg[REG_FET] = (uint8_t)((_reg[REG_FET] & FET_DRV) | (_state.status & (STATUS_DF | STATUS_CF)));
+    if (_state.status & STATUS_RSC) {
+        _state.faults |= ML5238_FAULT_SC;
+        // RSC is cleared by writing 0, RRS written as 1 is neglected
+        write(REG_RSENSE, _reg[REG_RSENSE] | RSENSE_RRS);
+        _reg[REG_RSENSE] &= (uint8_t)~RSENSE_RRS;
+    }
+}
+
+void ML5238::clear_interrupts(uint8_t status) {
+    // Writing 0 clears a flag, 1 keeps it, so flags not asked for are written as 1
+    if (status & (STATUS_RPSL | STATUS_RPSH)) {
+        uint8_t v = (uint8_t)(_reg[REG_PSENSE] & ~(PSENSE_RPSL | PSENSE_RPSH));
+        if (!(status & STATUS_RPSL)) v |= PSENSE_RPSL;
+        if (!(status & STATUS_RPSH)) v |= PSENSE_RPSH;
+        write(REG_PSENSE, v);
+        _reg[REG_PSENSE] &= (uint8_t)~(PSENSE_RPSL | PSENSE_RPSH);
+    }
+    if (status & STATUS_RRS) {
+        // RSC belongs to take_status()
+        write(REG_RSENSE, (uint8_t)((_reg[REG_RSENSE] & ~RSENSE_RRS) | RSENSE_RSC));
+        _reg[REG_RSENSE] &= (uint8_t)~(RSENSE_RRS | RSENSE_RSC);
+    }
+}
+
+void ML5238::set_fets(bool charge, bool discharge) {
+    _charge_on = charge;
+    _discharge_on = discharge;
+    apply_fets();
+}
+
+void ML5238::apply_fets() {
+    uint8_t fet = 0;
+    if (_charge_on && !(_state.faults & (ML5238_FAULT_OV | ML5238_FAULT_OCC | ML5238_FAULT_SC)))
+        fet |= FET_CF;
+    if (_discharge_on && !(_state.faults & (ML5238_FAULT_UV | ML5238_FAULT_OCD | ML5238_FAULT_SC)))
+        fet |= FET_DF;
+    update(REG_FET, fet);
+}
+
+void ML5238::set_balance(uint16_t mask) {
+    mask &= cells();
+    if (!balance_legal(mask)) mask = select_balance(mask);
+    // SW8 and SW9 are neighbours, the pair must stay legal between the two writes
+    const uint16_t old = _state.balance;
+    if (!balance_legal((uint16_t)((mask & 0xFF00) | (old & 0x00FF)))) {
+        update(REG_CBALL, balance_l(mask));
+        update(REG_CBALH, balance_h(mask));
+    } else {
+        update(REG_CBALH, balance_h(mask));
+        update(REG_CBALL, balance_l(mask));
+    }
+    _state.balance = mask;
+}
+
+void ML5238::set_balance_policy(ML5238_BalancePolicy *policy) {
+    _policy = policy ? policy : &default_policy;
+}
+
+void ML5238::calibrate_current() {
+    start_calibration();
+    _port.delay_us(1000);
+    finish_calibration();
+}
+
+void ML5238::start_calibration() {
+    // Zero correction: ISP and ISM inputs at GND level
+    write(REG_IMON, (uint8_t)(IMON_OUT | IMON_ZERO | (_cfg.gim ? IMON_GIM : 0)));
+    _calibrating = true;
+}
+
+void ML5238::finish_calibration() {
+    if (!_calibrating) return;
+    _imon_zero_mV = _port.imon_mV();
+    write(REG_IMON, (uint8_t)(IMON_OUT | (_cfg.gim ? IMON_GIM : 0)));
+    _calibrating = false;
+}
+
+void ML5238::set_power_save(bool on) {
+    update(REG_POWER, (uint8_t)((_reg[REG_POWER] & ~POWER_PSV) | (on ? POWER_PSV : 0)));
+}
+
+void ML5238::clear_faults() {
+    _state.faults = 0;
+    protect();
+}
+
+uint16_t ML5238::select_balance(uint16_t candidates) const {
+    uint16_t out = 0;
+    while (candidates) {
+        uint8_t top = 0;
+        uint16_t top_mV = 0;
+        for (uint8_t i = 0; i < CELLS_MAX; ++i) {
+            if ((candidates & (1U << i)) && _state.cell_mV[i] >= top_mV) {
+                top = i;
+                top_mV = _state.cell_mV[i];
+            }
+        }
+        candidates &= (uint16_t)~(1U << top);
+        if (balance_legal(out | (1U << top))) out |= (uint16_t)(1U << top);
+    }
+    return out;
+}
+
+void ML5238::protect() {
+    const uint16_t max_mV = _state.max_mV, min_mV = _state.min_mV;
+    uint8_t &f = _state.faults;
+    if (max_mV >= _cfg.cell_ov_mV) f |= ML5238_FAULT_OV;
+    else if (max_mV + _cfg.hysteresis_mV < _cfg.cell_ov_mV) f &= (uint8_t)~ML5238_FAULT_OV;
+    if (min_mV <= _cfg.cell_uv_mV) f |= ML5238_FAULT_UV;
+    else if (min_mV > _cfg.cell_uv_mV + _cfg.hysteresis_mV) f &= (uint8_t)~ML5238_FAULT_UV;
+    if (_state.current_mA > _cfg.charge_oc_mA) f |= ML5238_FAULT_OCC;
+    if (-_state.current_mA > _cfg.discharge_oc_mA) f |= ML5238_FAULT_OCD;
+    apply_fets();
+}
+
+void ML5238::balance() {
+    set_balance(_state.faults ? 0 : _policy->decide(_state, _cfg, cells()));
+}
+
+void ML5238::update_soc(uint32_t dt_us) {
+    const int64_t q = (int64_t)_state.current_mA * dt_us + _charge_rem_mAus;
+    _charge_mAs += (int32_t)(q / 1000000);
+    _charge_rem_mAus = (int32_t)(q % 1000000);
+    const int32_t full = (int32_t)(_cfg.capacity_mAh * 3600);
+    if (_charge_mAs < 0) _charge_mAs = 0;
+    if (_charge_mAs > full) _charge_mAs = full;
+    _state.soc_permille = full ? (uint16_t)((int64_t)_charge_mAs * 1000 / full) : 0;
+}
+
+void ML5238::tick() {
+    const uint32_t now = _port.micros();
+    read_status();
+    if (_guard && _guard->drv_overdue(now)) update(REG_FET, (uint8_t)(_reg[REG_FET] & ~FET_DRV));
+    measure_current();
+    update_soc(now - _state.time_us);
+    scan_cells();
+    protect();
+    balance();
+    _state.time_us = now;
+}
+
+void ML5238::protect_step() {
+    const uint32_t now = _port.micros();
+    read_status();
+    if (_guard && _guard->drv_overdue(now)) update(REG_FET, (uint8_t)(_reg[REG_FET] & ~FET_DRV));
+    if (!_calibrating) measure_current();
+    update_soc(now - _state.time_us);
+    protect();
+    _state.time_us = now;
+}
+
+bool ML5238::scan_step(uint8_t n) {
+    const uint16_t mask = cells();
+    const uint16_t bal = _state.balance;
+    if (bal) {
+        write(REG_CBALH, 0);
+        write(REG_CBALL, 0);
+    }
+    for (; n && _scan_next < CELLS_MAX; ++_scan_next) {
+        if (!(mask & (1U << _scan_next))) {
+            _state.cell_mV[_scan_next] = 0;
+            continue;
+        }
+        write(REG_VMON, vmon_select(_scan_next));
+        _port.delay_us(_cfg.vmon_settle_us);
+        _state.cell_mV[_scan_next] = (uint16_t)(_port.vmon_mV() * VMON_GAIN_DIV);
+        --n;
+    }
+    // Skip unused cells at the top so the last step finishes the scan
+    while (_scan_next < CELLS_MAX && !(mask & (1U << _scan_next))) _state.cell_mV[_scan_next++] = 0;
+    write(REG_VMON, 0);
+    if (bal) {
+        write(REG_CBALH, balance_h(bal));
+        write(REG_CBALL, balance_l(bal));
+    }
+    if (_scan_next < CELLS_MAX) return false;
+    _scan_next = 0;
+    take_scan();
+    return true;
+}
+
+bool ML5238::compile_cycle(ML5238_Chain &c) const {
+    c.clear();
+    c.status_desc = c.read(REG_STATUS);
+    c.add(ML5238_DESC_IMON, ML5238_Chain::SAMPLE_IMON, 0);
+    // A cell with its balancing switch on reads as the drop over the switch
+    c.write(REG_CBALH, 0);
+    c.write(REG_CBALL, 0);
+    const uint16_t mask = cells();
+    for (uint8_t i = 0; i < CELLS_MAX; ++i) {
+        if (!(mask & (1U << i))) continue;
+        c.write(REG_VMON, vmon_select(i));
+        c.add(ML5238_DESC_WAIT, 0, _cfg.vmon_settle_us);
+        c.add(ML5238_DESC_VMON, i, 0);
+    }
+    c.write(REG_VMON, 0);
+    // From all off to a legal mask every intermediate state is legal
+    c.cbalh_desc = c.write(REG_CBALH, 0);
+    c.cball_desc = c.write(REG_CBALL, 0);
+    return c.add(ML5238_DESC_END, 0, 0) >= 0;
+}
+
+bool ML5238::start_cycle(ML5238_DmaEngine &dma, ML5238_Chain &chain, ML5238_DmaDone done, void *ctx) {
+    if (chain.cbalh_desc < 0 || chain.cball_desc < 0) return false;
+    chain.patch((uint8_t)chain.cbalh_desc, balance_h(_state.balance));
+    chain.patch((uint8_t)chain.cball_desc, balance_l(_state.balance));
+    return dma.start(chain, done, ctx);
+}
+
+void ML5238::finish_cycle(const ML5238_Chain &c) {
+    const uint32_t now = _port.micros();
+    for (uint8_t i = 0; i < c.size(); ++i) {
+        const ML5238_Desc &d = c.desc(i);
+        if (d.op != ML5238_DESC_SPI) continue;
+        const uint8_t reg = spi_reg(d.arg);
+        ++_transactions;
+        if (d.arg & SPI_READ) {
+            if (_guard) _guard->was_read(reg, c.rx(i), now);
+        } else if (reg < REG_COUNT) {
+            _reg[reg] = (uint8_t)d.data;
+            if (_guard) _guard->wrote(reg, (uint8_t)d.data, now);
+        }
+    }
+    if (c.status_desc >= 0) take_status(c.rx((uint8_t)c.status_desc));
+    if (_guard && _guard->drv_overdue(now)) update(REG_FET, (uint8_t)(_reg[REG_FET] & ~FET_DRV));
+    take_current(c.sample(ML5238_Chain::SAMPLE_IMON));
+    update_soc(now - _state.time_us);
+    const uint16_t mask = cells();
+    for (uint8_t i = 0; i < CELLS_MAX; ++i)
+        _state.cell_mV[i] = mask & (1U << i) ? (uint16_t)(c.sample(i) * VMON_GAIN_DIV) : 0;
+    take_scan();
+    protect();
+    balance();
+    _state.time_us = now;
+}
+
+uint16_t ML5238::ocv_soc_permille(uint16_t mV) {
+    if (mV <= OCV_MV[0]) return 0;
+    for (uint8_t i = 1; i < 11; ++i) {
+        if (mV < OCV_MV[i])
+            return (uint16_t)((i - 1) * 100 + (uint32_t)(mV - OCV_MV[i - 1]) * 100 / (OCV_MV[i] - OCV_MV[i - 1]));
+    }
+    return 1000;
+}
+
+}  // namespace drivers
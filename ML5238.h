@@ -0,0 +1,238 @@
+#pragma once
+
+#include <stdint.h>
+#include "ML5238_defs.h"
+#include "ML5238_seq.h"
+#include "ML5238_stats.h"
+
+namespace drivers {
+
+class ML5238_BalancePolicy;
+class ML5238_Guard;
+
+// Board glue for one ML5238: SPI frames, MCU ADC samples of the VMON and IMON pins, time base.
+class ML5238_Port {
+public:
+    // Clocks out `frames` 2 byte frames, /CS is released between frames. rx may be null.
+    virtual void transfer(const uint8_t *tx, uint8_t *rx, uint8_t frames) = 0;
+    virtual uint16_t vmon_mV() = 0;
+    virtual uint16_t imon_mV() = 0;
+    virtual uint32_t micros() = 0;
+    virtual void delay_us(uint32_t us) = 0;
+    // Changes the SPI clock, returns the rate actually set or 0 if the board can't
+    virtual uint32_t set_clock(uint32_t hz) { (void)hz; return 0; }
+};
+
+struct ML5238_Config {
+    uint8_t  cells;             // 5..16, see the connection table in ML5238_defs.h
+    uint16_t rsense_uohm;       // current sensing resistor between ISP and ISM
+    bool     gim;               // IMON gain 50 instead of 10
+    uint8_t  setsc;             // SC1,SC0 short current detecting voltage
+    uint16_t vmon_settle_us;    // VMON output settling after cell select
+    uint16_t cell_ov_mV;
+    uint16_t cell_uv_mV;
+    uint16_t hysteresis_mV;
+    int32_t  charge_oc_mA;
+    int32_t  discharge_oc_mA;
+    uint16_t balance_start_mV;  // balance only cells above this voltage
+    uint16_t balance_delta_mV;  // ... and this much above the lowest cell
+    uint32_t capacity_mAh;
+
+    ML5238_Config()
+        : cells(16), rsense_uohm(3000), gim(false), setsc(0), vmon_settle_us(200),
+          cell_ov_mV(4200), cell_uv_mV(2800), hysteresis_mV(100),
+          charge_oc_mA(20000), discharge_oc_mA(30000),
+          balance_start_mV(3900), balance_delta_mV(15), capacity_mAh(50000) {}
+};
+
+enum : uint8_t {
+    ML5238_FAULT_OV  = 0x01,    // cell over voltage, charge FET off
+    ML5238_FAULT_UV  = 0x02,    // cell under voltage, discharge FET off
+    ML5238_FAULT_OCC = 0x04,    // charge over current
+    ML5238_FAULT_OCD = 0x08,    // discharge over current
+    ML5238_FAULT_SC  = 0x10,    // short current, FETs cleared by the LSI
+};
+
+struct ML5238_State {
+    uint16_t cell_mV[ml5238::CELLS_MAX];    // index 0 = V1 cell, unused cells read 0
+    int32_t  current_mA;                    // charge positive
+    uint8_t  status;                        // last STATUS register read
+    uint16_t balance;                       // CBALH:CBALL
+    uint16_t soc_permille;
+    uint8_t  faults;
+    uint32_t time_us;                       // micros() at the end of the last tick
+
+    // Last scan, used cells only
+    uint16_t min_mV;
+    uint16_t max_mV;
+    uint16_t mean_mV;
+    uint16_t spread_mV;                     // max_mV - min_mV
+    uint8_t  min_cell;
+    uint8_t  max_cell;
+    // Over the last ML5238::STATS_SCANS scans
+    uint16_t low_mV;                        // lowest cell
+    uint16_t high_mV;                       // highest cell
+    uint16_t spread_max_mV;                 // widest spread
+};
+
+// Driver state worth keeping over a power down, see ML5238_ship.h
+struct ML5238_Retained {
+    int32_t charge_mAs;
+    uint16_t imon_zero_mV;
+    uint16_t mean_mV;                       // cell mean when it was taken
+};
+
+// Register accesses collected for one burst, see ML5238::run()
+class ML5238_Batch {
+public:
+    static const uint8_t MAX_FRAMES = 32;
+
+    ML5238_Batch() : _n(0), _compiled(false), _checked(false) {}
+
+    // Return the frame index, or -1 when full or the address is a TEST register
+    int8_t write(uint8_t reg, uint8_t val) { return add(ml5238::spi_cmd(reg, ml5238::SPI_WRITE), reg, val); }
+    int8_t read(uint8_t reg) { return add(ml5238::spi_cmd(reg, ml5238::SPI_READ), reg, 0); }
+
+    void clear() {
+        _n = 0;
+        _compiled = false;
+    }
+    // Freezes the frame list for reuse as a template: run() then skips the guard when no written
+    // register has a rule. set_data() patches a compiled batch in place, write(), read() and
+    // clear() undo compile().
+    void compile();
+    bool compiled() const { return _compiled; }
+
+    uint8_t size() const { return _n; }
+    bool full() const { return _n >= MAX_FRAMES; }
+    uint8_t reg(uint8_t frame) const { return ml5238::spi_reg(_tx[2 * frame]); }
+    bool is_read(uint8_t frame) const { return (_tx[2 * frame] & ml5238::SPI_READ) != 0; }
+    uint8_t data(uint8_t frame) const { return _tx[2 * frame + 1]; }
+    void set_data(uint8_t frame, uint8_t val) { _tx[2 * frame + 1] = val; }
+    // Read data of a frame after ML5238::run()
+    uint8_t result(uint8_t frame) const { return _rx[2 * frame + 1]; }
+
+private:
+    friend class ML5238;
+    friend class ML5238_Sched;
+
+    int8_t add(uint8_t cmd, uint8_t reg, uint8_t val) {
+        if (_n >= MAX_FRAMES || reg >= ml5238::REG_COUNT) return -1;
+        _compiled = false;
+        _tx[2 * _n] = cmd;
+        _tx[2 * _n + 1] = val;
+        return (int8_t)_n++;
+    }
+
+    uint8_t _n;
+    bool _compiled;
+    bool _checked;          // a written register has guard rules
+    uint8_t _tx[2 * MAX_FRAMES];
+    uint8_t _rx[2 * MAX_FRAMES];
+};
+
+class ML5238 {
+public:
+    explicit ML5238(ML5238_Port &port);
+
+    void begin(const ML5238_Config &cfg);
+    // begin() with the IMON offset kept instead of a 1 ms calibration. The charge count is kept too
+    // if the cell mean is still within tolerance_mV of the one retained, else SOC comes from OCV.
+    void begin(const ML5238_Config &cfg, const ML5238_Retained &kept, uint16_t tolerance_mV = 5);
+    ML5238_Retained retained() const;
+
+    uint8_t read(uint8_t reg);
+    // False if refused: TEST address or a ML5238_Guard rule
+    bool write(uint8_t reg, uint8_t val);
+    // Writes only if the value differs from the last written one
+    void update(uint8_t reg, uint8_t val);
+    // Clocks a whole batch in one port transfer, all or nothing under the guard
+    bool run(ML5238_Batch &batch);
+    // Last value written to a register
+    uint8_t shadow(uint8_t reg) const { return reg < ml5238::REG_COUNT ? _reg[reg] : 0; }
+
+    void scan_cells();
+    void measure_current();
+    void read_status();
+
+    void set_fets(bool charge, bool discharge);
+    // Illegal combinations of adjacent switches are thinned, highest cells win
+    void set_balance(uint16_t mask);
+    // Strategy used by tick(), null restores the built-in ML5238_TopBalance
+    void set_balance_policy(ML5238_BalancePolicy *policy);
+    // Checks every access before it reaches the bus, null turns it off
+    void set_guard(ML5238_Guard *guard) { _guard = guard; }
+    void clear_faults();
+    // Clears the latched RPSL, RPSH and RRS interrupts given as STATUS bits, one write per register
+    void clear_interrupts(uint8_t status);
+    // IMON offset with the inputs shorted, takes 1 ms
+    void calibrate_current();
+    // PSV: cell and current measurement and the PSENSE/RSENSE comparators stop while set
+    void set_power_save(bool on);
+
+    // One control period: status, current, cells, SOC, protection, balancing
+    void tick();
+
+    // Pieces of tick() for a cyclic executive, see ML5238_cyclic.h.
+    // STATUS, current, SOC and protection from the last scan
+    void protect_step();
+    // The next n cells of a scan spread over several calls, true once the scan is complete
+    bool scan_step(uint8_t n);
+    void balance_step() { balance(); }
+    // calibrate_current() in two halves at least 1 ms apart, the current keeps its last value between
+    void start_calibration();
+    void finish_calibration();
+
+    // The measurement part of tick() as a descriptor chain: STATUS, IMON, balancing off, every
+    // cell, balancing back on. Depends on the config only, compile once after begin().
+    bool compile_cycle(ML5238_Chain &chain) const;
+    // Patches the current balancing into the chain and hands it to the engine
+    bool start_cycle(ML5238_DmaEngine &dma, ML5238_Chain &chain, ML5238_DmaDone done, void *ctx);
+    // The rest of tick() on a completed chain. The chain's own writes bypass the guard, they
+    // only select cells and restore balancing already accepted.
+    void finish_cycle(const ML5238_Chain &chain);
+
+    const ML5238_State &state() const { return _state; }
+    const ML5238_Config &config() const { return _cfg; }
+    uint16_t cells() const { return ml5238::cells_mask(_cfg.cells); }
+    uint32_t transactions() const { return _transactions; }
+    // IMON pin voltage to current with the zero and gain in use, charge positive
+    int32_t imon_to_mA(uint16_t imon_mV) const;
+
+    // Scans covered by the rolling fields of ML5238_State
+    static const uint8_t STATS_SCANS = 32;
+
+    // Open circuit voltage to SOC, typical NMC cell
+    static uint16_t ocv_soc_permille(uint16_t mV);
+
+private:
+    void start(const ML5238_Config &cfg, const ML5238_Retained *kept, uint16_t tolerance_mV);
+    void take_status(uint8_t status);
+    void take_current(uint16_t imon_mV);
+    void take_scan();
+    void protect();
+    void balance();
+    void update_soc(uint32_t dt_us);
+    void apply_fets();
+    uint16_t select_balance(uint16_t candidates) const;
+
+    ML5238_Port &_port;
+    ML5238_BalancePolicy *_policy;
+    ML5238_Guard *_guard;
+    ML5238_Config _cfg;
+    ML5238_State _state;
+    uint8_t _reg[ml5238::REG_COUNT];
+    ML5238_Window<STATS_SCANS, true> _low;
+    ML5238_Window<STATS_SCANS, false> _high;
+    ML5238_Window<STATS_SCANS, false> _spread;
+    uint16_t _imon_zero_mV;
+    int32_t _charge_mAs;
+    int32_t _charge_rem_mAus;
+    uint32_t _transactions;
+    uint8_t _scan_next;         // first cell of the next scan_step()
+    bool _calibrating;
+    bool _charge_on;
+    bool _discharge_on;
+};
+
+}  // namespace drivers
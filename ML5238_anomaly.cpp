@@ -0,0 +1,128 @@
+#include "ML5238_anomaly.h"
+#include "ML5238.h"
+
+namespace drivers {
+
+using namespace ml5238;
+
+namespace {
+
+enum : uint8_t { TRACK_Z = 1, TRACK_SHIFT = 2 };
+
+uint32_t isqrt(uint64_t v) {
+    uint64_t r = 0, bit = (uint64_t)1 << 62;
+    while (bit > v) bit >>= 2;
+    while (bit) {
+        if (v >= r + bit) {
+            v -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)r;
+}
+
+}  // namespace
+
+ML5238_Anomaly::ML5238_Anomaly(const ML5238_AnomalyConfig &cfg) : _cfg(cfg) {
+    clear();
+}
+
+void ML5238_Anomaly::clear(uint8_t cell) {
+    if (cell >= CELLS_MAX) return;
+    _rest[cell] = Track();
+    _load[cell] = Track();
+    _flags[cell] = 0;
+}
+
+void ML5238_Anomaly::clear() {
+    for (uint8_t i = 0; i < CELLS_MAX; ++i) clear(i);
+}
+
+uint16_t ML5238_Anomaly::flagged() const {
+    uint16_t out = 0;
+    for (uint8_t i = 0; i < CELLS_MAX; ++i)
+        if (_flags[i]) out |= (uint16_t)(1U << i);
+    return out;
+}
+
+uint8_t ML5238_Anomaly::track(Track &t, int32_t x, uint32_t floor_q8, bool frozen) {
+    const int64_t floor_var = (int64_t)floor_q8 * floor_q8 >> 8;
+    if (!t.n) {
+        t.mean = x;
+        t.var = floor_var;
+        t.n = 1;
+        return 0;
+    }
+    const int32_t d = x - t.mean;
+    const int64_t d2 = (int64_t)d * d >> 8;
+    const int64_t var = t.var > floor_var ? t.var : floor_var;
+    const bool warm = t.n >= _cfg.warmup;
+
+    uint8_t f = 0;
+    if (warm && d2 > (int64_t)_cfg.z_limit * _cfg.z_limit * var) f |= TRACK_Z;
+    if (frozen) return f;
+
+    if (warm) {
+        const int64_t sigma = isqrt((uint64_t)var << 8);
+        const int64_t k = sigma * _cfg.cusum_k_x16 >> 4;
+        const int64_t h = sigma * _cfg.cusum_h_x16 >> 4;
+        t.hi += d - k;
+        t.lo += -d - k;
+        if (t.hi < 0) t.hi = 0;
+        if (t.lo < 0) t.lo = 0;
+        if (t.hi > h || t.lo > h) f |= TRACK_SHIFT;
+    }
+    // Outliers stay out of the baseline, a real change shows up in the CUSUM instead
+    if (!(f & TRACK_Z)) {
+        t.mean += d >> _cfg.shift;
+        t.var += (d2 - t.var) >> _cfg.shift;
+    }
+    if (t.n < 0xFFFF) ++t.n;
+    return f;
+}
+
+void ML5238_Anomaly::update(const uint16_t *cell_mV, uint16_t cells, int32_t current_mA) {
+    const int32_t a = current_mA < 0 ? -current_mA : current_mA;
+    const bool rest = a <= _cfg.rest_mA;
+    const bool load = a >= _cfg.load_mA;
+    if (!rest && !load) return;
+
+    // Median by insertion sort, at most 16 values
+    uint16_t v[CELLS_MAX];
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < CELLS_MAX; ++i) {
+        if (!(cells & (1U << i))) continue;
+        uint8_t j = n++;
+        for (; j && v[j - 1] > cell_mV[i]; --j) v[j] = v[j - 1];
+        v[j] = cell_mV[i];
+    }
+    if (!n) return;
+    const int32_t median_q8 = n & 1 ? (int32_t)v[n / 2] << 8 : ((int32_t)v[n / 2 - 1] + v[n / 2]) << 7;
+
+    const uint32_t rest_floor = (uint32_t)_cfg.rest_floor_mV << 8;
+    const uint32_t load_floor = (uint32_t)_cfg.load_floor_uohm << 8;
+    for (uint8_t i = 0; i < CELLS_MAX; ++i) {
+        if (!(cells & (1U << i))) continue;
+        const int32_t dev = ((int32_t)cell_mV[i] << 8) - median_q8;
+        uint8_t f = _flags[i];
+        if (rest) {
+            const uint8_t r = track(_rest[i], dev, rest_floor, (f & ML5238_ANOM_REST_SHIFT) != 0);
+            f = (uint8_t)((f & ~ML5238_ANOM_REST_Z) | r);
+        } else if (_rest[i].n) {
+            // Change against the rest offset per amp, charge or discharge: extra resistance
+            const int32_t x = (int32_t)((int64_t)(dev - _rest[i].mean) * 1000000 / current_mA);
+            const uint8_t r = track(_load[i], x, load_floor, (f & ML5238_ANOM_LOAD_SHIFT) != 0);
+            f = (uint8_t)((f & ~ML5238_ANOM_LOAD_Z) | r << 2);
+        }
+        _flags[i] = f;
+    }
+}
+
+void ML5238_Anomaly::update(const ML5238_State &s, uint16_t cells) {
+    update(s.cell_mV, cells, s.current_mA);
+}
+
+}  // namespace drivers
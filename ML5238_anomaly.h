@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include "ML5238_defs.h"
+
+namespace drivers {
+
+struct ML5238_State;
+
+struct ML5238_AnomalyConfig {
+    uint8_t  shift;             // EWMA weight 1/2^shift
+    uint16_t warmup;            // samples per context before anything is flagged
+    uint8_t  z_limit;           // flag |z| above this
+    uint8_t  cusum_k_x16;       // CUSUM slack, sigma/16
+    uint8_t  cusum_h_x16;       // CUSUM decision level, sigma/16
+    int32_t  rest_mA;           // |I| up to this is rest
+    int32_t  load_mA;           // |I| from this is load
+    uint16_t rest_floor_mV;     // sigma floor at rest, ADC resolution
+    uint16_t load_floor_uohm;   // sigma floor under load
+
+    ML5238_AnomalyConfig()
+        : shift(10), warmup(512), z_limit(6), cusum_k_x16(8), cusum_h_x16(128), rest_mA(1000),
+          load_mA(10000), rest_floor_mV(4), load_floor_uohm(200) {}
+};
+
+enum : uint8_t {
+    ML5238_ANOM_REST_Z     = 0x01,  // last rest sample off by more than z_limit sigma
+    ML5238_ANOM_REST_SHIFT = 0x02,  // lasting shift at rest, latched
+    ML5238_ANOM_LOAD_Z     = 0x04,  // last load sample, resistance off by more than z_limit sigma
+    ML5238_ANOM_LOAD_SHIFT = 0x08,  // lasting resistance shift, latched
+};
+
+// Streaming per cell detector on the deviation from the pack median. At rest the deviation
+// itself is tracked in mV; under load its change against the rest baseline per amp, which is
+// the cell's extra resistance in uOhm. Each context keeps an EWMA mean and variance for a
+// z-score and a two sided CUSUM on the residual. Fixed point, constant memory per cell.
+class ML5238_Anomaly {
+public:
+    explicit ML5238_Anomaly(const ML5238_AnomalyConfig &cfg = ML5238_AnomalyConfig());
+
+    void update(const uint16_t *cell_mV, uint16_t cells, int32_t current_mA);
+    void update(const ML5238_State &s, uint16_t cells);
+
+    uint8_t flags(uint8_t cell) const { return cell < ml5238::CELLS_MAX ? _flags[cell] : 0; }
+    // Cells with any flag
+    uint16_t flagged() const;
+    // Drops the latched flags and relearns the cell
+    void clear(uint8_t cell);
+    void clear();
+
+    // Baseline in fixed point 1/256: rest mV, load uOhm
+    int32_t rest_mean_q8(uint8_t cell) const { return _rest[cell & 15].mean; }
+    int32_t load_mean_q8(uint8_t cell) const { return _load[cell & 15].mean; }
+
+private:
+    struct Track {
+        int32_t  mean;      // Q8
+        int64_t  var;       // Q8 of the unit squared
+        int32_t  hi;        // CUSUM sums, Q8
+        int32_t  lo;
+        uint16_t n;
+    };
+
+    // Returns the Z and SHIFT flags for one sample x (Q8)
+    uint8_t track(Track &t, int32_t x, uint32_t floor_q8, bool frozen);
+
+    ML5238_AnomalyConfig _cfg;
+    Track _rest[ml5238::CELLS_MAX];
+    Track _load[ml5238::CELLS_MAX];
+    uint8_t _flags[ml5238::CELLS_MAX];
+};
+
+}  // namespace drivers
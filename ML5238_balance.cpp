@@ -0,0 +1,57 @@
+#include "ML5238_balance.h"
+
+namespace drivers {
+
+using namespace ml5238;
+
+namespace {
+
+uint16_t min_of(const uint16_t *v, uint16_t cells) {
+    uint16_t m = 0xFFFF;
+    for (uint8_t i = 0; i < CELLS_MAX; ++i)
+        if ((cells & (1U << i)) && v[i] < m) m = v[i];
+    return m;
+}
+
+}  // namespace
+
+uint16_t ML5238_TopBalance::decide(const ML5238_State &s, const ML5238_Config &cfg, uint16_t cells) {
+    if (s.current_mA < 0) return 0;
+    const uint16_t min_mV = s.min_mV;
+    uint16_t out = 0;
+    for (uint8_t i = 0; i < CELLS_MAX; ++i) {
+        const uint16_t v = s.cell_mV[i];
+        if ((cells & (1U << i)) && v >= cfg.balance_start_mV && v >= min_mV + cfg.balance_delta_mV)
+            out |= (uint16_t)(1U << i);
+    }
+    return out;
+}
+
+uint16_t ML5238_BottomBalance::decide(const ML5238_State &s, const ML5238_Config &cfg, uint16_t cells) {
+    if (s.soc_permille > _below || s.current_mA > _rest_mA || s.current_mA < -_rest_mA) return 0;
+    const uint16_t min_mV = s.min_mV;
+    uint16_t out = 0;
+    for (uint8_t i = 0; i < CELLS_MAX; ++i)
+        if ((cells & (1U << i)) && s.cell_mV[i] >= min_mV + cfg.balance_delta_mV) out |= (uint16_t)(1U << i);
+    return out;
+}
+
+ML5238_SocBalance::ML5238_SocBalance(uint16_t delta_permille, int32_t rest_mA)
+    : _delta(delta_permille), _rest_mA(rest_mA), _valid(false) {
+    for (uint8_t i = 0; i < CELLS_MAX; ++i) _soc[i] = 0;
+}
+
+uint16_t ML5238_SocBalance::decide(const ML5238_State &s, const ML5238_Config &, uint16_t cells) {
+    if (s.current_mA <= _rest_mA && s.current_mA >= -_rest_mA) {
+        for (uint8_t i = 0; i < CELLS_MAX; ++i) _soc[i] = ML5238::ocv_soc_permille(s.cell_mV[i]);
+        _valid = true;
+    }
+    if (!_valid || s.current_mA < -_rest_mA) return 0;
+    const uint16_t min_soc = min_of(_soc, cells);
+    uint16_t out = 0;
+    for (uint8_t i = 0; i < CELLS_MAX; ++i)
+        if ((cells & (1U << i)) && _soc[i] >= min_soc + _delta) out |= (uint16_t)(1U << i);
+    return out;
+}
+
+}  // namespace drivers
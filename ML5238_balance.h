@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include "ML5238.h"
+
+namespace drivers {
+
+// Balancing strategy. decide() runs once per driver tick without faults and returns the wanted
+// switches, bit 0 = V1 cell; the driver thins illegal neighbours before CBALH/CBALL are written.
+class ML5238_BalancePolicy {
+public:
+    virtual uint16_t decide(const ML5238_State &s, const ML5238_Config &cfg, uint16_t cells) = 0;
+};
+
+// Voltage based at the top of charge: cells above balance_start_mV and balance_delta_mV above
+// the lowest cell, not while discharging.
+class ML5238_TopBalance : public ML5238_BalancePolicy {
+public:
+    uint16_t decide(const ML5238_State &s, const ML5238_Config &cfg, uint16_t cells) override;
+};
+
+// Aligns the empty end: at low SOC and rest, bleeds cells above the lowest one.
+class ML5238_BottomBalance : public ML5238_BalancePolicy {
+public:
+    explicit ML5238_BottomBalance(uint16_t below_permille = 300, int32_t rest_mA = 1000)
+        : _below(below_permille), _rest_mA(rest_mA) {}
+    uint16_t decide(const ML5238_State &s, const ML5238_Config &cfg, uint16_t cells) override;
+
+private:
+    uint16_t _below;
+    int32_t _rest_mA;
+};
+
+// Equalizes per cell SOC at any charge level. The SOC of each cell is taken from its open
+// circuit voltage while the pack rests and held under load.
+class ML5238_SocBalance : public ML5238_BalancePolicy {
+public:
+    explicit ML5238_SocBalance(uint16_t delta_permille = 10, int32_t rest_mA = 1000);
+    uint16_t decide(const ML5238_State &s, const ML5238_Config &cfg, uint16_t cells) override;
+    uint16_t cell_soc(uint8_t i) const { return _soc[i]; }
+
+private:
+    uint16_t _delta;
+    int32_t _rest_mA;
+    bool _valid;
+    uint16_t _soc[ml5238::CELLS_MAX];
+};
+
+}  // namespace drivers
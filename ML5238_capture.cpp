@@ -0,0 +1,148 @@
+#include "ML5238_capture.h"
+
+namespace drivers {
+
+using namespace ml5238;
+
+ML5238_Capture::ML5238_Capture(ML5238 &bms, ML5238_Port &port, uint16_t *ring, uint16_t ring_size, uint8_t *pool,
+                               uint16_t pool_size, ML5238_CaptureEvent *event, uint8_t max_events)
+    : _bms(bms), _port(port), _ring(ring), _mask((uint16_t)(ring_size - 1)), _pool(pool), _pool_size(pool_size),
+      _event(event), _max_events(max_events), _armed(false), _oc_armed(false), _pre(0), _post(0), _lo_mV(0),
+      _hi_mV(0xFFFF), _head(0), _filled(0), _pending() {
+    clear();
+}
+
+void ML5238_Capture::clear() {
+    _pool_used = 0;
+    _n_events = 0;
+    _post_left = 0;
+    _samples = 0;
+    _lost = 0;
+}
+
+bool ML5238_Capture::arm(uint16_t pre, uint16_t post) {
+    if ((uint32_t)pre + post > (uint32_t)_mask + 1) return false;
+    const ML5238_Config &cfg = _bms.config();
+    const uint16_t zero = _bms.retained().imon_zero_mV;
+    const int64_t per_A = (int64_t)cfg.rsense_uohm * (cfg.gim ? IMON_GAIN_HI : IMON_GAIN_LO);
+    const int64_t hi = zero + (int64_t)cfg.charge_oc_mA * per_A / 1000000;
+    const int64_t lo = zero - (int64_t)cfg.discharge_oc_mA * per_A / 1000000;
+    _hi_mV = (uint16_t)(hi > 0xFFFF ? 0xFFFF : hi);
+    _lo_mV = (uint16_t)(lo < 0 ? 0 : lo);
+    _pending.imon_zero_mV = zero;
+    _pending.rsense_uohm = cfg.rsense_uohm;
+    _pending.gim = cfg.gim;
+    _pre = pre;
+    _post = post;
+    _post_left = 0;
+    _oc_armed = true;
+    _armed = true;
+    return true;
+}
+
+bool ML5238_Capture::sample() {
+    const uint16_t mV = _port.imon_mV();
+    _ring[_head] = mV;
+    _head = (uint16_t)((_head + 1) & _mask);
+    if (_filled <= _mask) ++_filled;
+    ++_samples;
+    if (_post_left) {
+        if (--_post_left) return false;
+        freeze();
+        return true;
+    }
+    if (mV < _lo_mV || mV > _hi_mV) {
+        if (_oc_armed) {
+            _oc_armed = false;
+            trigger(ML5238_CAPTURE_OC);
+            return !_post;
+        }
+    } else {
+        _oc_armed = true;
+    }
+    return false;
+}
+
+void ML5238_Capture::trigger(uint8_t cause, uint8_t status) {
+    if (!_armed) return;
+    if (_post_left) {
+        // Same window, the first trigger sets its position
+        _pending.cause |= cause;
+        if (!_pending.status) _pending.status = status;
+        return;
+    }
+    _pending.cause = cause;
+    _pending.status = status;
+    _pending.trigger_us = _port.micros();
+    _pending.pre = _filled < _pre ? _filled : _pre;
+    const ML5238_State &s = _bms.state();
+    for (uint8_t i = 0; i < CELLS_MAX; ++i) _pending.cell_mV[i] = s.cell_mV[i];
+    if (_post) _post_left = _post;
+    else freeze();
+}
+
+void ML5238_Capture::freeze() {
+    ML5238_CaptureEvent &e = _pending;
+    e.last_us = _port.micros();
+    e.samples = (uint16_t)(e.pre + _post);
+    e.first_us = _post ? e.trigger_us - (uint32_t)((uint64_t)(e.last_us - e.trigger_us) * e.pre / _post) : e.last_us;
+    if (_n_events >= _max_events) {
+        ++_lost;
+        return;
+    }
+
+    uint16_t at = _pool_used;
+    uint16_t i = (uint16_t)((_head - e.samples) & _mask);
+    uint16_t prev = _ring[i];
+    bool fits = at + 2 <= _pool_size;
+    if (fits) {
+        _pool[at++] = (uint8_t)(prev >> 8);
+        _pool[at++] = (uint8_t)prev;
+    }
+    for (uint16_t n = 1; fits && n < e.samples; ++n) {
+        i = (uint16_t)((i + 1) & _mask);
+        const int32_t d = (int32_t)_ring[i] - prev;
+        prev = _ring[i];
+        if (d >= -127 && d <= 127) {
+            fits = at + 1 <= _pool_size;
+            if (fits) _pool[at++] = (uint8_t)(int8_t)d;
+        } else {
+            fits = at + 3 <= _pool_size;
+            if (fits) {
+                _pool[at++] = 0x80;
+                _pool[at++] = (uint8_t)(prev >> 8);
+                _pool[at++] = (uint8_t)prev;
+            }
+        }
+    }
+    if (!fits) {
+        ++_lost;
+        return;
+    }
+    e.offset = _pool_used;
+    e.bytes = (uint16_t)(at - _pool_used);
+    _pool_used = at;
+    _event[_n_events++] = e;
+}
+
+uint16_t ML5238_Capture::decode(uint8_t i, int32_t *mA, uint16_t max) const {
+    if (i >= _n_events) return 0;
+    const ML5238_CaptureEvent &e = _event[i];
+    const uint8_t *p = _pool + e.offset, *end = p + e.bytes;
+    const int64_t per_A = (int64_t)e.rsense_uohm * (e.gim ? IMON_GAIN_HI : IMON_GAIN_LO);
+    uint16_t n = 0;
+    int32_t mV = 0;
+    while (p < end && n < max && n < e.samples) {
+        if (!n || *p == 0x80) {
+            if (n) ++p;
+            mV = (int32_t)(p[0] << 8 | p[1]);
+            p += 2;
+        } else {
+            mV += (int8_t)*p++;
+        }
+        mA[n++] = (int32_t)((int64_t)(mV - e.imon_zero_mV) * 1000000 / per_A);
+    }
+    return n;
+}
+
+}  // namespace drivers
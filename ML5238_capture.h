@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdint.h>
+#include "ML5238.h"
+
+namespace drivers {
+
+// Trigger causes, more than one when they fall into the same window
+enum : uint8_t {
+    ML5238_CAPTURE_SC     = 0x01,   // STATUS.RSC
+    ML5238_CAPTURE_LOAD   = 0x02,   // STATUS.RRS
+    ML5238_CAPTURE_OC     = 0x04,   // IMON sample beyond the configured over current
+    ML5238_CAPTURE_MANUAL = 0x08,
+};
+
+// A frozen window. The samples are IMON pin voltages, delta coded in the pool: the first as two
+// bytes, then one signed byte per sample, or 0x80 and two bytes for a larger step.
+struct ML5238_CaptureEvent {
+    uint8_t cause;
+    uint8_t status;             // STATUS that triggered, 0 for OC and manual
+    uint16_t pre;               // samples before the trigger
+    uint16_t samples;
+    uint32_t trigger_us;
+    uint32_t first_us;          // first and last sample, the others are evenly spaced
+    uint32_t last_us;
+    uint16_t imon_zero_mV;      // conversion at the time
+    uint16_t rsense_uohm;
+    bool gim;
+    uint16_t cell_mV[ml5238::CELLS_MAX];    // last scan before the trigger
+    uint16_t offset;            // coded samples in the pool
+    uint16_t bytes;
+};
+
+// Flight recorder for shorts. sample() runs at the full ADC rate, from the conversion interrupt or
+// a tight loop: one IMON read, one store into the ring and one compare against the over current
+// window in IMON millivolts, nothing else until a trigger. A trigger (RSC or RRS seen in STATUS,
+// an over current sample or trigger()) keeps sampling for the post window and then codes the
+// ring from pre samples before the trigger into the pool. Events stay until clear(); when the
+// pool or the table is full later windows are counted as lost, the first fault is the one that
+// matters. The over current trigger rearms once the current is back inside the window. Storage
+// lives in the derived ML5238_CaptureBuffer.
+class ML5238_Capture {
+public:
+    // pre + post samples around each trigger, at most the ring. Takes the over current window and
+    // the IMON conversion from the driver as they are now.
+    bool arm(uint16_t pre, uint16_t post);
+    void disarm() { _armed = false; }
+
+    // One ADC sample, true when it completed an event
+    bool sample();
+    void trigger(uint8_t cause, uint8_t status = 0);
+    // STATUS from the /INTO handler
+    void on_status(uint8_t status) {
+        if (status & ml5238::STATUS_RSC) trigger(ML5238_CAPTURE_SC, status);
+        if (status & ml5238::STATUS_RRS) trigger(ML5238_CAPTURE_LOAD, status);
+    }
+    bool capturing() const { return _post_left != 0; }
+
+    uint8_t events() const { return _n_events; }
+    const ML5238_CaptureEvent &event(uint8_t i) const { return _event[i < _n_events ? i : 0]; }
+    const uint8_t *data(uint8_t i) const { return _pool + event(i).offset; }
+    // Current of each sample in mA, returns the samples written
+    uint16_t decode(uint8_t i, int32_t *mA, uint16_t max) const;
+    uint32_t lost() const { return _lost; }
+    uint32_t samples() const { return _samples; }
+    uint16_t pool_used() const { return _pool_used; }
+    void clear();
+
+protected:
+    // ring_size a power of two
+    ML5238_Capture(ML5238 &bms, ML5238_Port &port, uint16_t *ring, uint16_t ring_size, uint8_t *pool,
+                   uint16_t pool_size, ML5238_CaptureEvent *event, uint8_t max_events);
+
+private:
+    void freeze();
+
+    ML5238 &_bms;
+    ML5238_Port &_port;
+    uint16_t *_ring;
+    uint16_t _mask;
+    uint8_t *_pool;
+    uint16_t _pool_size;
+    uint16_t _pool_used;
+    ML5238_CaptureEvent *_event;
+    uint8_t _max_events;
+    uint8_t _n_events;
+    bool _armed;
+    bool _oc_armed;
+    uint16_t _pre;
+    uint16_t _post;
+    uint16_t _lo_mV;            // outside [_lo_mV, _hi_mV] is over current
+    uint16_t _hi_mV;
+    uint16_t _head;             // next ring slot
+    uint16_t _filled;           // samples in the ring, up to its size
+    uint16_t _post_left;
+    uint32_t _samples;
+    uint32_t _lost;
+    ML5238_CaptureEvent _pending;
+};
+
+// RING samples (a power of two), POOL bytes of coded windows, EVENTS windows
+template <uint16_t RING, uint16_t POOL, uint8_t EVENTS>
+class ML5238_CaptureBuffer : public ML5238_Capture {
+    static_assert(RING && !(RING & (RING - 1)), "RING must be a power of two");
+
+public:
+    ML5238_CaptureBuffer(ML5238 &bms, ML5238_Port &port)
+        : ML5238_Capture(bms, port, _ring_buf, RING, _pool_buf, POOL, _event_buf, EVENTS) {}
+
+private:
+    uint16_t _ring_buf[RING];
+    uint8_t _pool_buf[POOL];
+    ML5238_CaptureEvent _event_buf[EVENTS];
+};
+
+}  // namespace drivers
@@ -0,0 +1,96 @@
+#include "ML5238_clock.h"
+
+namespace drivers {
+
+using namespace ml5238;
+
+namespace {
+
+const uint8_t ECHOES_PER_BURST = ML5238_Batch::MAX_FRAMES / 2;
+const uint8_t EDGES[4] = { 0x55, 0xAA, 0x00, 0xFF };
+
+uint8_t popcount(uint8_t v) {
+    uint8_t n = 0;
+    for (; v; v &= (uint8_t)(v - 1)) ++n;
+    return n;
+}
+
+}  // namespace
+
+ML5238_ClockTuner::ML5238_ClockTuner(ML5238 &bms, ML5238_Port &port, const ML5238_ClockConfig &cfg)
+    : _bms(bms), _port(port), _cfg(cfg), _hz(0), _last_us(0), _retunes(0), _pattern(0x5238), _n(0) {
+    if (_cfg.max_hz > SPI_MAX_HZ) _cfg.max_hz = SPI_MAX_HZ;
+    for (uint8_t i = 0; i < ECHOES_PER_BURST; ++i) {
+        _batch.write(REG_NOOP, 0);
+        _batch.read(REG_NOOP);
+    }
+    _batch.compile();
+}
+
+uint32_t ML5238_ClockTuner::echo(uint16_t n) {
+    uint32_t errors = 0;
+    while (n) {
+        const uint8_t k = n < ECHOES_PER_BURST ? (uint8_t)n : ECHOES_PER_BURST;
+        // Fixed edges first, then pseudo random data
+        for (uint8_t i = 0; i < k; ++i) {
+            _pattern ^= _pattern << 13;
+            _pattern ^= _pattern >> 17;
+            _pattern ^= _pattern << 5;
+            _batch.set_data((uint8_t)(2 * i), i < 4 ? EDGES[i] : (uint8_t)_pattern);
+        }
+        if (!_bms.run(_batch)) return 0xFFFFFFFFUL;
+        for (uint8_t i = 0; i < k; ++i)
+            errors += popcount((uint8_t)(_batch.result((uint8_t)(2 * i + 1)) ^ _batch.data((uint8_t)(2 * i))));
+        n = (uint16_t)(n - k);
+    }
+    return errors;
+}
+
+uint32_t ML5238_ClockTuner::tune() {
+    const uint32_t previous = _hz;
+    _n = 0;
+    uint32_t clean = 0;
+    bool failed = false;
+    for (uint32_t r = _cfg.min_hz; r && _n < MAX_RATES; r = (uint32_t)((uint64_t)r * (100 + _cfg.step_pct) / 100)) {
+        if (r > _cfg.max_hz) {
+            // The last step lands on max_hz itself
+            if (_n && _rate[_n - 1] >= _cfg.max_hz) break;
+            r = _cfg.max_hz;
+        }
+        const uint32_t set = _port.set_clock(r);
+        if (!set) return _hz = 0;
+        _rate[_n] = set;
+        _errors[_n] = echo(_cfg.echoes);
+        if (_errors[_n++]) {
+            failed = true;
+            break;
+        }
+        clean = set;
+    }
+
+    _last_us = _port.micros();
+    if (!clean) {
+        // Not even min_hz is clean, no rate with errors is kept
+        if (previous) _port.set_clock(previous);
+        return 0;
+    }
+    // Clean up to max_hz: the datasheet rate. Otherwise margin_pct under the fastest clean rate,
+    // the failing one may be just past it.
+    uint32_t pick = failed ? _cfg.min_hz : clean;
+    if (failed)
+        for (uint8_t i = 0; i + 1 < _n; ++i)
+            if ((uint64_t)_rate[i] * (100 + _cfg.margin_pct) <= (uint64_t)clean * 100) pick = _rate[i];
+    _hz = _port.set_clock(pick);
+    return _hz;
+}
+
+bool ML5238_ClockTuner::service(uint32_t now_us) {
+    if (!_hz || now_us - _last_us < _cfg.recheck_us) return true;
+    _last_us = now_us;
+    if (!echo(_cfg.check_echoes)) return true;
+    ++_retunes;
+    tune();
+    return false;
+}
+
+}  // namespace drivers
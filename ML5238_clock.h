@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include "ML5238.h"
+
+namespace drivers {
+
+struct ML5238_ClockConfig {
+    uint32_t min_hz;            // sweep start, known to work
+    uint32_t max_hz;            // sweep end, at most ml5238::SPI_MAX_HZ
+    uint8_t  step_pct;          // each rate this much above the previous one
+    uint16_t echoes;            // NOOP write and read back pairs per rate in a sweep
+    uint16_t check_echoes;      // pairs per revalidation
+    uint8_t  margin_pct;        // stay this much under the fastest clean rate
+    uint32_t recheck_us;
+
+    ML5238_ClockConfig()
+        : min_hz(125000), max_hz(ml5238::SPI_MAX_HZ), step_pct(25), echoes(1024), check_echoes(64),
+          margin_pct(20), recheck_us(10000000) {}
+};
+
+// Picks the fastest SPI clock a board carries without errors. Sweeps the port's clock upwards,
+// writes patterns to NOOP (00H) and reads them back, and stops at the first rate with a bit
+// error. The chosen rate is a swept one at least margin_pct under the fastest clean rate, or max_hz
+// when the whole sweep was clean. service() repeats a short echo test and retunes on any error.
+class ML5238_ClockTuner {
+public:
+    static const uint8_t MAX_RATES = 24;
+
+    ML5238_ClockTuner(ML5238 &bms, ML5238_Port &port, const ML5238_ClockConfig &cfg = ML5238_ClockConfig());
+
+    // Sets and returns the chosen rate. 0 if the port has no clock control, or if not even min_hz
+    // is clean: the previous rate then stays.
+    uint32_t tune();
+    // Revalidates once recheck_us has passed, false if the rate failed and was retuned
+    bool service(uint32_t now_us);
+
+    uint32_t hz() const { return _hz; }
+    uint32_t retunes() const { return _retunes; }
+
+    // Last sweep, bit errors out of bits() per rate
+    uint8_t rates() const { return _n; }
+    uint32_t rate(uint8_t i) const { return i < _n ? _rate[i] : 0; }
+    uint32_t errors(uint8_t i) const { return i < _n ? _errors[i] : 0; }
+    uint32_t bits() const { return (uint32_t)_cfg.echoes * 16; }
+
+private:
+    // Bit errors over n echoes at the current clock
+    uint32_t echo(uint16_t n);
+
+    ML5238 &_bms;
+    ML5238_Port &_port;
+    ML5238_ClockConfig _cfg;
+    ML5238_Batch _batch;
+    uint32_t _hz;
+    uint32_t _last_us;
+    uint32_t _retunes;
+    uint32_t _pattern;
+    uint8_t _n;
+    uint32_t _rate[MAX_RATES];
+    uint32_t _errors[MAX_RATES];
+};
+
+}  // namespace drivers
@@ -0,0 +1,150 @@
+#include "ML5238_cyclic.h"
+
+namespace drivers {
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+    while (b) {
+        const uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+ML5238_Cyclic::ML5238_Cyclic(ML5238_Port &port, uint32_t minor_us, uint32_t frame_us, uint16_t *first,
+                             uint16_t max_frames, uint8_t *entry, uint16_t max_entries)
+    : _port(port), _minor_us(minor_us), _frame_us(frame_us), _first(first), _max_frames(max_frames),
+      _entry(entry), _max_entries(max_entries), _frames(0), _n_entries(0), _built(false), _n_tasks(0), _frame(0),
+      _cycle_start(0), _frame_start(0), _overruns(0) {
+    clear_stats();
+}
+
+bool ML5238_Cyclic::add(const ML5238_Task &task) {
+    if (_built || _n_tasks >= MAX_TASKS || !task.run) return false;
+    _task[_n_tasks++] = task;
+    return true;
+}
+
+bool ML5238_Cyclic::build() {
+    if (_built || !_n_tasks || !_minor_us) return false;
+    uint64_t major = _minor_us;
+    for (uint8_t i = 0; i < _n_tasks; ++i) {
+        const ML5238_Task &t = _task[i];
+        if (!t.period_us || t.period_us % _minor_us || t.offset_us % _minor_us) return false;
+        if ((uint64_t)t.offset_us + t.deadline_us > t.period_us || cost_us(t) > _minor_us) return false;
+        major = major / gcd((uint32_t)(major % t.period_us), t.period_us) * t.period_us;
+        if (major / _minor_us > _max_frames) return false;
+    }
+    _frames = (uint16_t)(major / _minor_us);
+
+    // Release of each task's job not placed yet, jobs go earliest deadline first into the
+    // first frame where they still finish in time
+    uint32_t release[MAX_TASKS];
+    for (uint8_t i = 0; i < _n_tasks; ++i) release[i] = _task[i].offset_us;
+    uint16_t n = 0;
+    for (uint16_t f = 0; f < _frames; ++f) {
+        const uint32_t t0 = f * _minor_us;
+        uint32_t load = 0;
+        _first[f] = n;
+        for (;;) {
+            int8_t best = -1;
+            for (uint8_t i = 0; i < _n_tasks; ++i) {
+                const ML5238_Task &t = _task[i];
+                if (release[i] >= major || release[i] > t0) continue;
+                const uint32_t end = t0 + load + cost_us(t);
+                if (end > t0 + _minor_us || end > release[i] + t.deadline_us) continue;
+                if (best < 0 || release[i] + t.deadline_us < release[best] + _task[best].deadline_us) best = (int8_t)i;
+            }
+            if (best < 0) break;
+            if (n >= _max_entries) return false;
+            _entry[n++] = (uint8_t)best;
+            load += cost_us(_task[best]);
+            release[best] += _task[best].period_us;
+        }
+        // A job that cannot finish in any later frame makes the task set infeasible
+        for (uint8_t i = 0; i < _n_tasks; ++i)
+            if (release[i] < major && t0 + _minor_us + cost_us(_task[i]) > release[i] + _task[i].deadline_us)
+                return false;
+    }
+    _first[_frames] = n;
+    _n_entries = n;
+    _built = true;
+    return true;
+}
+
+void ML5238_Cyclic::start(uint32_t now_us) {
+    _frame = 0;
+    _cycle_start = _frame_start = now_us;
+}
+
+bool ML5238_Cyclic::service(uint32_t now_us) {
+    if (!_built || (int32_t)(now_us - _frame_start) < 0) return false;
+    const uint32_t at = _frame * _minor_us;
+    for (uint16_t e = _first[_frame]; e < _first[_frame + 1]; ++e) {
+        const uint8_t i = _entry[e];
+        const ML5238_Task &t = _task[i];
+        // The job's release is the task's last release at or before the frame
+        const uint32_t since = at - t.offset_us;
+        const uint32_t release = _cycle_start + t.offset_us + since - since % t.period_us;
+        const uint32_t t0 = _port.micros();
+        t.run(t.ctx);
+        const uint32_t t1 = _port.micros();
+        ML5238_TaskStats &st = _stats[i];
+        ++st.jobs;
+        if (t1 - t0 > st.exec_max_us) st.exec_max_us = t1 - t0;
+        if (t1 - release > st.response_max_us) st.response_max_us = t1 - release;
+        if (t1 - release > t.deadline_us) ++st.misses;
+    }
+    next_frame();
+    const uint32_t now = _port.micros();
+    if ((int32_t)(now - _frame_start) > 0) {
+        ++_overruns;
+        // No backlog: frames whose start has passed are skipped and their jobs count as missed, the
+        // schedule goes on from the next frame on the grid
+        while ((int32_t)(now - _frame_start) > 0) {
+            for (uint16_t e = _first[_frame]; e < _first[_frame + 1]; ++e) {
+                ML5238_TaskStats &st = _stats[_entry[e]];
+                ++st.jobs;
+                ++st.misses;
+                ++st.skipped;
+            }
+            next_frame();
+        }
+    }
+    return true;
+}
+
+void ML5238_Cyclic::next_frame() {
+    _frame_start += _minor_us;
+    if (++_frame == _frames) {
+        _frame = 0;
+        _cycle_start = _frame_start;
+    }
+}
+
+uint32_t ML5238_Cyclic::load_us(uint16_t frame) const {
+    if (frame >= _frames) return 0;
+    uint32_t us = 0;
+    for (uint16_t e = _first[frame]; e < _first[frame + 1]; ++e) us += cost_us(_task[_entry[e]]);
+    return us;
+}
+
+uint32_t ML5238_Cyclic::load_max_us() const {
+    uint32_t us = 0;
+    for (uint16_t f = 0; f < _frames; ++f)
+        if (load_us(f) > us) us = load_us(f);
+    return us;
+}
+
+uint32_t ML5238_Cyclic::misses() const {
+    uint32_t n = 0;
+    for (uint8_t i = 0; i < _n_tasks; ++i) n += _stats[i].misses;
+    return n;
+}
+
+void ML5238_Cyclic::clear_stats() {
+    for (uint8_t i = 0; i < MAX_TASKS; ++i) _stats[i] = ML5238_TaskStats();
+    _overruns = 0;
+}
+
+}  // namespace drivers
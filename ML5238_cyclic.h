@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+#include "ML5238.h"
+
+namespace drivers {
+
+typedef void (*ML5238_TaskFn)(void *ctx);
+
+// A periodic task. Each job is released at offset_us + k * period_us and must finish within
+// deadline_us. frames and busy_us are worst cases, the bus time is frames times the frame time.
+struct ML5238_Task {
+    ML5238_TaskFn run;
+    void *ctx;
+    const char *name;
+    uint32_t period_us;         // multiple of the minor frame
+    uint32_t offset_us;         // multiple of the minor frame, offset + deadline <= period
+    uint32_t deadline_us;
+    uint8_t frames;             // SPI frames per job
+    uint32_t busy_us;           // settling waits, ADC and CPU time on top of the frames
+};
+
+struct ML5238_TaskStats {
+    uint32_t jobs;
+    uint32_t misses;            // finished after the deadline or skipped
+    uint32_t skipped;           // in a frame skipped after an overrun
+    uint32_t response_max_us;   // release to finish
+    uint32_t exec_max_us;
+};
+
+// Cyclic executive. build() lays the jobs of one major cycle (the LCM of the periods) into minor
+// frames, earliest deadline first, so that the work of a frame fits the frame and every job
+// finishes in a frame before its deadline. At run time the frames are replayed from the table:
+// no decisions, no overlap on the bus, and the measured response of every job is checked
+// against its deadline. The table lives in the derived ML5238_CyclicTable.
+class ML5238_Cyclic {
+public:
+    static const uint8_t MAX_TASKS = 8;
+
+    // False when the table is full or build() already ran
+    bool add(const ML5238_Task &task);
+    // False when a task breaks the rules above, the table is too small or a job does not fit
+    bool build();
+    bool built() const { return _built; }
+
+    // Frame 0 of the first major cycle starts at now_us
+    void start(uint32_t now_us);
+    // Runs the current frame's jobs if its start has come, false otherwise
+    bool service(uint32_t now_us);
+    // Start of the next frame to run
+    uint32_t due_us() const { return _frame_start; }
+
+    uint32_t minor_us() const { return _minor_us; }
+    uint32_t major_us() const { return _minor_us * _frames; }
+    uint16_t frames() const { return _frames; }
+    uint16_t jobs() const { return _n_entries; }
+    // Planned work of a frame and the largest of all frames
+    uint32_t load_us(uint16_t frame) const;
+    uint32_t load_max_us() const;
+    uint8_t tasks() const { return _n_tasks; }
+    const ML5238_Task &task(uint8_t i) const { return _task[i < MAX_TASKS ? i : 0]; }
+    const ML5238_TaskStats &stats(uint8_t i) const { return _stats[i < MAX_TASKS ? i : 0]; }
+    // Frames whose work ran into the next one; the frames overrun are skipped
+    uint32_t overruns() const { return _overruns; }
+    uint32_t misses() const;
+    void clear_stats();
+
+protected:
+    // frame_us: one SPI frame at the bus clock in use
+    ML5238_Cyclic(ML5238_Port &port, uint32_t minor_us, uint32_t frame_us, uint16_t *first, uint16_t max_frames,
+                  uint8_t *entry, uint16_t max_entries);
+
+private:
+    uint32_t cost_us(const ML5238_Task &t) const { return t.frames * _frame_us + t.busy_us; }
+    void next_frame();
+
+    ML5238_Port &_port;
+    uint32_t _minor_us;
+    uint32_t _frame_us;
+    uint16_t *_first;           // first entry of each frame, _frames + 1 of them
+    uint16_t _max_frames;
+    uint8_t *_entry;            // task of each job, frame by frame
+    uint16_t _max_entries;
+    uint16_t _frames;
+    uint16_t _n_entries;
+    bool _built;
+    uint8_t _n_tasks;
+    ML5238_Task _task[MAX_TASKS];
+    ML5238_TaskStats _stats[MAX_TASKS];
+    uint16_t _frame;            // next frame to run
+    uint32_t _cycle_start;
+    uint32_t _frame_start;
+    uint32_t _overruns;
+};
+
+// FRAMES minor frames per major cycle at most, ENTRIES jobs per major cycle at most
+template <uint16_t FRAMES, uint16_t ENTRIES>
+class ML5238_CyclicTable : public ML5238_Cyclic {
+public:
+    ML5238_CyclicTable(ML5238_Port &port, uint32_t minor_us, uint32_t frame_us)
+        : ML5238_Cyclic(port, minor_us, frame_us, _first_buf, FRAMES, _entry_buf, ENTRIES) {}
+
+private:
+    uint16_t _first_buf[FRAMES + 1];
+    uint8_t _entry_buf[ENTRIES];
+};
+
+}  // namespace drivers
@@ -3,6 +3,7 @@
 #include <stdint.h>
 
 namespace drivers {
+namespace ml5238 {
 
 //     CONTROL REGISTER
 //     Control register map is shown below.
@@ -22,6 +23,30 @@ namespace drivers {
 //     others      TEST      R/W      00H      TEST (Don’t use) 
 
 
+static constexpr uint8_t REG_NOOP   = 0x00;
+static constexpr uint8_t REG_VMON   = 0x01;
+static constexpr uint8_t REG_IMON   = 0x02;
+static constexpr uint8_t REG_FET    = 0x03;
+static constexpr uint8_t REG_PSENSE = 0x04;
+static constexpr uint8_t REG_RSENSE = 0x05;
+static constexpr uint8_t REG_POWER  = 0x06;
+static constexpr uint8_t REG_STATUS = 0x07;
+static constexpr uint8_t REG_CBALH  = 0x08;
+static constexpr uint8_t REG_CBALL  = 0x09;
+static constexpr uint8_t REG_SETSC  = 0x0A;
+static constexpr uint8_t REG_COUNT  = 0x0B;   // addresses above SETSC are TEST
+
+// MCU INTERFACE: SPI mode 0, one 16 bit frame per access, /CS released between frames.
+// First byte  A6 A5 A4 A3 A2 A1 A0 RW   (Read=1 Write=0)
+// Second byte D7..D0 written on SDI, O7..O0 read back on SDO
+// SCK H/L pulse width 500ns min -> 1MHz max, /CS H pulse width 500ns min.
+static constexpr uint8_t SPI_READ  = 0x01;
+static constexpr uint8_t SPI_WRITE = 0x00;
+static constexpr uint32_t SPI_MAX_HZ = 1000000UL;
+
+static constexpr uint8_t spi_cmd(uint8_t reg, uint8_t rw) { return (uint8_t)((reg << 1) | rw); }
+static constexpr uint8_t spi_reg(uint8_t cmd) { return (uint8_t)(cmd >> 1); }
+
 // 1. NOOP register (Adrs = 00H)
 //                 7       6       5       4       3       2       1       0 
 // Bit name       NO7     NO6     NO5     NO4     NO3     NO2     NO1     NO0 
@@ -32,6 +57,15 @@ namespace drivers {
 
 
 
+static constexpr uint8_t VMON_CN_MASK = 0x0F;
+static constexpr uint8_t VMON_OUT     = 0x10;
+static constexpr uint8_t CELLS_MAX    = 16;
+
+// VMON pin outputs cell voltage x 0.5
+static constexpr uint16_t VMON_GAIN_DIV = 2;
+
+static constexpr uint8_t vmon_select(uint8_t cell) { return (uint8_t)(VMON_OUT | (cell & VMON_CN_MASK)); }
+
 // 2. VMON register (Adrs = 01H)
 // 
 // 7      6      5      4      3      2      1      0 
@@ -113,6 +147,16 @@ namespace drivers {
 
 
 
+static constexpr uint8_t IMON_GIM   = 0x01;
+static constexpr uint8_t IMON_ZERO  = 0x02;
+static constexpr uint8_t IMON_GCAL0 = 0x04;
+static constexpr uint8_t IMON_GCAL1 = 0x08;
+static constexpr uint8_t IMON_OUT   = 0x10;
+
+static constexpr uint16_t IMON_OFFSET_MV = 1000;   // VIMON at ISENSE = 0
+static constexpr uint8_t  IMON_GAIN_LO   = 10;     // GIM = 0
+static constexpr uint8_t  IMON_GAIN_HI   = 50;     // GIM = 1
+
 // 4. FET register (Adrs = 03H)
 // 
 // 7      6      5      4      3      2      1      0 
@@ -153,6 +197,10 @@ namespace drivers {
 
 
 
+static constexpr uint8_t FET_DF  = 0x01;
+static constexpr uint8_t FET_CF  = 0x02;
+static constexpr uint8_t FET_DRV = 0x10;
+
 // 5. PSENSE register (Adrs = 04H)
 // 
 // 7      6      5      4      3      2      1      0 
@@ -251,6 +299,18 @@ namespace drivers {
 
 
 
+static constexpr uint8_t PSENSE_PSL  = 0x01;
+static constexpr uint8_t PSENSE_RPSL = 0x02;
+static constexpr uint8_t PSENSE_IPSL = 0x04;
+static constexpr uint8_t PSENSE_EPSL = 0x08;
+static constexpr uint8_t PSENSE_PSH  = 0x10;
+static constexpr uint8_t PSENSE_RPSH = 0x20;
+static constexpr uint8_t PSENSE_IPSH = 0x40;
+static constexpr uint8_t PSENSE_EPSH = 0x80;
+
+// IPSL, IPSH (and IRS) may be set only 1 msec after the matching enable bit
+static constexpr uint16_t COMPARATOR_ARM_US = 1000;
+
 // 6. RSENSE register (Adrs = 05H)
 // 
 // 
@@ -328,6 +388,18 @@ namespace drivers {
 // 1      Load disconnected      Lower than 2.4V 
 
 
+static constexpr uint8_t RSENSE_RS  = 0x01;
+static constexpr uint8_t RSENSE_RRS = 0x02;
+static constexpr uint8_t RSENSE_IRS = 0x04;
+static constexpr uint8_t RSENSE_ERS = 0x08;
+static constexpr uint8_t RSENSE_SC  = 0x10;
+static constexpr uint8_t RSENSE_RSC = 0x20;
+static constexpr uint8_t RSENSE_ISC = 0x40;
+static constexpr uint8_t RSENSE_ESC = 0x80;
+
+// tsc [us] = CDLY [nF] x 100
+static constexpr uint32_t short_delay_us(uint16_t cdly_nF) { return (uint32_t)cdly_nF * 100; }
+
 // 7. POWER register (Adrs = 06H)
 // 
 // 7      6      5      4      3      2      1      0 
@@ -376,6 +448,10 @@ namespace drivers {
 // fully risen and after /RES pin output is fully changed from “L” level to “H” level.
 
 
+static constexpr uint8_t POWER_PSV   = 0x01;
+static constexpr uint8_t POWER_PDWN  = 0x08;
+static constexpr uint8_t POWER_PUPIN = 0x80;
+
 // 8. STATUS register (Adrs = 07H)
 // 
 // 
@@ -432,6 +508,15 @@ namespace drivers {
 
     
     
+static constexpr uint8_t STATUS_DF   = 0x01;
+static constexpr uint8_t STATUS_CF   = 0x02;
+static constexpr uint8_t STATUS_PSV  = 0x04;
+static constexpr uint8_t STATUS_INT  = 0x08;
+static constexpr uint8_t STATUS_RPSL = 0x10;
+static constexpr uint8_t STATUS_RPSH = 0x20;
+static constexpr uint8_t STATUS_RRS  = 0x40;
+static constexpr uint8_t STATUS_RSC  = 0x80;
+
 // 9. CBALH register (Adrs = 08H)
 // 
 // 7      6      5      4      3      2      1      0 
@@ -499,6 +584,22 @@ namespace drivers {
 
 
 
+// Both balancing registers are handled as one 16 bit mask, bit 0 = SW1 (V1-V0) ... bit 15 = SW16.
+// Rules (1) and (2) above forbid two ON switches one or two positions apart.
+static constexpr bool balance_legal(uint16_t mask) {
+    return (mask & (mask >> 1)) == 0 && (mask & (mask >> 2)) == 0;
+}
+
+static constexpr uint8_t balance_h(uint16_t mask) { return (uint8_t)(mask >> 8); }
+static constexpr uint8_t balance_l(uint16_t mask) { return (uint8_t)mask; }
+
+// Cell balancing current per switch, absolute maximum
+static constexpr uint16_t BALANCE_MAX_MA = 200;
+// Allowable power dissipation at Ta = 25C, 83C/W JEDEC 2 layer, Tj max 125C
+static constexpr uint16_t PD_MAX_MW      = 1200;
+// Balancing switch ON resistance, typ
+static constexpr uint16_t RBL_TYP_OHM    = 6;
+
 // 11. SETSC register (Adrs = 0AH)
 // 
 // 7      6      5      4      3      2      1      0 
@@ -537,5 +638,23 @@ namespace drivers {
 
 
 
+static constexpr uint8_t SETSC_MASK = 0x03;
+
+// Short current detecting voltage for SC1,SC0 = 0..3
+static constexpr uint16_t setsc_mV(uint8_t sc) { return (uint16_t)(((sc & SETSC_MASK) + 1) * 100); }
+
+// Cell mask for the connection table below, bit 0 = V1 cell. With less than 16 cells V16 is tied
+// to VDD_SW and the unused lower inputs to GND, so cells end at V15.
+static constexpr uint16_t cells_mask(uint8_t cells) {
+    return cells >= CELLS_MAX ? 0xFFFF : (uint16_t)(((1U << cells) - 1) << (CELLS_MAX - 1 - cells));
+}
+
+// SUPPLY CURRENT CHARACTERISTICS, typ, VDD + VDDP
+static constexpr uint16_t IDD_NORMAL_UA = 50;
+static constexpr uint16_t IDD_PSV_UA    = 25;
+static constexpr uint16_t IDD_PDWN_NA   = 100;
+
+}  // namespace ml5238
+
 }  // namespace drivers
 
@@ -0,0 +1,95 @@
+#include "ML5238_duty.h"
+
+namespace drivers {
+
+using namespace ml5238;
+
+double ML5238_DutyEnergy::charge_uAs(const ML5238_DutyConfig &cfg) const {
+    return ((double)normal_us * IDD_NORMAL_UA + (double)psv_us * IDD_PSV_UA + (double)mcu_run_us * cfg.mcu_run_uA +
+            (double)mcu_sleep_us * cfg.mcu_sleep_uA) * 1e-6;
+}
+
+double ML5238_DutyEnergy::avg_uA(const ML5238_DutyConfig &cfg) const {
+    return total_us() ? charge_uAs(cfg) * 1e6 / (double)total_us() : 0.0;
+}
+
+ML5238_Duty::ML5238_Duty(ML5238 &bms, ML5238_Port &port, const ML5238_DutyConfig &cfg)
+    : _bms(bms), _port(port), _cfg(cfg), _running(false), _period_ms(cfg.min_period_ms), _due_us(0),
+      _idle_since_us(0), _bursts(0), _active(0), _energy() {
+    for (uint8_t i = 0; i < CELLS_MAX; ++i) _last_mV[i] = 0;
+}
+
+void ML5238_Duty::start() {
+    if (_running) return;
+    _bms.set_balance(0);
+    _bms.set_power_save(true);
+    for (uint8_t i = 0; i < CELLS_MAX; ++i) _last_mV[i] = _bms.state().cell_mV[i];
+    _running = true;
+    _period_ms = _cfg.min_period_ms;
+    _idle_since_us = _port.micros();
+    _due_us = _idle_since_us + _period_ms * 1000;
+}
+
+void ML5238_Duty::stop() {
+    if (!_running) return;
+    const uint32_t now = _port.micros();
+    _energy.psv_us += now - _idle_since_us;
+    _energy.mcu_sleep_us += now - _idle_since_us;
+    _bms.set_power_save(false);
+    _running = false;
+}
+
+bool ML5238_Duty::service(uint32_t now_us) {
+    if (!_running || (int32_t)(now_us - _due_us) < 0) return false;
+    burst();
+    return true;
+}
+
+bool ML5238_Duty::activity(uint8_t status) const {
+    const ML5238_State &s = _bms.state();
+    if (s.faults || (status & (STATUS_RPSL | STATUS_RPSH | STATUS_RRS | STATUS_RSC))) return true;
+    if (s.current_mA >= _cfg.active_mA || s.current_mA <= -_cfg.active_mA) return true;
+    if (!_bursts) return false;
+    for (uint8_t i = 0; i < CELLS_MAX; ++i) {
+        const int32_t d = (int32_t)s.cell_mV[i] - _last_mV[i];
+        if (d >= _cfg.step_mV || d <= -(int32_t)_cfg.step_mV) return true;
+    }
+    return false;
+}
+
+void ML5238_Duty::burst() {
+    const uint32_t t0 = _port.micros();
+    if (_running) {
+        _energy.psv_us += t0 - _idle_since_us;
+        _energy.mcu_sleep_us += t0 - _idle_since_us;
+    }
+    _bms.set_power_save(false);
+    _port.delay_us(_cfg.wake_us);
+    _bms.scan_cells();
+    _bms.protect_step();
+
+    const uint8_t status = _bms.state().status;
+    if (activity(status)) {
+        _period_ms = _cfg.min_period_ms;
+        ++_active;
+    } else {
+        const uint32_t grown = _period_ms + _period_ms / 100 * _cfg.grow_pct;
+        _period_ms = grown < _cfg.max_period_ms ? grown : _cfg.max_period_ms;
+    }
+    for (uint8_t i = 0; i < CELLS_MAX; ++i) _last_mV[i] = _bms.state().cell_mV[i];
+    ++_bursts;
+
+    // Short detection and its interrupt keep running in PSV; a stale flag would hold /INTO
+    // and hide the next event
+    if (status & (STATUS_RPSL | STATUS_RPSH | STATUS_RRS)) _bms.clear_interrupts(status);
+    _bms.update(REG_RSENSE, (uint8_t)(_bms.shadow(REG_RSENSE) | RSENSE_ESC | RSENSE_ISC));
+    if (_running) _bms.set_power_save(true);
+
+    const uint32_t t1 = _port.micros();
+    _energy.normal_us += t1 - t0;
+    _energy.mcu_run_us += t1 - t0;
+    _idle_since_us = t1;
+    _due_us = t0 + _period_ms * 1000;
+}
+
+}  // namespace drivers
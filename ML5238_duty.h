@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include "ML5238.h"
+
+namespace drivers {
+
+struct ML5238_DutyConfig {
+    uint32_t min_period_ms;     // while the pack is active
+    uint32_t max_period_ms;     // storage
+    uint8_t grow_pct;           // a quiet burst stretches the period by this much
+    int32_t active_mA;          // |current| from this is activity
+    uint16_t step_mV;           // a cell moving this much since the last burst is activity
+    uint16_t wake_us;           // VMON/IMON restart after leaving PSV
+    // Energy model: the ML5238 from its datasheet supply currents, the MCU from these
+    uint16_t mcu_run_uA;
+    uint16_t mcu_sleep_uA;
+
+    ML5238_DutyConfig()
+        : min_period_ms(1000), max_period_ms(60000), grow_pct(50), active_mA(200), step_mV(5), wake_us(1000),
+          mcu_run_uA(3000), mcu_sleep_uA(2) {}
+};
+
+// Time spent per power state, and the charge it costs
+struct ML5238_DutyEnergy {
+    uint64_t normal_us;         // ML5238 out of PSV
+    uint64_t psv_us;
+    uint64_t mcu_run_us;        // MCU awake for the bursts
+    uint64_t mcu_sleep_us;
+
+    ML5238_DutyEnergy() : normal_us(0), psv_us(0), mcu_run_us(0), mcu_sleep_us(0) {}
+
+    uint64_t total_us() const { return normal_us + psv_us; }
+    // Charge drawn from the pack, uA s
+    double charge_uAs(const ML5238_DutyConfig &cfg) const;
+    double avg_uA(const ML5238_DutyConfig &cfg) const;
+};
+
+// Duty cycled measurement for storage and idle packs. The ML5238 stays in PSV, where cell and
+// current measurement and the PSENSE/RSENSE comparators stop while FET driving and short
+// detection go on. Each burst leaves PSV, scans the cells, reads current and STATUS, runs the
+// protection, makes sure short detection and its interrupt are armed with no stale flags
+// holding /INTO, and goes back to PSV. Activity (current, a cell moving, a fault or flag)
+// snaps the period to its minimum, quiet bursts stretch it towards the maximum. Balancing is
+// off in this mode.
+class ML5238_Duty {
+public:
+    ML5238_Duty(ML5238 &bms, ML5238_Port &port, const ML5238_DutyConfig &cfg = ML5238_DutyConfig());
+
+    // Enters PSV, the first burst is due one minimum period later
+    void start();
+    // Leaves PSV for good
+    void stop();
+    // Runs a burst if one is due, true if it did. The MCU may sleep until due_us() otherwise,
+    // or until /INTO: an edge should call burst() at once.
+    bool service(uint32_t now_us);
+    void burst();
+
+    uint32_t due_us() const { return _due_us; }
+    uint32_t period_ms() const { return _period_ms; }
+    uint32_t bursts() const { return _bursts; }
+    uint32_t active_bursts() const { return _active; }
+    const ML5238_DutyEnergy &energy() const { return _energy; }
+    const ML5238_DutyConfig &config() const { return _cfg; }
+
+private:
+    bool activity(uint8_t status) const;
+
+    ML5238 &_bms;
+    ML5238_Port &_port;
+    ML5238_DutyConfig _cfg;
+    bool _running;
+    uint32_t _period_ms;
+    uint32_t _due_us;
+    uint32_t _idle_since_us;    // end of the last burst
+    uint32_t _bursts;
+    uint32_t _active;
+    uint16_t _last_mV[ml5238::CELLS_MAX];
+    ML5238_DutyEnergy _energy;
+};
+
+}  // namespace drivers
@@ -0,0 +1,141 @@
+#include "ML5238_energy.h"
+#include "ML5238_regs.h"
+
+namespace drivers {
+
+using namespace ml5238;
+
+ML5238_EnergyCounters::ML5238_EnergyCounters() : drv_us(0), balance_us(0), frames(0), samples(0), wakes(0) {
+    for (uint8_t i = 0; i < ML5238_POWER_COUNT; ++i) state_us[i] = 0;
+    for (uint8_t i = 0; i < ML5238_DRAW_COUNT; ++i) draw_uAs[i] = 0.0;
+}
+
+uint64_t ML5238_EnergyCounters::total_us() const {
+    uint64_t us = 0;
+    for (uint8_t i = 0; i < ML5238_POWER_COUNT; ++i) us += state_us[i];
+    return us;
+}
+
+double ML5238_EnergyCounters::total_uAs() const {
+    double uAs = 0.0;
+    for (uint8_t i = 0; i < ML5238_DRAW_COUNT; ++i) uAs += draw_uAs[i];
+    return uAs;
+}
+
+double ML5238_EnergyCounters::avg_uA() const {
+    return total_us() ? total_uAs() * 1e6 / (double)total_us() : 0.0;
+}
+
+double ML5238_EnergyCounters::quiescent_uA() const {
+    return total_us() ? (total_uAs() - draw_uAs[ML5238_DRAW_BALANCE]) * 1e6 / (double)total_us() : 0.0;
+}
+
+ML5238_Energy::ML5238_Energy(ML5238_Port &port, const ML5238_EnergyConfig &cfg)
+    : _port(port), _cfg(cfg), _balance(0), _psense_open(false), _load_open(false), _last_us(port.micros()) {
+    for (uint8_t i = 0; i < REG_COUNT; ++i) _reg[i] = REG_RESET[i];
+}
+
+void ML5238_Energy::clear() {
+    _c = ML5238_EnergyCounters();
+    _last_us = _port.micros();
+}
+
+uint8_t ML5238_Energy::power_state() const {
+    if (_reg[REG_POWER] & POWER_PDWN) return ML5238_POWER_PDWN;
+    return _reg[REG_POWER] & POWER_PSV ? ML5238_POWER_PSV : ML5238_POWER_NORMAL;
+}
+
+void ML5238_Energy::update() { advance(_port.micros()); }
+
+void ML5238_Energy::advance(uint32_t now_us) {
+    const uint32_t dt = now_us - _last_us;
+    _last_us = now_us;
+    if (!dt) return;
+    const double s = dt * 1e-6;
+    const uint8_t state = power_state();
+    _c.state_us[state] += dt;
+    static const double IDD_UA[ML5238_POWER_COUNT] = { IDD_NORMAL_UA, IDD_PSV_UA, IDD_PDWN_NA * 1e-3 };
+    _c.draw_uAs[ML5238_DRAW_CHIP] += IDD_UA[state] * s;
+
+    // PDWN stops everything but the PSENSE pull-up, which only draws with a charger that wakes it
+    if (state == ML5238_POWER_PDWN) return;
+    const uint8_t fet = _reg[REG_FET];
+    const uint8_t fets = (uint8_t)((fet & FET_CF ? 1 : 0) + (fet & FET_DF ? 1 : 0));
+    _c.draw_uAs[ML5238_DRAW_FET] += (double)fets * _cfg.fet_uA * s;
+    if (fets && (fet & FET_DRV)) {
+        _c.draw_uAs[ML5238_DRAW_DRV] += _cfg.drv_uA * s;
+        _c.drv_us += dt;
+    }
+    // The comparators and their resistors stop in PSV
+    if (state == ML5238_POWER_NORMAL) {
+        if ((_reg[REG_PSENSE] & (PSENSE_EPSL | PSENSE_EPSH)) && !_psense_open)
+            _c.draw_uAs[ML5238_DRAW_PSENSE] += _cfg.psense_mV / 500.0 * s;
+        if ((_reg[REG_RSENSE] & RSENSE_ERS) && !_load_open)
+            _c.draw_uAs[ML5238_DRAW_RSENSE] += _cfg.rsense_mV / 2000.0 * s;
+    }
+    if (_balance) {
+        _c.draw_uAs[ML5238_DRAW_BALANCE] += _balance * 1000.0 * _cfg.cell_mV / (_cfg.balance_ohm + RBL_TYP_OHM) * s;
+        _c.balance_us += dt;
+    }
+}
+
+void ML5238_Energy::host(uint8_t draw, uint32_t t0, uint16_t uA) {
+    _c.draw_uAs[draw] += (double)(_port.micros() - t0) * 1e-6 * uA;
+}
+
+void ML5238_Energy::transfer(const uint8_t *tx, uint8_t *rx, uint8_t frames) {
+    const uint32_t t0 = _port.micros();
+    advance(t0);
+    if (power_state() == ML5238_POWER_PDWN) {
+        for (uint8_t i = 0; i < REG_COUNT; ++i) _reg[i] = REG_RESET[i];
+        _balance = 0;
+        _psense_open = _load_open = false;
+        ++_c.wakes;
+    }
+    // The driver passes null when it does not want the reads, they still tell the state
+    uint8_t local[2 * ML5238_Batch::MAX_FRAMES];
+    uint8_t *in = rx || frames > ML5238_Batch::MAX_FRAMES ? rx : local;
+    _port.transfer(tx, in, frames);
+    host(ML5238_DRAW_SPI, t0, _cfg.spi_uA);
+    _c.frames += frames;
+
+    for (uint8_t f = 0; f < frames; ++f) {
+        const uint8_t reg = spi_reg(tx[2 * f]);
+        if (reg >= REG_COUNT) continue;
+        if (!(tx[2 * f] & SPI_READ)) {
+            const uint8_t val = tx[2 * f + 1];
+            // A comparator just started has not shown the pin yet
+            if (reg == REG_PSENSE && (val & ~_reg[reg] & (PSENSE_EPSL | PSENSE_EPSH))) _psense_open = false;
+            if (reg == REG_RSENSE && (val & ~_reg[reg] & RSENSE_ERS)) _load_open = false;
+            _reg[reg] = val;
+        } else if (in) {
+            const uint8_t val = in[2 * f + 1];
+            if (reg == REG_FET || reg == REG_STATUS)
+                _reg[REG_FET] = (uint8_t)((_reg[REG_FET] & ~(FET_CF | FET_DF)) | (val & (FET_CF | FET_DF)));
+            else if (reg == REG_PSENSE) _psense_open = (val & (PSENSE_PSL | PSENSE_PSH)) != 0;
+            else if (reg == REG_RSENSE) _load_open = (val & RSENSE_RS) != 0;
+        }
+    }
+    uint16_t bal = (uint16_t)(_reg[REG_CBALH] << 8 | _reg[REG_CBALL]);
+    for (_balance = 0; bal; bal &= (uint16_t)(bal - 1)) ++_balance;
+}
+
+uint16_t ML5238_Energy::vmon_mV() {
+    const uint32_t t0 = _port.micros();
+    advance(t0);
+    const uint16_t mV = _port.vmon_mV();
+    host(ML5238_DRAW_ADC, t0, _cfg.adc_uA);
+    ++_c.samples;
+    return mV;
+}
+
+uint16_t ML5238_Energy::imon_mV() {
+    const uint32_t t0 = _port.micros();
+    advance(t0);
+    const uint16_t mV = _port.imon_mV();
+    host(ML5238_DRAW_ADC, t0, _cfg.adc_uA);
+    ++_c.samples;
+    return mV;
+}
+
+}  // namespace drivers
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+#include "ML5238.h"
+
+namespace drivers {
+
+enum : uint8_t {
+    ML5238_POWER_NORMAL,
+    ML5238_POWER_PSV,
+    ML5238_POWER_PDWN,
+    ML5238_POWER_COUNT
+};
+
+// Where the charge goes
+enum : uint8_t {
+    ML5238_DRAW_CHIP,           // VDD + VDDP supply current of the power state
+    ML5238_DRAW_FET,            // C_FET/D_FET held on
+    ML5238_DRAW_DRV,            // enhanced drive on top while DRV is set
+    ML5238_DRAW_PSENSE,         // 500k pull-up, with the charger holding the pin low
+    ML5238_DRAW_RSENSE,         // 2M pull-down, with the load holding the pin high
+    ML5238_DRAW_BALANCE,        // balancing switches, from the cells
+    ML5238_DRAW_SPI,            // host awake for bus transfers
+    ML5238_DRAW_ADC,            // host awake for VMON/IMON samples
+    ML5238_DRAW_COUNT
+};
+
+// Figures the datasheet does not give or that depend on the board. Measure yours.
+struct ML5238_EnergyConfig {
+    uint16_t fet_uA;            // per FET output held on
+    uint16_t drv_uA;            // extra while DRV is set
+    uint16_t psense_mV;         // pull-up rail
+    uint16_t rsense_mV;         // RSENSE pin with the load connected
+    uint16_t balance_ohm;       // external balancing resistor, RBL comes on top
+    uint16_t cell_mV;           // assumed for balancing, the port does not see the cells
+    uint16_t spi_uA;            // host current while transferring
+    uint16_t adc_uA;            // host current while sampling
+
+    ML5238_EnergyConfig()
+        : fet_uA(10), drv_uA(1000), psense_mV(3300), rsense_mV(3300), balance_ohm(33), cell_mV(3700),
+          spi_uA(3000), adc_uA(3000) {}
+};
+
+struct ML5238_EnergyCounters {
+    uint64_t state_us[ML5238_POWER_COUNT];
+    double draw_uAs[ML5238_DRAW_COUNT];
+    uint64_t drv_us;
+    uint64_t balance_us;        // at least one switch on
+    uint32_t frames;
+    uint32_t samples;
+    uint32_t wakes;             // returns from PDWN
+
+    ML5238_EnergyCounters();
+
+    uint64_t total_us() const;
+    double total_uAs() const;
+    double avg_uA() const;
+    // Without balancing, which drains the cells rather than supplying the electronics
+    double quiescent_uA() const;
+};
+
+// Energy account of one ML5238 and its host, kept between the driver and its port. Every frame
+// the driver sends is decoded into the chip state it leaves behind: power state, FET outputs and
+// DRV, comparators and their resistors, balancing switches. FET and PSENSE/RSENSE reads correct
+// it, a short clears the FETs behind the driver's back. The time between two port calls is
+// charged to the state at the first; bus transfers and ADC samples are charged to the host for
+// the time they take. A transfer after PDWN means VREG came back: the registers are at reset.
+// Port time is 32 bit, so update() must run at least every 70 minutes, also in PDWN.
+class ML5238_Energy : public ML5238_Port {
+public:
+    ML5238_Energy(ML5238_Port &port, const ML5238_EnergyConfig &cfg = ML5238_EnergyConfig());
+
+    void transfer(const uint8_t *tx, uint8_t *rx, uint8_t frames) override;
+    uint16_t vmon_mV() override;
+    uint16_t imon_mV() override;
+    uint32_t micros() override { return _port.micros(); }
+    void delay_us(uint32_t us) override { _port.delay_us(us); }
+    uint32_t set_clock(uint32_t hz) override { return _port.set_clock(hz); }
+
+    // Charges the time up to now
+    void update();
+    // Counters only, the chip state carries on
+    void clear();
+    const ML5238_EnergyCounters &counters() const { return _c; }
+    const ML5238_EnergyConfig &config() const { return _cfg; }
+    uint8_t power_state() const;
+
+private:
+    void advance(uint32_t now_us);
+    void host(uint8_t draw, uint32_t t0, uint16_t uA);
+
+    ML5238_Port &_port;
+    ML5238_EnergyConfig _cfg;
+    ML5238_EnergyCounters _c;
+    uint8_t _reg[ml5238::REG_COUNT];
+    uint8_t _balance;           // switches on
+    bool _psense_open;          // last read showed the charger open
+    bool _load_open;            // last read showed the load open
+    uint32_t _last_us;
+};
+
+}  // namespace drivers
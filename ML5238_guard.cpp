@@ -0,0 +1,163 @@
+#include "ML5238_guard.h"
+#include "ML5238.h"
+#include "ML5238_regs.h"
+
+namespace drivers {
+
+using namespace ml5238;
+
+namespace {
+
+enum : uint8_t { CHECK_CBAL = 1, CHECK_FET = 2, CHECK_SENSE = 4, CHECK_POWER = 8 };
+
+// Rules that apply to a write of each register, found from its fields in ML5238_regs.def
+constexpr uint8_t checks_of(uint8_t r) {
+    return (uint8_t)((r == FIELD_CBALH_SW9.reg || r == FIELD_CBALL_SW1.reg ? CHECK_CBAL : 0) |
+                     (r == FIELD_FET_DRV.reg ? CHECK_FET : 0) |
+                     // Latched comparators, their interrupt enables
+                     (REG_W0C[r] ? CHECK_SENSE : 0) | (r == FIELD_POWER_PDWN.reg ? CHECK_POWER : 0));
+}
+
+#define ML5238_BIT(reg, name, mask, access, gate)
+#define ML5238_REG(name, addr, reset) checks_of(addr),
+const uint8_t CHECKS[REG_COUNT] = {
+#include "ML5238_regs.def"
+};
+#undef ML5238_REG
+#undef ML5238_BIT
+
+// Interrupt enables that need the comparator running for COMPARATOR_ARM_US first: the gate of
+// the comparator output and the gate of its latch
+struct Arm {
+    uint8_t reg;
+    uint8_t enable;
+    uint8_t irq;
+};
+
+const Arm ARMS[3] = {
+    { FIELD_PSENSE_PSL.reg, FIELD_PSENSE_PSL.gate, FIELD_PSENSE_RPSL.gate },
+    { FIELD_PSENSE_PSH.reg, FIELD_PSENSE_PSH.gate, FIELD_PSENSE_RPSH.gate },
+    { FIELD_RSENSE_RS.reg, FIELD_RSENSE_RS.gate, FIELD_RSENSE_RRS.gate },
+};
+
+const char *const RULE_NAMES[ML5238_RULE_COUNT] = {
+    "ok", "test address", "adjacent balancing", "pdwn with fet on", "pdwn with charger",
+    "pdwn with pupin low", "drv too long", "interrupt armed early",
+};
+
+}  // namespace
+
+ML5238_Guard::ML5238_Guard(uint32_t drv_max_us, uint32_t fresh_us)
+    : _drv_max_us(drv_max_us), _fresh_us(fresh_us) {
+    reset();
+    for (uint8_t i = 0; i < ML5238_RULE_COUNT; ++i) _refused[i] = 0;
+}
+
+void ML5238_Guard::reset() {
+    for (uint8_t i = 0; i < REG_COUNT; ++i) _reg[i] = REG_RESET[i];
+    _psense = _power = _status = 0;
+    _seen = _armed = _drv_on = 0;
+    _psense_us = _power_us = _drv_us = 0;
+    for (uint8_t i = 0; i < SLOTS; ++i) _enable_us[i] = 0;
+}
+
+uint8_t ML5238_Guard::check_write(uint8_t reg, uint8_t val, uint32_t now_us) const {
+    if (reg >= REG_COUNT) return ML5238_RULE_TEST;
+    const uint8_t checks = CHECKS[reg];
+    if (!checks) return ML5238_RULE_OK;
+
+    if (checks & CHECK_CBAL) {
+        const uint16_t mask = reg == REG_CBALH ? (uint16_t)(val << 8 | _reg[REG_CBALL])
+                                               : (uint16_t)(_reg[REG_CBALH] << 8 | val);
+        if (!balance_legal(mask)) return ML5238_RULE_CBAL;
+    }
+    if ((checks & CHECK_FET) && (val & FET_DRV) && _drv_on && now_us - _drv_us > _drv_max_us)
+        return ML5238_RULE_DRV;
+    if (checks & CHECK_SENSE) {
+        for (uint8_t i = 0; i < SLOTS; ++i) {
+            const Arm &a = ARMS[i];
+            if (a.reg != reg || !(val & a.irq) || (_reg[reg] & a.irq)) continue;
+            // Newly set enable bits count from this write
+            const bool running = (_armed & (1U << i)) && (val & a.enable);
+            if (!running || now_us - _enable_us[i] < COMPARATOR_ARM_US) return ML5238_RULE_ARM;
+        }
+    }
+    if ((checks & CHECK_POWER) && (val & POWER_PDWN)) {
+        if ((_reg[REG_FET] | _status) & (FET_DF | FET_CF)) return ML5238_RULE_PDWN_FET;
+        // PSL or PSH read back 1 with its comparator running: charger open
+        const bool open = (_psense & (PSENSE_EPSL | PSENSE_PSL)) == (PSENSE_EPSL | PSENSE_PSL) ||
+                          (_psense & (PSENSE_EPSH | PSENSE_PSH)) == (PSENSE_EPSH | PSENSE_PSH);
+        if (!open || !fresh(SEEN_PSENSE, _psense_us, now_us)) return ML5238_RULE_PDWN_CHARGER;
+        if ((_power & POWER_PUPIN) || !fresh(SEEN_POWER, _power_us, now_us)) return ML5238_RULE_PDWN_PUPIN;
+    }
+    return ML5238_RULE_OK;
+}
+
+uint8_t ML5238_Guard::check(const ML5238_Batch &batch, uint32_t now_us, uint8_t *frame) const {
+    ML5238_Guard g(*this);
+    for (uint8_t f = 0; f < batch.size(); ++f) {
+        // A batch holds no TEST address and no rule looks at registers without checks
+        const uint8_t reg = batch.reg(f);
+        if (batch.is_read(f) || !CHECKS[reg]) continue;
+        const uint8_t rule = g.check_write(reg, batch.data(f), now_us);
+        if (rule != ML5238_RULE_OK) {
+            if (frame) *frame = f;
+            return rule;
+        }
+        g.wrote(reg, batch.data(f), now_us);
+    }
+    return ML5238_RULE_OK;
+}
+
+void ML5238_Guard::wrote(uint8_t reg, uint8_t val, uint32_t now_us) {
+    if (reg >= REG_COUNT) return;
+    const uint8_t old = _reg[reg];
+    _reg[reg] = val;
+    if (reg == REG_FET) {
+        if ((val & FET_DRV) && !_drv_on) _drv_us = now_us;
+        _drv_on = (val & FET_DRV) != 0;
+    } else if (CHECKS[reg] & CHECK_SENSE) {
+        for (uint8_t i = 0; i < SLOTS; ++i) {
+            const Arm &a = ARMS[i];
+            if (a.reg != reg) continue;
+            if ((val & a.enable) && !(old & a.enable)) _enable_us[i] = now_us;
+            if (val & a.enable) _armed |= (uint8_t)(1U << i);
+            else _armed &= (uint8_t)~(1U << i);
+        }
+    }
+}
+
+void ML5238_Guard::was_read(uint8_t reg, uint8_t val, uint32_t now_us) {
+    if (reg == REG_PSENSE) {
+        _psense = val;
+        _psense_us = now_us;
+        _seen |= SEEN_PSENSE;
+    } else if (reg == REG_POWER) {
+        _power = val;
+        _power_us = now_us;
+        _seen |= SEEN_POWER;
+    } else if (reg == REG_STATUS) {
+        _status = val;
+    }
+}
+
+void ML5238_Guard::apply(const ML5238_Batch &batch, uint32_t now_us) {
+    for (uint8_t f = 0; f < batch.size(); ++f) {
+        if (batch.is_read(f)) was_read(batch.reg(f), batch.result(f), now_us);
+        else wrote(batch.reg(f), batch.data(f), now_us);
+    }
+}
+
+bool ML5238_Guard::has_rules(uint8_t reg) {
+    return reg >= REG_COUNT || CHECKS[reg] != 0;
+}
+
+bool ML5238_Guard::drv_overdue(uint32_t now_us) const {
+    return _drv_on && now_us - _drv_us > _drv_max_us;
+}
+
+const char *ML5238_Guard::rule_name(uint8_t rule) {
+    return rule < ML5238_RULE_COUNT ? RULE_NAMES[rule] : "?";
+}
+
+}  // namespace drivers
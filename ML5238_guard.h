@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+#include "ML5238_defs.h"
+
+namespace drivers {
+
+class ML5238_Batch;
+
+enum : uint8_t {
+    ML5238_RULE_OK,
+    ML5238_RULE_TEST,           // address outside 00H-0AH
+    ML5238_RULE_CBAL,           // adjacent balancing switches
+    ML5238_RULE_PDWN_FET,       // PDWN with a FET on
+    ML5238_RULE_PDWN_CHARGER,   // PDWN without a fresh PSENSE read showing the charger open
+    ML5238_RULE_PDWN_PUPIN,     // PDWN without a fresh POWER read showing /PUPIN high
+    ML5238_RULE_DRV,            // DRV kept on past the limit
+    ML5238_RULE_ARM,            // IPSL, IPSH or IRS less than 1 ms after its enable bit
+    ML5238_RULE_COUNT
+};
+
+// Register access policy from the datasheet notes in ML5238_defs.h. Tracks what was written and
+// read, and refuses a command that would break a rule before it reaches the bus. Every check is
+// a table lookup plus a few bit operations, cheap enough to keep on in production.
+class ML5238_Guard {
+public:
+    // drv_max_us: longest DRV on time; fresh_us: age limit of the reads backing PDWN
+    explicit ML5238_Guard(uint32_t drv_max_us = 10000, uint32_t fresh_us = 10000);
+    // Registers back to initial values, after begin() or a wake from power down
+    void reset();
+
+    // ML5238_RULE_OK or the broken rule, the state is unchanged
+    uint8_t check_write(uint8_t reg, uint8_t val, uint32_t now_us) const;
+    uint8_t check_read(uint8_t reg) const { return reg < ml5238::REG_COUNT ? ML5238_RULE_OK : ML5238_RULE_TEST; }
+    // Whole batch in order against the state it builds up. Returns the rule, the bad frame through frame.
+    uint8_t check(const ML5238_Batch &batch, uint32_t now_us, uint8_t *frame = nullptr) const;
+
+    // Accepted traffic
+    void wrote(uint8_t reg, uint8_t val, uint32_t now_us);
+    void was_read(uint8_t reg, uint8_t val, uint32_t now_us);
+    void apply(const ML5238_Batch &batch, uint32_t now_us);
+    void refused(uint8_t rule) { ++_refused[rule < ML5238_RULE_COUNT ? rule : 0]; }
+
+    // False when no rule applies to a write of reg, whatever the data or state
+    static bool has_rules(uint8_t reg);
+
+    // DRV has been on too long, ML5238::tick() clears it
+    bool drv_overdue(uint32_t now_us) const;
+    uint32_t refused_count(uint8_t rule) const { return rule < ML5238_RULE_COUNT ? _refused[rule] : 0; }
+    static const char *rule_name(uint8_t rule);
+
+private:
+    enum { SLOT_PSL, SLOT_PSH, SLOT_RS, SLOTS };
+    enum { SEEN_PSENSE = 1, SEEN_POWER = 2 };
+
+    bool fresh(uint8_t seen, uint32_t at_us, uint32_t now_us) const {
+        return (_seen & seen) && now_us - at_us <= _fresh_us;
+    }
+
+    uint32_t _drv_max_us;
+    uint32_t _fresh_us;
+    uint8_t _reg[ml5238::REG_COUNT];    // written values
+    uint8_t _psense;                    // last read values
+    uint8_t _power;
+    uint8_t _status;
+    uint8_t _seen;
+    uint8_t _armed;                     // enable bit set, per slot
+    uint8_t _drv_on;
+    uint32_t _psense_us;
+    uint32_t _power_us;
+    uint32_t _drv_us;
+    uint32_t _enable_us[SLOTS];
+    uint32_t _refused[ML5238_RULE_COUNT];
+};
+
+}  // namespace drivers
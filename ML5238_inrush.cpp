@@ -0,0 +1,112 @@
+#include "ML5238_inrush.h"
+
+namespace drivers {
+
+using namespace ml5238;
+
+ML5238_Inrush::ML5238_Inrush(ML5238 &bms, ML5238_Port &port, const ML5238_InrushConfig &cfg)
+    : _bms(bms), _port(port), _cfg(cfg) {
+    _on.write(REG_SETSC, (uint8_t)(cfg.setsc & SETSC_MASK));
+    _fet_frame = _on.write(REG_FET, FET_DF | FET_DRV);
+    _on.compile();
+    _setsc_frame = _off.write(REG_SETSC, 0);
+    _off.read(REG_STATUS);
+    _off.read(REG_RSENSE);
+    _off.compile();
+    _drop_frame = _drop.write(REG_FET, 0);
+    _drop.read(REG_STATUS);
+    _drop.read(REG_RSENSE);
+    _drop.compile();
+}
+
+void ML5238_Inrush::restore(uint8_t &status, uint8_t &rsense) {
+    _off.set_data((uint8_t)_setsc_frame, (uint8_t)(_bms.config().setsc & SETSC_MASK));
+    _bms.run(_off);
+    status = _off.result(1);
+    rsense = _off.result(2);
+}
+
+uint8_t ML5238_Inrush::attempt(bool charge, ML5238_InrushResult &r) {
+    const uint8_t fets = (uint8_t)(FET_DF | (charge ? FET_CF : 0));
+    // Inside the IMON range, which at GIM 0 ends near -100 mV over the shunt, well short of a short
+    const int32_t settled = _cfg.settled_mA ? _cfg.settled_mA : _bms.config().discharge_oc_mA;
+
+    bool ok = true, drv = _cfg.drv_us != 0, tripped = false, done = false, seen = false;
+    _on.set_data((uint8_t)_fet_frame, (uint8_t)(fets | (drv ? FET_DRV : 0)));
+    if (!_bms.run(_on)) return ML5238_INRUSH_REFUSED;
+    const uint32_t t0 = _port.micros();
+    uint8_t calm = 0;
+    for (;;) {
+        const int32_t mA = _bms.imon_to_mA(_port.imon_mV());
+        const uint32_t t = _port.micros() - t0;
+        if (mA < r.peak_mA) r.peak_mA = mA;
+        // The gate is still rising at first, low current only counts once the inrush was seen
+        const bool low = mA < settled && mA > -settled;
+        if (!low) seen = true;
+        calm = low && (seen || t >= _cfg.hold_us) ? (uint8_t)(calm < 255 ? calm + 1 : calm) : 0;
+        if (drv && (t >= _cfg.drv_us || calm >= _cfg.settle_samples)) {
+            drv = false;
+            // The write and its check in one burst: a trip just before the write shows in RSC
+            _drop.set_data((uint8_t)_drop_frame, fets);
+            ok = _bms.run(_drop);
+            const uint8_t status = _drop.result(1);
+            tripped = ok && (!(status & STATUS_DF) || (status & STATUS_RSC) || (_drop.result(2) & RSENSE_RSC));
+            if (!ok || tripped) break;
+        }
+        if (calm >= _cfg.settle_samples) {
+            r.inrush_us = t;
+            done = true;
+            break;
+        }
+        if (t >= _cfg.window_us) break;
+    }
+
+    uint8_t status, rsense;
+    restore(status, rsense);
+    if (tripped || (status & STATUS_RSC) || (rsense & RSENSE_RSC) || !(status & STATUS_DF)) {
+        ++r.trips;
+        // The driver takes the short as its own: SC fault, RSC cleared, FET shadow from STATUS.
+        // A FET write that raced the short left D_FET on, the SC fault turns it off.
+        _bms.read_status();
+        _bms.set_fets(false, false);
+        return ML5238_INRUSH_TRIPPED;
+    }
+    if (!ok) {
+        _bms.set_fets(false, false);
+        return ML5238_INRUSH_REFUSED;
+    }
+    if (!done) {
+        _bms.set_fets(false, false);
+        return ML5238_INRUSH_TIMEOUT;
+    }
+    // The shadow already holds these, nothing goes out
+    _bms.set_fets(charge, true);
+    return ML5238_INRUSH_OK;
+}
+
+ML5238_InrushResult ML5238_Inrush::turn_on(bool charge) {
+    ML5238_InrushResult r = ML5238_InrushResult();
+    const uint32_t start = _port.micros();
+    if (_bms.state().faults & (ML5238_FAULT_UV | ML5238_FAULT_OCD | ML5238_FAULT_SC)) {
+        r.code = ML5238_INRUSH_REFUSED;
+        return r;
+    }
+    if (_bms.shadow(REG_FET) & FET_DF) {
+        _bms.set_fets(charge, true);
+        r.code = ML5238_INRUSH_OK;
+        return r;
+    }
+    // The driver's own view is off, so clearing a trip's fault does not turn the FETs on behind us
+    _bms.set_fets(false, false);
+    for (;;) {
+        ++r.attempts;
+        r.code = attempt(charge, r);
+        if (r.code != ML5238_INRUSH_TRIPPED || r.attempts >= _cfg.attempts) break;
+        _port.delay_us(_cfg.retry_us);
+        _bms.clear_faults();
+    }
+    r.total_us = _port.micros() - start;
+    return r;
+}
+
+}  // namespace drivers
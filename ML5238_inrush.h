@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include "ML5238.h"
+
+namespace drivers {
+
+enum : uint8_t {
+    ML5238_INRUSH_OK,
+    ML5238_INRUSH_TRIPPED,      // every attempt ended in a short detection
+    ML5238_INRUSH_TIMEOUT,      // current still high at the end of the window, FETs off
+    ML5238_INRUSH_REFUSED,      // a fault blocks discharge or the guard refused a step
+};
+
+struct ML5238_InrushConfig {
+    uint8_t setsc;              // SC1,SC0 while the load charges, above the normal one
+    uint32_t drv_us;            // enhanced drive window from turn-on, 0: no DRV
+    uint32_t window_us;         // longest inrush of one attempt
+    int32_t settled_mA;         // |current| below this ends the inrush, 0: the discharge over current limit
+    uint8_t settle_samples;     // ... for this many IMON samples in a row
+    uint32_t hold_us;           // ... and, if it never rose above, not before this, past the gate rise
+    uint8_t attempts;
+    uint32_t retry_us;          // pause after a trip, the load keeps part of its charge
+
+    ML5238_InrushConfig()
+        : setsc(3), drv_us(100), window_us(20000), settled_mA(0), settle_samples(5), hold_us(3000), attempts(3),
+          retry_us(20000) {}
+};
+
+struct ML5238_InrushResult {
+    uint8_t code;
+    uint8_t attempts;
+    uint8_t trips;
+    int32_t peak_mA;            // largest discharge current IMON showed, negative
+    uint32_t inrush_us;         // turn-on to settled, last attempt
+    uint32_t total_us;          // call to return
+};
+
+// D_FET turn-on into capacitive loads such as inverters. A plain turn-on charges the load
+// capacitance through the slowly rising gate: for a large load the current stays above SETSC for
+// longer than tsc, the short detection clears the FETs and the next try starts over. Here one burst
+// raises SETSC and turns the FETs on, with DRV for drv_us so the gate spends less time in the linear
+// region and the FET takes less of the charge energy; held too long, the peak passes even the
+// raised threshold. DRV is dropped by a burst that writes FET and reads STATUS and RSENSE back, so
+// a trip just before the write, which the write would undo, is still seen. IMON is sampled
+// throughout, and once the current has settled one burst restores SETSC and reads STATUS and RSENSE. Short detection stays armed the whole time, only at
+// the higher level, and each attempt is bounded by window_us. A trip is handed to the driver as
+// usual and retried after retry_us, up to attempts.
+class ML5238_Inrush {
+public:
+    ML5238_Inrush(ML5238 &bms, ML5238_Port &port, const ML5238_InrushConfig &cfg = ML5238_InrushConfig());
+
+    // Blocks for at most attempts x (window_us + retry_us). D_FET already on only syncs C_FET.
+    ML5238_InrushResult turn_on(bool charge);
+    const ML5238_InrushConfig &config() const { return _cfg; }
+
+private:
+    uint8_t attempt(bool charge, ML5238_InrushResult &r);
+    void restore(uint8_t &status, uint8_t &rsense);
+
+    ML5238 &_bms;
+    ML5238_Port &_port;
+    ML5238_InrushConfig _cfg;
+    ML5238_Batch _on;           // SETSC high, FETs on with DRV
+    ML5238_Batch _off;          // SETSC back, STATUS, RSENSE
+    ML5238_Batch _drop;         // FETs without DRV, STATUS, RSENSE
+    int8_t _fet_frame;
+    int8_t _drop_frame;
+    int8_t _setsc_frame;
+};
+
+}  // namespace drivers
@@ -0,0 +1,69 @@
+#include "ML5238_irq.h"
+
+namespace drivers {
+
+using namespace ml5238;
+
+ML5238_Irq::ML5238_Irq(ML5238 &bms, const ML5238_IrqConfig &cfg)
+    : _bms(bms), _cfg(cfg), _mode(ML5238_IRQ_INTERRUPT), _pending(false), _edges(0), _started(false),
+      _window_start(0), _window_edges(0), _busy_polls(0), _next_poll(0), _stats() {}
+
+void ML5238_Irq::on_edge() {
+    ++_edges;
+    _pending = true;
+}
+
+bool ML5238_Irq::handle() {
+    const uint32_t t0 = _bms.transactions();
+    _bms.read_status();
+    ++_stats.status_reads;
+    const uint8_t f = (uint8_t)(_bms.state().status & (STATUS_RPSL | STATUS_RPSH | STATUS_RRS));
+    if (f) {
+        _bms.clear_interrupts(f);
+        _stats.flags += (f & STATUS_RPSL ? 1 : 0) + (f & STATUS_RPSH ? 1 : 0) + (f & STATUS_RRS ? 1 : 0);
+    }
+    _stats.frames += _bms.transactions() - t0;
+    return f != 0;
+}
+
+bool ML5238_Irq::service(uint32_t now_us) {
+    if (!_started) {
+        _started = true;
+        _window_start = now_us;
+        _window_edges = _edges;
+    }
+    bool bus = false;
+    if (_mode == ML5238_IRQ_INTERRUPT) {
+        if (_pending) {
+            _pending = false;
+            handle();
+            bus = true;
+        }
+    } else if ((int32_t)(now_us - _next_poll) >= 0) {
+        _next_poll += _cfg.poll_us;
+        if ((int32_t)(now_us - _next_poll) >= 0) _next_poll = now_us + _cfg.poll_us;
+        if (handle()) ++_busy_polls;
+        bus = true;
+    }
+
+    const uint32_t dt = now_us - _window_start;
+    if (dt < _cfg.window_us) return bus;
+    const uint32_t edges = _edges - _window_edges;
+    _stats.edges += edges;
+    if (_mode == ML5238_IRQ_INTERRUPT && (uint64_t)edges * 1000000 > (uint64_t)_cfg.storm_per_s * dt) {
+        _mode = ML5238_IRQ_POLLING;
+        _next_poll = now_us;
+        ++_stats.to_polling;
+    } else if (_mode == ML5238_IRQ_POLLING && (uint64_t)_busy_polls * 1000000 < (uint64_t)_cfg.calm_per_s * dt) {
+        _mode = ML5238_IRQ_INTERRUPT;
+        // A flag latched while masked leaves the line low without a new edge
+        _pending = true;
+        ++_stats.to_interrupt;
+    }
+    _window_start = now_us;
+    _window_edges = _edges;
+    _busy_polls = 0;
+    return bus;
+}
+
+}  // namespace drivers
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include "ML5238.h"
+
+namespace drivers {
+
+enum : uint8_t {
+    ML5238_IRQ_INTERRUPT,       // /INTO unmasked, every edge gets a STATUS read
+    ML5238_IRQ_POLLING,         // /INTO masked, STATUS read every poll_us
+};
+
+struct ML5238_IrqConfig {
+    uint16_t storm_per_s;       // edges per second that switch to polling
+    uint16_t calm_per_s;        // polls finding flags per second below which the interrupt returns
+    uint32_t window_us;         // rates are measured over this
+    uint32_t poll_us;
+
+    ML5238_IrqConfig() : storm_per_s(200), calm_per_s(20), window_us(100000), poll_us(5000) {}
+};
+
+struct ML5238_IrqStats {
+    uint32_t edges;
+    uint32_t status_reads;
+    uint32_t frames;            // STATUS reads, flag clears and what read_status() adds
+    uint32_t flags;             // RPSL/RPSH/RRS bits found set
+    uint32_t to_polling;
+    uint32_t to_interrupt;
+};
+
+// /INTO handling in the style of NAPI. Normally each edge is served by one STATUS read and the
+// clears of the flags it shows. When edges come faster than storm_per_s, e.g. a bouncing charger
+// or load, the line is masked and STATUS is polled instead: all edges of a poll period collapse
+// into one read and at most one clear per register. Once polls rarely find flags the line is
+// unmasked again, with one read for whatever latched meanwhile.
+class ML5238_Irq {
+public:
+    explicit ML5238_Irq(ML5238 &bms, const ML5238_IrqConfig &cfg = ML5238_IrqConfig());
+
+    // From the /INTO falling edge interrupt, no bus access
+    void on_edge();
+    // Main loop: serves a pending edge or a due poll, true if it used the bus
+    bool service(uint32_t now_us);
+
+    uint8_t mode() const { return _mode; }
+    // The board masks the /INTO interrupt while this is false
+    bool irq_enabled() const { return _mode == ML5238_IRQ_INTERRUPT; }
+    // Next poll while polling
+    uint32_t due_us() const { return _next_poll; }
+    const ML5238_IrqStats &stats() const { return _stats; }
+    void clear_stats() { _stats = ML5238_IrqStats(); }
+
+private:
+    bool handle();
+
+    ML5238 &_bms;
+    ML5238_IrqConfig _cfg;
+    uint8_t _mode;
+    volatile bool _pending;
+    volatile uint32_t _edges;
+    bool _started;
+    uint32_t _window_start;
+    uint32_t _window_edges;     // _edges at the window start
+    uint32_t _busy_polls;
+    uint32_t _next_poll;
+    ML5238_IrqStats _stats;
+};
+
+}  // namespace drivers
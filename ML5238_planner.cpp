@@ -0,0 +1,119 @@
+#include "ML5238_planner.h"
+
+namespace drivers {
+
+using namespace ml5238;
+
+namespace {
+
+const uint16_t NOMINAL_CELL_MV = 3700;
+
+}  // namespace
+
+ML5238_BalancePlanner::ML5238_BalancePlanner(uint16_t pd_budget_mW, uint16_t balance_ohm,
+                                             uint16_t settle_s, int32_t rest_mA)
+    : _pd_budget_mW(pd_budget_mW), _balance_ohm(balance_ohm ? balance_ohm : 1),
+      _settle_us((uint32_t)settle_s * 1000000), _rest_mA(rest_mA), _started(false), _dirty(false),
+      _mask(0), _last_us(0), _rest_us(0), _replans(0) {
+    // Switch loss P = I^2 x RBL per closed switch
+    const uint32_t ma = NOMINAL_CELL_MV / _balance_ohm;
+    const uint32_t mw = ma * ma * RBL_TYP_OHM / 1000;
+    const uint32_t n = mw ? _pd_budget_mW / mw : CELLS_MAX;
+    _max_on = (uint8_t)(n < 1 ? 1 : (n > CELLS_MAX ? CELLS_MAX : n));
+    for (uint8_t i = 0; i < CELLS_MAX; ++i) _need_ms[i] = 0;
+}
+
+uint32_t ML5238_BalancePlanner::finish_s() const {
+    uint64_t sum = 0;
+    uint32_t longest = 0;
+    for (uint8_t i = 0; i < CELLS_MAX; ++i) {
+        sum += _need_ms[i];
+        if (_need_ms[i] > longest) longest = _need_ms[i];
+    }
+    // At most every third switch can be closed
+    const uint8_t parallel = _max_on < (CELLS_MAX + 2) / 3 ? _max_on : (CELLS_MAX + 2) / 3;
+    const uint64_t spread = sum / parallel;
+    return (uint32_t)((spread > longest ? spread : longest) / 1000);
+}
+
+void ML5238_BalancePlanner::estimate(const ML5238_State &s, const ML5238_Config &cfg, uint16_t cells) {
+    // OCV is monotonic, the lowest cell has the lowest SOC
+    const uint16_t min_soc = ML5238::ocv_soc_permille(s.min_mV);
+    const uint64_t mAs_per_permille = (uint64_t)cfg.capacity_mAh * 3600 / 1000;
+    for (uint8_t i = 0; i < CELLS_MAX; ++i) {
+        if (!(cells & (1U << i))) continue;
+        const uint32_t bleed_mA = s.cell_mV[i] / _balance_ohm;
+        if (!bleed_mA) continue;
+        // One permille of SOC is the resolution of the estimate, smaller changes keep the plan
+        const uint64_t step_ms = mAs_per_permille * 1000 / bleed_mA;
+        const uint64_t need = (uint64_t)(ML5238::ocv_soc_permille(s.cell_mV[i]) - min_soc) * step_ms;
+        const uint64_t old = _need_ms[i];
+        if (need > old + step_ms || need + step_ms < old) {
+            _need_ms[i] = need > 0xFFFFFFFFUL ? 0xFFFFFFFFUL : (uint32_t)need;
+            _dirty = true;
+        }
+    }
+}
+
+void ML5238_BalancePlanner::plan() {
+    uint16_t left = 0, out = 0;
+    for (uint8_t i = 0; i < CELLS_MAX; ++i)
+        if (_need_ms[i]) left |= (uint16_t)(1U << i);
+    // Longest remaining first keeps the total balancing time short
+    uint8_t on = 0;
+    while (left && on < _max_on) {
+        uint8_t top = 0;
+        uint32_t top_ms = 0;
+        for (uint8_t i = 0; i < CELLS_MAX; ++i) {
+            if ((left & (1U << i)) && _need_ms[i] >= top_ms) {
+                top = i;
+                top_ms = _need_ms[i];
+            }
+        }
+        left &= (uint16_t)~(1U << top);
+        if (balance_legal((uint16_t)(out | (1U << top)))) {
+            out |= (uint16_t)(1U << top);
+            ++on;
+        }
+    }
+    _mask = out;
+    _dirty = false;
+    ++_replans;
+}
+
+uint16_t ML5238_BalancePlanner::decide(const ML5238_State &s, const ML5238_Config &cfg, uint16_t cells) {
+    if (!_started) {
+        _started = true;
+        _last_us = s.time_us;
+    }
+    const uint32_t dt_us = s.time_us - _last_us;
+    const uint32_t dt_ms = dt_us / 1000;
+    _last_us += dt_ms * 1000;
+
+    for (uint8_t i = 0; i < CELLS_MAX; ++i) {
+        if (!(s.balance & (1U << i)) || !_need_ms[i]) continue;
+        if (_need_ms[i] > dt_ms) {
+            _need_ms[i] -= dt_ms;
+        } else {
+            _need_ms[i] = 0;
+            _dirty = true;
+        }
+    }
+
+    if (s.current_mA <= _rest_mA && s.current_mA >= -_rest_mA) {
+        // The remainder under 1 ms stays in _last_us and counts next time
+        _rest_us += dt_ms * 1000;
+        if (_rest_us >= _settle_us) {
+            estimate(s, cfg, cells);
+            _rest_us = 0;
+        }
+    } else {
+        _rest_us = 0;
+    }
+
+    if (s.current_mA < -_rest_mA) return 0;
+    if (_dirty) plan();
+    return _mask;
+}
+
+}  // namespace drivers
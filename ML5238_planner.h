@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include "ML5238_balance.h"
+
+namespace drivers {
+
+// Predictive balancing. At rest the planner converts per cell SOC differences into the bleed time
+// each cell needs to reach the lowest one, then spends that time during charge and rest periods.
+// Bleed time is counted down from the switches that were actually on, the plan is only redone
+// when a cell finishes or a new rest estimate changes a cell.
+//
+// The number of simultaneous switches is capped so the switch loss I^2 x RBL stays within
+// pd_budget_mW, a derated share of the allowable power dissipation.
+class ML5238_BalancePlanner : public ML5238_BalancePolicy {
+public:
+    explicit ML5238_BalancePlanner(uint16_t pd_budget_mW = 300, uint16_t balance_ohm = 42,
+                                   uint16_t settle_s = 60, int32_t rest_mA = 1000);
+
+    uint16_t decide(const ML5238_State &s, const ML5238_Config &cfg, uint16_t cells) override;
+
+    uint32_t remaining_s(uint8_t cell) const { return _need_ms[cell] / 1000; }
+    // Lower bound of the balancing time left with the switch cap and neighbour rules
+    uint32_t finish_s() const;
+    uint8_t max_on() const { return _max_on; }
+    uint32_t replans() const { return _replans; }
+
+private:
+    void estimate(const ML5238_State &s, const ML5238_Config &cfg, uint16_t cells);
+    void plan();
+
+    uint16_t _pd_budget_mW;
+    uint16_t _balance_ohm;
+    uint32_t _settle_us;
+    int32_t _rest_mA;
+    uint8_t _max_on;
+    bool _started;
+    bool _dirty;
+    uint16_t _mask;
+    uint32_t _last_us;
+    uint32_t _rest_us;          // rest time accumulated since the last estimate
+    uint32_t _replans;
+    uint32_t _need_ms[ml5238::CELLS_MAX];
+};
+
+}  // namespace drivers
@@ -0,0 +1,73 @@
+#include "ML5238_regs.h"
+
+namespace drivers {
+namespace ml5238 {
+
+#define ML5238_REG(name, addr, reset)
+#define ML5238_BIT(reg, name, mask, access, gate) { FIELD_##reg##_##name, #name },
+const FieldDesc FIELDS[FIELD_COUNT] = {
+#include "ML5238_regs.def"
+};
+#undef ML5238_REG
+#undef ML5238_BIT
+
+namespace {
+
+#define ML5238_BIT(reg, name, mask, access, gate)
+#define ML5238_REG(name, addr, reset) #name,
+const char *const REG_NAME[REG_COUNT] = {
+#include "ML5238_regs.def"
+};
+#undef ML5238_REG
+#undef ML5238_BIT
+
+// Appends while there is room, keeps one byte for the terminator
+struct Out {
+    char *buf;
+    uint8_t len;
+    uint8_t n;
+
+    void put(char c) {
+        if (n + 1 < len) buf[n++] = c;
+    }
+    void put(const char *s) {
+        while (*s) put(*s++);
+    }
+    void put(uint8_t v) {
+        if (v >= 100) put((char)('0' + v / 100));
+        if (v >= 10) put((char)('0' + v / 10 % 10));
+        put((char)('0' + v % 10));
+    }
+};
+
+}  // namespace
+
+const char *reg_name(uint8_t reg) {
+    return reg < REG_COUNT ? REG_NAME[reg] : "TEST";
+}
+
+uint8_t decode(uint8_t reg, uint8_t val, char *buf, uint8_t len) {
+    if (!buf || !len) return 0;
+    Out o = { buf, len, 0 };
+    o.put(reg_name(reg));
+    if (reg >= REG_COUNT) {
+        o.put('=');
+        o.put(val);
+    }
+    for (uint8_t i = 0; i < FIELD_COUNT && reg < REG_COUNT; ++i) {
+        const Field &f = FIELDS[i].f;
+        if (f.reg != reg || !(val & f.mask)) continue;
+        o.put(' ');
+        o.put(FIELDS[i].name);
+        // Single bits by name only, fields with their value
+        if (f.mask != field_lsb(f.mask)) {
+            o.put('=');
+            o.put(field_get(f, val));
+        }
+    }
+    buf[o.n] = 0;
+    return o.n;
+}
+
+}  // namespace ml5238
+}  // namespace drivers
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stdint.h>
+#include "ML5238_defs.h"
+
+namespace drivers {
+namespace ml5238 {
+
+// Tables expanded from ML5238_regs.def, all constexpr. Driver, simulator, guard and log
+// decoder take their masks from here instead of encoding the register semantics again.
+
+enum : uint8_t { ACCESS_RW, ACCESS_RO, ACCESS_W0C };
+
+// One bit or field of a register
+struct Field {
+    uint8_t reg;
+    uint8_t mask;
+    uint8_t access;
+    uint8_t gate;   // same register bits that must be 1 for the field to read other than 0
+};
+
+static constexpr uint8_t field_lsb(uint8_t mask) { return (uint8_t)(mask & -mask); }
+static constexpr uint8_t field_get(Field f, uint8_t v) { return (uint8_t)((v & f.mask) / field_lsb(f.mask)); }
+
+// FIELD_PSENSE_RPSL, FIELD_VMON_CN, ...
+#define ML5238_REG(name, addr, reset)
+#define ML5238_BIT(reg, name, mask, access, gate) \
+    static constexpr Field FIELD_##reg##_##name = { REG_##reg, (mask), ACCESS_##access, (gate) };
+#include "ML5238_regs.def"
+#undef ML5238_REG
+#undef ML5238_BIT
+
+// Bits of register r with access a
+static constexpr uint8_t reg_mask(uint8_t r, uint8_t a) {
+    return (uint8_t)(0
+#define ML5238_REG(name, addr, reset)
+#define ML5238_BIT(reg, name, mask, access, gate) | (REG_##reg == r && ACCESS_##access == a ? (mask) : 0)
+#include "ML5238_regs.def"
+#undef ML5238_REG
+#undef ML5238_BIT
+    );
+}
+
+// W0C bits fixed to 0 while the enable bit right above them is 0
+static constexpr uint8_t reg_gated_low(uint8_t r) {
+    return (uint8_t)(0
+#define ML5238_REG(name, addr, reset)
+#define ML5238_BIT(reg, name, mask, access, gate) \
+    | (REG_##reg == r && ACCESS_##access == ACCESS_W0C && (gate) == ((mask) << 1) ? (mask) : 0)
+#include "ML5238_regs.def"
+#undef ML5238_REG
+#undef ML5238_BIT
+    );
+}
+
+// Sum of the field masks, equal to their OR when no two fields overlap
+static constexpr uint16_t reg_mask_sum(uint8_t r) {
+    return (uint16_t)(0
+#define ML5238_REG(name, addr, reset)
+#define ML5238_BIT(reg, name, mask, access, gate) + (REG_##reg == r ? (mask) : 0)
+#include "ML5238_regs.def"
+#undef ML5238_REG
+#undef ML5238_BIT
+    );
+}
+
+static constexpr uint8_t reg_used(uint8_t r) {
+    return (uint8_t)(reg_mask(r, ACCESS_RW) | reg_mask(r, ACCESS_RO) | reg_mask(r, ACCESS_W0C));
+}
+
+// Per register tables, indexed by address
+#define ML5238_BIT(reg, name, mask, access, gate)
+#define ML5238_REG(name, addr, reset) (reset),
+static constexpr uint8_t REG_RESET[] = {
+#include "ML5238_regs.def"
+};
+#undef ML5238_REG
+#define ML5238_REG(name, addr, reset) reg_mask(addr, ACCESS_RW),
+static constexpr uint8_t REG_WRITABLE[] = {
+#include "ML5238_regs.def"
+};
+#undef ML5238_REG
+#define ML5238_REG(name, addr, reset) reg_mask(addr, ACCESS_W0C),
+static constexpr uint8_t REG_W0C[] = {
+#include "ML5238_regs.def"
+};
+#undef ML5238_REG
+#define ML5238_REG(name, addr, reset) reg_gated_low(addr),
+static constexpr uint8_t REG_GATED_LOW[] = {
+#include "ML5238_regs.def"
+};
+#undef ML5238_REG
+#define ML5238_REG(name, addr, reset) (addr),
+static constexpr uint8_t REG_ADDR[] = {
+#include "ML5238_regs.def"
+};
+#undef ML5238_REG
+#undef ML5238_BIT
+
+static constexpr bool regs_in_order(uint8_t i) {
+    return i >= REG_COUNT || (REG_ADDR[i] == i && regs_in_order((uint8_t)(i + 1)));
+}
+
+static_assert(sizeof(REG_ADDR) == REG_COUNT && regs_in_order(0), "ML5238_regs.def: one line per register, in address order");
+
+#define ML5238_BIT(reg, name, mask, access, gate)
+#define ML5238_REG(name, addr, reset)                                                   \
+    static_assert((addr) == REG_##name, "ML5238_regs.def: " #name " address");           \
+    static_assert(reg_mask_sum(addr) == reg_used(addr), "ML5238_regs.def: " #name " fields overlap");
+#include "ML5238_regs.def"
+#undef ML5238_REG
+#undef ML5238_BIT
+
+// The simulator models every W0C flag as gated by the enable right above it
+static_assert(REG_GATED_LOW[REG_PSENSE] == REG_W0C[REG_PSENSE] && REG_GATED_LOW[REG_RSENSE] == REG_W0C[REG_RSENSE],
+              "ML5238_regs.def: W0C flag without its enable");
+
+#define ML5238_REG(name, addr, reset)
+#define ML5238_BIT(reg, name, mask, access, gate) +1
+static constexpr uint8_t FIELD_COUNT = 0
+#include "ML5238_regs.def"
+    ;
+#undef ML5238_REG
+#undef ML5238_BIT
+
+struct FieldDesc {
+    Field f;
+    const char *name;
+};
+
+// All fields in .def order, grouped by register
+extern const FieldDesc FIELDS[FIELD_COUNT];
+const char *reg_name(uint8_t reg);
+// Register value as text for logs, e.g. "PSENSE EPSL IPSL RPSL" or "VMON CN=5 OUT".
+// Always terminates buf, returns the length without the terminator.
+uint8_t decode(uint8_t reg, uint8_t val, char *buf, uint8_t len);
+
+}  // namespace ml5238
+}  // namespace drivers
@@ -0,0 +1,93 @@
+#include "ML5238_sched.h"
+
+namespace drivers {
+
+ML5238_Sched::ML5238_Sched(ML5238 &bms, ML5238_Port &port, uint8_t burst_frames)
+    : _bms(bms), _port(port), _burst_frames(burst_frames ? burst_frames : 1) {
+    for (uint8_t c = 0; c < ML5238_CLASS_COUNT; ++c) _q[c].head = _q[c].n = 0;
+    clear_stats();
+}
+
+void ML5238_Sched::clear_stats() {
+    for (uint8_t c = 0; c < ML5238_CLASS_COUNT; ++c) _stats[c] = ML5238_ClassStats();
+}
+
+bool ML5238_Sched::submit(ML5238_Batch &batch, uint8_t cls, ML5238_JobDone done, void *ctx) {
+    if (cls >= ML5238_CLASS_COUNT) return false;
+    Queue &q = _q[cls];
+    if (q.n >= QUEUE) return false;
+    Job &j = q.job[(q.head + q.n) % QUEUE];
+    j.batch = &batch;
+    j.done = done;
+    j.ctx = ctx;
+    j.queued_us = _port.micros();
+    j.next = 0;
+    ++q.n;
+    return true;
+}
+
+bool ML5238_Sched::idle() const {
+    for (uint8_t c = 0; c < ML5238_CLASS_COUNT; ++c)
+        if (_q[c].n) return false;
+    return true;
+}
+
+void ML5238_Sched::finish(uint8_t cls, bool ok, uint32_t now_us) {
+    Queue &q = _q[cls];
+    Job j = q.job[q.head];
+    q.head = (uint8_t)((q.head + 1) % QUEUE);
+    --q.n;
+    ML5238_ClassStats &st = _stats[cls];
+    const uint32_t latency = now_us - j.queued_us;
+    ++st.jobs;
+    st.latency_sum_us += latency;
+    if (latency > st.latency_max_us) st.latency_max_us = latency;
+    if (j.done) j.done(*j.batch, ok, j.ctx);
+}
+
+bool ML5238_Sched::step() {
+    uint8_t cls = 0;
+    while (cls < ML5238_CLASS_COUNT && !_q[cls].n) ++cls;
+    if (cls == ML5238_CLASS_COUNT) return false;
+
+    Job &j = _q[cls].job[_q[cls].head];
+    ML5238_Batch &b = *j.batch;
+    ML5238_ClassStats &st = _stats[cls];
+    const uint32_t start = _port.micros();
+    if (!j.next) {
+        const uint32_t wait = start - j.queued_us;
+        if (wait > st.wait_max_us) st.wait_max_us = wait;
+    }
+    if (j.next >= b._n) {
+        finish(cls, true, start);
+        return true;
+    }
+
+    // PROTECT goes out whole, the others one burst at a time
+    uint8_t n = (uint8_t)(b._n - j.next);
+    bool ok;
+    if (cls == ML5238_CLASS_PROTECT || (!j.next && n <= _burst_frames)) {
+        ok = _bms.run(b);
+    } else {
+        if (n > _burst_frames) n = _burst_frames;
+        _burst._n = n;
+        _burst._compiled = false;
+        for (uint8_t i = 0; i < 2 * n; ++i) _burst._tx[i] = b._tx[2 * j.next + i];
+        ok = _bms.run(_burst);
+        if (ok)
+            for (uint8_t i = 0; i < 2 * n; ++i) b._rx[2 * j.next + i] = _burst._rx[i];
+    }
+    const uint32_t now = _port.micros();
+    ++st.bursts;
+    st.bus_us += now - start;
+    if (ok) {
+        st.frames += n;
+        j.next = (uint8_t)(j.next + n);
+    } else {
+        ++st.refused;
+    }
+    if (!ok || j.next >= b._n) finish(cls, ok, now);
+    return true;
+}
+
+}  // namespace drivers
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include "ML5238.h"
+
+namespace drivers {
+
+enum : uint8_t {
+    ML5238_CLASS_PROTECT,       // FET writes, STATUS/RSENSE after an interrupt
+    ML5238_CLASS_CONTROL,       // per tick scan and balancing
+    ML5238_CLASS_DIAG,          // diagnostics, calibration, clock tuning
+    ML5238_CLASS_COUNT
+};
+
+typedef void (*ML5238_JobDone)(ML5238_Batch &batch, bool ok, void *ctx);
+
+struct ML5238_ClassStats {
+    uint32_t jobs;
+    uint32_t bursts;
+    uint32_t frames;
+    uint32_t refused;           // bursts the guard refused, the rest of the job is dropped
+    uint64_t bus_us;            // time spent in this class's bursts
+    uint32_t wait_max_us;       // submit to first burst
+    uint32_t latency_max_us;    // submit to completion
+    uint64_t latency_sum_us;
+};
+
+// Bus scheduler in front of ML5238::run(). Jobs queue per class and the highest class with work
+// goes first. CONTROL and DIAG jobs are cut into bursts of at most burst_frames, PROTECT jobs go
+// out whole, so a protection job waits for at most one lower class burst plus the protection
+// jobs ahead of it. Each burst is checked by the guard on its own.
+class ML5238_Sched {
+public:
+    static const uint8_t QUEUE = 8;     // jobs per class
+
+    ML5238_Sched(ML5238 &bms, ML5238_Port &port, uint8_t burst_frames = 8);
+
+    // False when the class queue is full. The batch must stay untouched until done is called.
+    bool submit(ML5238_Batch &batch, uint8_t cls, ML5238_JobDone done = nullptr, void *ctx = nullptr);
+    // Runs one burst, false if there was nothing to do
+    bool step();
+    bool idle() const;
+    uint8_t queued(uint8_t cls) const { return cls < ML5238_CLASS_COUNT ? _q[cls].n : 0; }
+
+    // Bus time of one burst at the longest, plus the PROTECT jobs queued ahead, bounds the wait
+    uint8_t burst_frames() const { return _burst_frames; }
+    const ML5238_ClassStats &stats(uint8_t cls) const { return _stats[cls < ML5238_CLASS_COUNT ? cls : 0]; }
+    void clear_stats();
+
+private:
+    struct Job {
+        ML5238_Batch *batch;
+        ML5238_JobDone done;
+        void *ctx;
+        uint32_t queued_us;
+        uint8_t next;           // first frame not sent yet
+    };
+    struct Queue {
+        Job job[QUEUE];
+        uint8_t head;
+        uint8_t n;
+    };
+
+    void finish(uint8_t cls, bool ok, uint32_t now_us);
+
+    ML5238 &_bms;
+    ML5238_Port &_port;
+    uint8_t _burst_frames;
+    Queue _q[ML5238_CLASS_COUNT];
+    ML5238_ClassStats _stats[ML5238_CLASS_COUNT];
+    ML5238_Batch _burst;
+};
+
+}  // namespace drivers
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include "ML5238_defs.h"
+
+namespace drivers {
+
+enum : uint8_t {
+    ML5238_DESC_SPI,    // one frame, arg = command byte, data = data byte, read data kept in rx
+    ML5238_DESC_WAIT,   // data = microseconds, timer driven
+    ML5238_DESC_VMON,   // MCU ADC sample of the VMON pin into sample[arg]
+    ML5238_DESC_IMON,   // MCU ADC sample of the IMON pin into sample[arg]
+    ML5238_DESC_END,    // cycle complete, the CPU is notified
+};
+
+struct ML5238_Desc {
+    uint8_t  op;
+    uint8_t  arg;
+    uint16_t data;
+};
+
+// A measurement cycle as descriptors, compiled once by ML5238::compile_cycle() and executed by
+// a ML5238_DmaEngine without the CPU. The results land in the chain itself.
+class ML5238_Chain {
+public:
+    static const uint8_t MAX_DESCS = 64;
+    static const uint8_t SAMPLES = ml5238::CELLS_MAX + 1;
+    static const uint8_t SAMPLE_IMON = ml5238::CELLS_MAX;   // sample slot of the current
+
+    ML5238_Chain() : status_desc(-1), cbalh_desc(-1), cball_desc(-1), _n(0) {}
+
+    void clear() {
+        status_desc = cbalh_desc = cball_desc = -1;
+        _n = 0;
+    }
+    // Descriptor index, -1 when full
+    int8_t add(uint8_t op, uint8_t arg, uint16_t data) {
+        if (_n >= MAX_DESCS) return -1;
+        _desc[_n].op = op;
+        _desc[_n].arg = arg;
+        _desc[_n].data = data;
+        return (int8_t)_n++;
+    }
+    int8_t write(uint8_t reg, uint8_t val) { return add(ML5238_DESC_SPI, ml5238::spi_cmd(reg, ml5238::SPI_WRITE), val); }
+    int8_t read(uint8_t reg) { return add(ML5238_DESC_SPI, ml5238::spi_cmd(reg, ml5238::SPI_READ), 0); }
+    // Changes the data byte of a frame without recompiling, only while no engine runs the chain
+    void patch(uint8_t desc, uint8_t val) { _desc[desc].data = val; }
+
+    uint8_t size() const { return _n; }
+    const ML5238_Desc &desc(uint8_t i) const { return _desc[i]; }
+
+    // Engine side
+    void set_rx(uint8_t desc, uint8_t val) { _rx[desc] = val; }
+    void set_sample(uint8_t slot, uint16_t mV) { _sample[slot < SAMPLES ? slot : 0] = mV; }
+
+    // Results
+    uint8_t rx(uint8_t desc) const { return _rx[desc]; }
+    uint16_t sample(uint8_t slot) const { return _sample[slot < SAMPLES ? slot : 0]; }
+
+    // Descriptors the driver patches or reads back, set by the compiler
+    int8_t status_desc;
+    int8_t cbalh_desc;      // balancing restore after the cell scan
+    int8_t cball_desc;
+
+private:
+    uint8_t _n;
+    ML5238_Desc _desc[MAX_DESCS];
+    uint8_t _rx[MAX_DESCS];
+    uint16_t _sample[SAMPLES];
+};
+
+typedef void (*ML5238_DmaDone)(void *ctx);
+
+// Timer triggered DMA of SPI frames and ADC conversions on the MCU. Runs a chain on its own and
+// calls done once, from its interrupt, when the END descriptor is reached.
+class ML5238_DmaEngine {
+public:
+    // False while another chain runs
+    virtual bool start(ML5238_Chain &chain, ML5238_DmaDone done, void *ctx) = 0;
+    virtual bool busy() const = 0;
+};
+
+}  // namespace drivers
@@ -0,0 +1,90 @@
+#include "ML5238_ship.h"
+#include <stddef.h>
+
+namespace drivers {
+
+using namespace ml5238;
+
+uint16_t ML5238_Ship::crc16(const uint8_t *data, uint16_t n) {
+    uint16_t crc = 0xFFFF;
+    while (n--) {
+        crc ^= (uint16_t)(*data++ << 8);
+        for (uint8_t b = 0; b < 8; ++b) crc = (uint16_t)(crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1);
+    }
+    return crc;
+}
+
+ML5238_Ship::ML5238_Ship(ML5238 &bms, ML5238_Port &port, ML5238_Store &store)
+    : _bms(bms), _port(port), _store(store), _psense_before(0), _rec(), _resume_us(0) {
+    _prepare.write(REG_FET, 0);
+    _prepare.write(REG_CBALH, 0);
+    _prepare.write(REG_CBALL, 0);
+    _prepare.write(REG_VMON, 0);
+    _prepare.write(REG_IMON, 0);
+    // Both comparators for the charger check; RPSL/RPSH written 0 are cleared on the way down
+    _prepare.write(REG_PSENSE, PSENSE_EPSL | PSENSE_EPSH);
+    _prepare.compile();
+    _check.read(REG_STATUS);
+    _check.read(REG_PSENSE);
+    _check.read(REG_POWER);
+    _check.compile();
+}
+
+uint8_t ML5238_Ship::fail(uint8_t reason, bool charge, bool discharge) {
+    _bms.write(REG_PSENSE, _psense_before);
+    _bms.write(REG_IMON, (uint8_t)(IMON_OUT | (_bms.config().gim ? IMON_GIM : 0)));
+    _bms.set_fets(charge, discharge);
+    return reason;
+}
+
+uint8_t ML5238_Ship::enter(bool charge, bool discharge) {
+    _psense_before = (uint8_t)(_bms.shadow(REG_PSENSE) & ~(PSENSE_RPSL | PSENSE_RPSH));
+    if (!_bms.run(_prepare)) return fail(ML5238_SHIP_REFUSED, charge, discharge);
+    // The driver's own view follows, the shadows already match so nothing goes out
+    _bms.set_fets(false, false);
+    _bms.set_balance(0);
+    _port.delay_us(COMPARATOR_ARM_US);
+    if (!_bms.run(_check)) return fail(ML5238_SHIP_REFUSED, charge, discharge);
+
+    const uint8_t status = _check.result(0), psense = _check.result(1), power = _check.result(2);
+    if (status & (STATUS_DF | STATUS_CF)) return fail(ML5238_SHIP_FET, charge, discharge);
+    if (!(psense & (PSENSE_PSL | PSENSE_PSH))) return fail(ML5238_SHIP_CHARGER, charge, discharge);
+    if (power & POWER_PUPIN) return fail(ML5238_SHIP_PUPIN, charge, discharge);
+
+    _rec.magic = ML5238_ShipRecord::MAGIC;
+    _rec.version = ML5238_ShipRecord::VERSION;
+    _rec.fets = (uint8_t)((charge ? 1 : 0) | (discharge ? 2 : 0));
+    _rec.soc_permille = _bms.state().soc_permille;
+    _rec.kept = _bms.retained();
+    _rec.crc = crc16((const uint8_t *)&_rec, (uint16_t)offsetof(ML5238_ShipRecord, crc));
+    if (!_store.save((const uint8_t *)&_rec, sizeof(_rec))) return fail(ML5238_SHIP_STORE, charge, discharge);
+
+    if (!_bms.write(REG_POWER, (uint8_t)((_bms.shadow(REG_POWER) & ~POWER_PSV) | POWER_PDWN)))
+        return fail(ML5238_SHIP_REFUSED, charge, discharge);
+    return ML5238_SHIP_OK;
+}
+
+uint8_t ML5238_Ship::resume(const ML5238_Config &cfg) {
+    const uint32_t t0 = _port.micros();
+    ML5238_ShipRecord r;
+    const bool valid = _store.load((uint8_t *)&r, sizeof(r)) && r.magic == ML5238_ShipRecord::MAGIC &&
+                       r.version == ML5238_ShipRecord::VERSION &&
+                       r.crc == crc16((const uint8_t *)&r, (uint16_t)offsetof(ML5238_ShipRecord, crc));
+    if (!valid) {
+        _bms.begin(cfg);
+        _resume_us = _port.micros() - t0;
+        return ML5238_WAKE_COLD;
+    }
+    _rec = r;
+    _bms.begin(cfg, r.kept);
+    // A /PUPIN pulse already over reads as a charger wake
+    const uint8_t reason = _bms.read(REG_POWER) & POWER_PUPIN ? ML5238_WAKE_PUPIN : ML5238_WAKE_CHARGER;
+    _bms.set_fets((r.fets & 1) != 0, (r.fets & 2) != 0);
+    _resume_us = _port.micros() - t0;
+    // Used once: a later reset without ship mode must not restore a stale count
+    r.magic = 0;
+    _store.save((const uint8_t *)&r, sizeof(r));
+    return reason;
+}
+
+}  // namespace drivers
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdint.h>
+#include "ML5238.h"
+
+namespace drivers {
+
+// Non-volatile storage on the MCU side (flash page, EEPROM, backup registers). VREG, and with
+// it the MCU, is off during power down, so RAM does not survive.
+class ML5238_Store {
+public:
+    virtual bool save(const uint8_t *data, uint16_t n) = 0;
+    virtual bool load(uint8_t *data, uint16_t n) = 0;
+};
+
+enum : uint8_t {
+    ML5238_SHIP_OK,
+    ML5238_SHIP_FET,            // STATUS still shows a FET on
+    ML5238_SHIP_CHARGER,        // PSENSE does not show the charger open
+    ML5238_SHIP_PUPIN,          // /PUPIN is low, PDWN would wait for it
+    ML5238_SHIP_STORE,          // the record could not be saved
+    ML5238_SHIP_REFUSED,        // the guard refused a step
+};
+
+enum : uint8_t {
+    ML5238_WAKE_COLD,           // no valid record, plain begin()
+    ML5238_WAKE_CHARGER,        // charger connected on PSENSE
+    ML5238_WAKE_PUPIN,          // /PUPIN pulled low
+};
+
+// What survives ship mode in the store
+struct ML5238_ShipRecord {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t fets;               // bit 0 charge, bit 1 discharge, wanted after wake
+    uint16_t soc_permille;
+    ML5238_Retained kept;
+    uint16_t crc;               // CRC-16/CCITT of everything before it
+
+    static const uint32_t MAGIC = 0x50494853;   // "SHIP"
+    static const uint8_t VERSION = 1;
+};
+
+// Ship mode through PDWN. enter() runs the documented preconditions as compiled batches: FETs,
+// balancing, VMON and IMON off with both PSENSE comparators enabled in one burst, then after
+// the comparators settle STATUS, PSENSE and POWER in a second. Only when those show the FETs
+// off, the charger open and /PUPIN high is the record saved and PDWN written; under a guard its
+// PDWN rules check the same reads again. Any failure puts the FETs back as asked for.
+// resume() is the boot path after VREG returns: begin() from the record, which skips the IMON
+// calibration and keeps the charge count if the cells have not moved.
+class ML5238_Ship {
+public:
+    ML5238_Ship(ML5238 &bms, ML5238_Port &port, ML5238_Store &store);
+
+    // FETs to restore on failure and after wake. Does not return on success with real hardware.
+    uint8_t enter(bool charge, bool discharge);
+    uint8_t resume(const ML5238_Config &cfg);
+
+    // Time the last resume() took, us
+    uint32_t resume_us() const { return _resume_us; }
+    const ML5238_ShipRecord &record() const { return _rec; }
+
+    static uint16_t crc16(const uint8_t *data, uint16_t n);
+
+private:
+    uint8_t fail(uint8_t reason, bool charge, bool discharge);
+
+    ML5238 &_bms;
+    ML5238_Port &_port;
+    ML5238_Store &_store;
+    ML5238_Batch _prepare;
+    ML5238_Batch _check;
+    uint8_t _psense_before;     // PSENSE put back when enter() fails
+    ML5238_ShipRecord _rec;
+    uint32_t _resume_us;
+};
+
+}  // namespace drivers
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace drivers {
+
+// Aggregates of one cell scan, updated as each sample arrives
+struct ML5238_ScanStats {
+    uint16_t min_mV;
+    uint16_t max_mV;
+    uint8_t  min_cell;
+    uint8_t  max_cell;
+    uint8_t  n;
+    uint32_t sum_mV;
+
+    ML5238_ScanStats() { clear(); }
+
+    void clear() {
+        min_mV = 0xFFFF;
+        max_mV = 0;
+        min_cell = max_cell = 0;
+        n = 0;
+        sum_mV = 0;
+    }
+
+    void add(uint8_t cell, uint16_t mV) {
+        if (mV < min_mV) {
+            min_mV = mV;
+            min_cell = cell;
+        }
+        if (mV >= max_mV) {
+            max_mV = mV;
+            max_cell = cell;
+        }
+        sum_mV += mV;
+        ++n;
+    }
+
+    uint16_t mean_mV() const { return n ? (uint16_t)(sum_mV / n) : 0; }
+    uint16_t spread_mV() const { return n ? (uint16_t)(max_mV - min_mV) : 0; }
+};
+
+// Lowest (MIN) or highest value of the last N pushed, O(1) amortised per push. Monotonic deque
+// in a ring buffer: values that can no longer be the extreme are dropped from the back.
+template <uint8_t N, bool MIN>
+class ML5238_Window {
+public:
+    ML5238_Window() : _seq(0), _head(0), _n(0) {}
+
+    void clear() { _n = 0; }
+
+    void push(uint16_t v) {
+        if (_n && (uint32_t)(_seq - _at[_head]) >= N) {
+            _head = (uint8_t)((_head + 1) % N);
+            --_n;
+        }
+        while (_n) {
+            const uint16_t back = _val[(_head + _n - 1) % N];
+            if (MIN ? back < v : back > v) break;
+            --_n;
+        }
+        const uint8_t i = (uint8_t)((_head + _n) % N);
+        _val[i] = v;
+        _at[i] = _seq++;
+        ++_n;
+    }
+
+    // 0 before the first push
+    uint16_t value() const { return _n ? _val[_head] : 0; }
+
+private:
+    uint32_t _seq;
+    uint8_t _head;
+    uint8_t _n;
+    uint16_t _val[N];
+    uint32_t _at[N];
+};
+
+}  // namespace drivers
@@ -0,0 +1,113 @@
+#include "ML5238_timer.h"
+
+namespace drivers {
+
+ML5238_Timers::ML5238_Timers(ML5238 &bms, ML5238_Port &port)
+    : _bms(bms), _port(port), _n(0), _armed(0), _psv(false), _wake_us(0) {
+    clear_stats();
+}
+
+void ML5238_Timers::clear_stats() {
+    for (uint8_t i = 0; i < MAX_TIMERS; ++i) _stats[i] = ML5238_TimerStats();
+    _wakes = _bursts = 0;
+    _awake_us = 0;
+}
+
+int8_t ML5238_Timers::add(const ML5238_Timer &timer) {
+    if (_n >= MAX_TIMERS || timer.frames > ML5238_Batch::MAX_FRAMES || !timer.run) return -1;
+    _t[_n] = timer;
+    return (int8_t)_n++;
+}
+
+void ML5238_Timers::start(uint8_t id, uint32_t delay_ms) {
+    if (id >= _n) return;
+    _due[id] = _port.micros() + delay_ms * 1000;
+    _armed |= (uint8_t)(1U << id);
+    plan();
+}
+
+void ML5238_Timers::stop(uint8_t id) {
+    if (id >= _n) return;
+    _armed &= (uint8_t)~(1U << id);
+    plan();
+}
+
+void ML5238_Timers::set_power_save(bool on) {
+    _psv = on;
+    _bms.set_power_save(on);
+}
+
+void ML5238_Timers::plan() {
+    bool first = true;
+    for (uint8_t i = 0; i < _n; ++i) {
+        if (!(_armed & (1U << i))) continue;
+        const uint32_t latest = _due[i] + _t[i].slack_ms * 1000;
+        if (first || (int32_t)(latest - _wake_us) < 0) _wake_us = latest;
+        first = false;
+    }
+}
+
+bool ML5238_Timers::service(uint32_t now_us) {
+    if (!_armed || (int32_t)(now_us - _wake_us) < 0) return false;
+    run(now_us);
+    return true;
+}
+
+bool ML5238_Timers::flush(uint32_t now_us) {
+    for (uint8_t i = 0; i < _n; ++i)
+        if ((_armed & (1U << i)) && (int32_t)(now_us - _due[i]) >= 0) {
+            run(now_us);
+            return true;
+        }
+    return false;
+}
+
+void ML5238_Timers::send(uint8_t ran, const uint8_t *first) {
+    bool ok = true;
+    if (_burst.size()) {
+        ok = _bms.run(_burst);
+        ++_bursts;
+    }
+    for (uint8_t i = 0; i < _n; ++i)
+        if ((ran & (1U << i)) && _t[i].done) _t[i].done(_burst, first[i], ok, _t[i].ctx);
+    _burst.clear();
+}
+
+void ML5238_Timers::run(uint32_t now_us) {
+    const uint32_t t0 = _port.micros();
+    if (_psv) _bms.set_power_save(false);
+    uint8_t first[MAX_TIMERS];
+    uint8_t ran = 0;
+    _burst.clear();
+    for (uint8_t i = 0; i < _n; ++i) {
+        if (!(_armed & (1U << i)) || (int32_t)(now_us - _due[i]) < 0) continue;
+        // A timer that would overflow the burst waits for the next one in the same wake
+        if (_burst.size() + _t[i].frames > ML5238_Batch::MAX_FRAMES) {
+            send(ran, first);
+            ran = 0;
+        }
+        ML5238_TimerStats &st = _stats[i];
+        const uint32_t late = now_us - _due[i];
+        if (late > st.late_max_us) st.late_max_us = late;
+        ++st.runs;
+        first[i] = _burst.size();
+        _t[i].run(_burst, _t[i].ctx);
+        ran |= (uint8_t)(1U << i);
+        // On the period grid, so slack delays a run without stretching the period; whole periods
+        // missed are skipped
+        const uint32_t period = _t[i].period_ms * 1000;
+        if (!period) {
+            _armed &= (uint8_t)~(1U << i);
+            continue;
+        }
+        _due[i] += period;
+        if ((int32_t)(now_us - _due[i]) >= 0) _due[i] += ((now_us - _due[i]) / period + 1) * period;
+    }
+    send(ran, first);
+    if (_psv) _bms.set_power_save(true);
+    ++_wakes;
+    _awake_us += _port.micros() - t0;
+    plan();
+}
+
+}  // namespace drivers
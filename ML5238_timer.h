@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include "ML5238.h"
+
+namespace drivers {
+
+// Adds the timer's frames to the shared burst; work without bus traffic adds none
+typedef void (*ML5238_TimerFn)(ML5238_Batch &burst, void *ctx);
+// After the burst ran: the timer's frames start at first, ok is false when the guard refused it
+typedef void (*ML5238_TimerDone)(const ML5238_Batch &burst, uint8_t first, bool ok, void *ctx);
+
+// A periodic timer that may run up to slack_ms late. Expiries stay on the period grid from
+// start(), so a late run does not lower the rate; period 0 runs once.
+struct ML5238_Timer {
+    ML5238_TimerFn run;
+    ML5238_TimerDone done;      // may be null
+    void *ctx;
+    const char *name;
+    uint32_t period_ms;
+    uint32_t slack_ms;
+    uint8_t frames;             // most frames run adds
+};
+
+struct ML5238_TimerStats {
+    uint32_t runs;
+    uint32_t late_max_us;       // expiry to run
+};
+
+// Coalescing timers for power save operation. The wake is set by the earliest expiry plus slack
+// of all armed timers; at that wake every timer already expired runs, so timers with slack ride
+// along on each other's wakes instead of waking the controller themselves. Their frames go out
+// as one batched burst (more than one only when they do not fit ML5238_Batch), and with power
+// save on the ML5238 leaves PSV only for the wake. flush() lets a wake from elsewhere, /INTO or
+// a host request, take the expired timers along as well.
+class ML5238_Timers {
+public:
+    static const uint8_t MAX_TIMERS = 8;
+
+    ML5238_Timers(ML5238 &bms, ML5238_Port &port);
+
+    // Timer id, -1 when the table is full or the timer adds more than a batch holds
+    int8_t add(const ML5238_Timer &timer);
+    // First expiry delay_ms from now
+    void start(uint8_t id, uint32_t delay_ms);
+    void stop(uint8_t id);
+    // PSV between wakes
+    void set_power_save(bool on);
+
+    // Runs the expired timers if the wake has come, false otherwise
+    bool service(uint32_t now_us);
+    // Runs the expired timers now if there are any, for a wake that happened anyway
+    bool flush(uint32_t now_us);
+    // Latest moment to wake, the MCU may sleep until then
+    uint32_t due_us() const { return _wake_us; }
+    bool armed() const { return _armed != 0; }
+
+    uint8_t timers() const { return _n; }
+    const ML5238_Timer &timer(uint8_t id) const { return _t[id < MAX_TIMERS ? id : 0]; }
+    const ML5238_TimerStats &stats(uint8_t id) const { return _stats[id < MAX_TIMERS ? id : 0]; }
+    uint32_t wakes() const { return _wakes; }
+    uint32_t bursts() const { return _bursts; }
+    uint64_t awake_us() const { return _awake_us; }     // out of PSV for wakes
+    void clear_stats();
+
+private:
+    void run(uint32_t now_us);
+    void send(uint8_t ran, const uint8_t *first);
+    void plan();
+
+    ML5238 &_bms;
+    ML5238_Port &_port;
+    ML5238_Timer _t[MAX_TIMERS];
+    ML5238_TimerStats _stats[MAX_TIMERS];
+    uint32_t _due[MAX_TIMERS];
+    uint8_t _n;
+    uint8_t _armed;             // bit per timer
+    bool _psv;
+    uint32_t _wake_us;
+    uint32_t _wakes;
+    uint32_t _bursts;
+    uint64_t _awake_us;
+    ML5238_Batch _burst;
+};
+
+}  // namespace drivers
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "../sim/ML5238_twin.h"
+
+namespace drivers {
+
+// The bench pack: a 1 mohm shunt so the 10x IMON range covers +-100 A, SETSC 0.2 V, over
+// current limits above the 60 A pulse and drive peaks, and UV at the 0% open circuit voltage so a
+// full discharge at C/2 reaches it
+struct ML5238_BenchConfig : public ML5238_Config {
+    ML5238_BenchConfig() {
+        rsense_uohm = 1000;
+        setsc = 1;
+        cell_uv_mV = 3000;
+        charge_oc_mA = 40000;
+        discharge_oc_mA = 80000;
+    }
+};
+
+// The simulator with the bench pack's shunt
+struct ML5238_BenchSimConfig : public ML5238_SimConfig {
+    ML5238_BenchSimConfig() { rsense_uohm = 1000; }
+};
+
+// Load profiles for ML5238_Twin::run(). Current in A, charge positive, t is simulated time.
+
+inline double profile_idle(double, void *) { return 0.0; }
+
+// ctx: const double *, the current
+inline double profile_constant(double, void *ctx) { return *(const double *)ctx; }
+
+struct ML5238_Step {
+    double at_s;
+    double before_A;
+    double after_A;
+};
+
+inline double profile_step(double t_s, void *ctx) {
+    const ML5238_Step &p = *(const ML5238_Step *)ctx;
+    return t_s < p.at_s ? p.before_A : p.after_A;
+}
+
+struct ML5238_Pulse {
+    double on_A;
+    double off_A;
+    double on_s;
+    double period_s;
+};
+
+inline double profile_pulse(double t_s, void *ctx) {
+    const ML5238_Pulse &p = *(const ML5238_Pulse *)ctx;
+    const double phase = t_s - p.period_s * (double)(long long)(t_s / p.period_s);
+    return phase < p.on_s ? p.on_A : p.off_A;
+}
+
+// Urban stop and go pattern, 1 s resolution, fraction of the peak discharge current.
+// Negative values are regenerative braking.
+struct ML5238_Drive {
+    double peak_A;
+};
+
+inline double profile_drive(double t_s, void *ctx) {
+    static const signed char CYCLE[60] = {
+        0,   0,   -5,  -30, -60, -85, -100, -90, -70, -55, -45, -40, -40, -42, -45,
+        -45, -40, -30, -10, 10,  25,  20,   10,  0,   0,   0,   -20, -50, -75, -90,
+        -80, -65, -55, -50, -50, -52, -55,  -60, -62, -60, -50, -35, -20, 0,   15,
+        30,  25,  15,  5,   0,   0,   0,    0,   -10, -25, -30, -20, -10, 0,   0,
+    };
+    const ML5238_Drive &p = *(const ML5238_Drive *)ctx;
+    const long long s = (long long)t_s;
+    const double a = CYCLE[s % 60] / 100.0, b = CYCLE[(s + 1) % 60] / 100.0;
+    return p.peak_A * (a + (b - a) * (t_s - (double)s));
+}
+
+// Charger with constant current, then constant voltage per cell on average, cut off at taper_A
+struct ML5238_CCCV {
+    const ML5238_Sim *sim;
+    double cc_A;
+    double cv_cell_V;
+    double taper_A;
+};
+
+inline double profile_cccv(double, void *ctx) {
+    const ML5238_CCCV &p = *(const ML5238_CCCV *)ctx;
+    const ML5238_Pack &pack = p.sim->pack();
+    double ocv = 0.0, r = 0.0;
+    for (uint8_t i = 0; i < pack.cells(); ++i) {
+        ocv += ML5238_Pack::ocv(pack.cell(i).soc);
+        r += pack.resistance(i);
+    }
+    double i = (p.cv_cell_V * pack.cells() - ocv) / r;
+    if (i > p.cc_A) i = p.cc_A;
+    return i < p.taper_A ? 0.0 : i;
+}
+
+}  // namespace drivers
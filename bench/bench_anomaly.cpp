@@ -0,0 +1,112 @@
+// Cell anomaly detection: time to flag a cell whose resistance steps up and a cell with a soft
+// internal short, false flags on the healthy cells, then detector throughput over a fleet.
+// g++ -O2 -std=c++11 bench_anomaly.cpp ../sim/ML5238_sim.cpp ../*.cpp -o bench_anomaly
+// ./bench_anomaly [hours] [fleet packs]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include "../ML5238_anomaly.h"
+#include "ML5238_profiles.h"
+
+using namespace drivers;
+
+static const uint8_t R_CELL = 5;       // resistance doubles at FAULT_S
+static const uint8_t LEAK_CELL = 11;   // loses 1% SOC per hour from FAULT_S
+static const double FAULT_S = 3600.0;
+
+// Charge neutral cycle: 2 min at -40 A, 1 min rest, 2 min at +40 A, 1 min rest
+static double cycle(double t_s, void *) {
+    const double p = t_s - 360.0 * (double)(long long)(t_s / 360.0);
+    return p < 120.0 ? -40.0 : (p < 180.0 ? 0.0 : (p < 300.0 ? 40.0 : 0.0));
+}
+
+static void print_flags(uint8_t f) {
+    printf("%s%s%s%s", f & ML5238_ANOM_REST_Z ? " rest-z" : "", f & ML5238_ANOM_REST_SHIFT ? " rest-shift" : "",
+           f & ML5238_ANOM_LOAD_Z ? " load-z" : "", f & ML5238_ANOM_LOAD_SHIFT ? " load-shift" : "");
+}
+
+static void detection(double hours) {
+    ML5238_Pack pack(16);
+    for (uint8_t i = 0; i < pack.cells(); ++i) {
+        pack.cell(i).soc = 0.6 + 0.003 * ((i * 7) % 11) - 0.015;
+        pack.cell(i).capacity_As *= 1.0 - 0.004 * ((i * 5) % 7);
+    }
+    ML5238_Sim sim(pack, ML5238_BenchSimConfig());
+    ML5238 bms(sim);
+    bms.begin(ML5238_BenchConfig());
+    bms.set_fets(true, true);
+    ML5238_Twin twin(sim, bms, 100000);
+    ML5238_Anomaly det;
+
+    double first[16];
+    uint8_t first_flags[16];
+    for (uint8_t i = 0; i < 16; ++i) {
+        first[i] = -1.0;
+        first_flags[i] = 0;
+    }
+    const double end = hours * 3600.0;
+    bool faulted = false;
+    for (double t = 0; t < end; t = twin.now_s()) {
+        if (!faulted && t >= FAULT_S) {
+            pack.cell(R_CELL).r25_ohm *= 2.0;
+            pack.cell(LEAK_CELL).sd_per_s = 0.01 / 3600.0;
+            faulted = true;
+        }
+        twin.step(cycle(t, nullptr));
+        // Once a second
+        if ((uint64_t)(twin.now_s() * 10.0) % 10 != 0) continue;
+        det.update(bms.state(), bms.cells());
+        for (uint8_t i = 0; i < 16; ++i) {
+            if (det.flags(i) && first[i] < 0) {
+                first[i] = twin.now_s();
+                first_flags[i] = det.flags(i);
+            }
+        }
+    }
+
+    printf("faults injected at %.0f s: cell %u resistance x2, cell %u leaks 1%%/h\n\n", FAULT_S, R_CELL, LEAK_CELL);
+    printf("%-6s %12s  %s\n", "cell", "flagged at", "first flags / now");
+    unsigned false_flags = 0;
+    for (uint8_t i = 0; i < 16; ++i) {
+        if (first[i] < 0) continue;
+        if (i != R_CELL && i != LEAK_CELL) ++false_flags;
+        printf("%-6u %10.0f s ", i, first[i]);
+        print_flags(first_flags[i]);
+        printf(" /");
+        print_flags(det.flags(i));
+        printf("\n");
+    }
+    printf("\nfalse flags: %u of 14 healthy cells\n\n", false_flags);
+}
+
+static void throughput(unsigned packs) {
+    std::vector<ML5238_Anomaly> fleet(packs);
+    uint16_t mv[16];
+    uint32_t x = 1;
+    const unsigned rounds = 2000;
+    const clock_t c0 = clock();
+    for (unsigned r = 0; r < rounds; ++r) {
+        const int32_t current = (r / 200) & 1 ? -30000 : 0;
+        for (unsigned p = 0; p < packs; ++p) {
+            for (uint8_t i = 0; i < 16; ++i) {
+                x = x * 1664525 + 1013904223;
+                mv[i] = (uint16_t)(3700 + (current ? -45 : 0) + (x >> 29));
+            }
+            fleet[p].update(mv, 0xFFFF, current);
+        }
+    }
+    const double s = (double)(clock() - c0) / CLOCKS_PER_SEC;
+    const double scans = (double)rounds * packs;
+    printf("fleet of %u packs: %.0f pack scans/s, %.1f M cell samples/s, %u bytes per pack\n", packs,
+           scans / s, scans * 16 / s / 1e6, (unsigned)sizeof(ML5238_Anomaly));
+}
+
+int main(int argc, char **argv) {
+    const double hours = argc > 1 ? atof(argv[1]) : 6.0;
+    const unsigned packs = argc > 2 ? (unsigned)atoi(argv[2]) : 1000;
+    detection(hours);
+    throughput(packs);
+    return 0;
+}
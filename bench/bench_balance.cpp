@@ -0,0 +1,80 @@
+// Balancing strategies in the digital twin: time to balance and energy dissipated.
+// g++ -O2 -std=c++11 bench_balance.cpp ../sim/ML5238_sim.cpp ../*.cpp -o bench_balance
+// ./bench_balance [spread_permille] [target_permille] [days]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ML5238_profiles.h"
+#include "../ML5238_planner.h"
+
+using namespace drivers;
+
+// 6.5 h cycle: CC/CV charge, rest, C/2 discharge, rest
+struct Cycle {
+    ML5238_CCCV charge;
+};
+
+static double cycle(double t_s, void *ctx) {
+    Cycle &c = *(Cycle *)ctx;
+    const double h = t_s / 3600.0 - 6.5 * (double)(long long)(t_s / (6.5 * 3600.0));
+    if (h < 3.0) return profile_cccv(t_s, &c.charge);
+    if (h >= 4.0 && h < 5.5) return -25.0;
+    return 0.0;
+}
+
+static double spread(const ML5238_Pack &p) {
+    double lo = 1.0, hi = 0.0;
+    for (uint8_t i = 0; i < p.cells(); ++i) {
+        if (p.cell(i).soc < lo) lo = p.cell(i).soc;
+        if (p.cell(i).soc > hi) hi = p.cell(i).soc;
+    }
+    return hi - lo;
+}
+
+static void run(const char *name, ML5238_BalancePolicy *policy, double initial, double target, double days) {
+    ML5238_Pack pack(16);
+    for (uint8_t i = 0; i < pack.cells(); ++i) pack.cell(i).soc = 0.5 + initial * (((i * 7) % 16) / 15.0 - 0.5);
+    ML5238_Sim sim(pack, ML5238_BenchSimConfig());
+    ML5238 bms(sim);
+    bms.begin(ML5238_BenchConfig());
+    bms.set_balance_policy(policy);
+    bms.set_fets(true, true);
+    ML5238_Twin twin(sim, bms, 100000);
+    Cycle c = { { &sim, 25.0, 4.15, 2.5 } };
+
+    double balanced_h = -1.0;
+    const clock_t c0 = clock();
+    while (twin.now_s() < days * 86400.0) {
+        twin.run(600.0, cycle, &c);
+        if (spread(pack) < target) {
+            balanced_h = twin.now_s() / 3600.0;
+            break;
+        }
+    }
+    const double cpu = (double)(clock() - c0) / CLOCKS_PER_SEC;
+    if (balanced_h >= 0.0) printf("%-8s %10.1f", name, balanced_h);
+    else printf("%-8s %10s", name, "-");
+    printf(" %10.2f %9.2f %9u %9.0fx\n", pack.balance_J() / 3600.0, spread(pack) * 100.0, sim.violations(),
+           twin.now_s() / cpu);
+}
+
+int main(int argc, char **argv) {
+    const double initial = (argc > 1 ? atof(argv[1]) : 40.0) / 1000.0;
+    const double target = (argc > 2 ? atof(argv[2]) : 15.0) / 1000.0;
+    const double days = argc > 3 ? atof(argv[3]) : 30.0;
+
+    ML5238_TopBalance top;
+    ML5238_BottomBalance bottom;
+    ML5238_SocBalance soc;
+    ML5238_BalancePlanner planner;
+
+    printf("16 cells, %.1f%% initial SOC spread, target %.1f%%, at most %.0f days\n", initial * 100.0,
+           target * 100.0, days);
+    printf("%-8s %10s %10s %9s %9s %10s\n", "policy", "hours", "bleed Wh", "spread %", "illegal", "speed");
+    run("top", &top, initial, target, days);
+    run("bottom", &bottom, initial, target, days);
+    run("soc", &soc, initial, target, days);
+    run("planner", &planner, initial, target, days);
+    return 0;
+}
@@ -0,0 +1,146 @@
+// Short circuit flight recorder: IMON sampled at the full ADC rate into the ring while a short, an
+// over current, a load open and a manual trigger happen, each frozen with 10 ms either side. Per
+// event the causes, the coded size against raw samples and what the window shows; then the CPU
+// cost of sample() against a bare ADC read.
+// g++ -O2 -std=c++11 bench_capture.cpp ../sim/ML5238_sim.cpp ../*.cpp -o bench_capture
+// ./bench_capture [samples for the overhead loop]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../ML5238_capture.h"
+#include "../ML5238_irq.h"
+#include "../sim/ML5238_sim.h"
+#include "ML5238_profiles.h"
+
+using namespace drivers;
+using namespace drivers::ml5238;
+
+typedef ML5238_CaptureBuffer<4096, 16384, 8> Capture;
+
+static const char *causes(uint8_t c) {
+    static char buf[32];
+    snprintf(buf, sizeof(buf), "%s%s%s%s", c & ML5238_CAPTURE_SC ? "SC " : "", c & ML5238_CAPTURE_LOAD ? "LOAD " : "",
+             c & ML5238_CAPTURE_OC ? "OC " : "", c & ML5238_CAPTURE_MANUAL ? "MANUAL " : "");
+    return buf;
+}
+
+// Samples for ms milliseconds, /INTO served between samples as an interrupt would be
+static void run_for(ML5238_Sim &sim, ML5238 &bms, ML5238_Irq &irq, Capture &cap, uint32_t ms) {
+    const uint64_t end = sim.now_ns() + (uint64_t)ms * 1000000;
+    while (sim.now_ns() < end) {
+        cap.sample();
+        if (sim.int_pin()) irq.on_edge();
+        if (irq.service(sim.micros())) cap.on_status(bms.state().status);
+    }
+}
+
+static void events() {
+    ML5238_Pack pack(16);
+    ML5238_Sim sim(pack, ML5238_BenchSimConfig());
+    ML5238 bms(sim);
+    ML5238_BenchConfig cfg;
+    cfg.setsc = 0;              // 100 mV, 100 A: the bottom of the IMON range at GIM 0
+    bms.begin(cfg);
+    bms.set_fets(true, true);
+    sim.set_load_connected(true);
+    bms.write(REG_RSENSE, RSENSE_ESC | RSENSE_ISC | RSENSE_ERS);
+    sim.delay_us(2000);
+    bms.write(REG_RSENSE, RSENSE_ESC | RSENSE_ISC | RSENSE_ERS | RSENSE_IRS);
+    bms.tick();
+    ML5238_Irq irq(bms);
+    Capture cap(bms, sim);
+    cap.arm(1000, 1000);
+
+    uint32_t at_us[4];
+    sim.set_load(-30.0);
+    run_for(sim, bms, irq, cap, 50);
+    // Hard short, the LSI cuts the FETs after tsc
+    at_us[0] = sim.micros();
+    sim.set_load(-400.0);
+    run_for(sim, bms, irq, cap, 30);
+    sim.set_load(-30.0);
+    bms.clear_faults();
+    bms.set_fets(true, true);
+    run_for(sim, bms, irq, cap, 50);
+    // 90 A for 20 ms, over the 80 A discharge limit but under the short
+    at_us[1] = sim.micros();
+    sim.set_load(-90.0);
+    run_for(sim, bms, irq, cap, 20);
+    sim.set_load(-30.0);
+    run_for(sim, bms, irq, cap, 50);
+    at_us[2] = sim.micros();
+    sim.set_load_connected(false);
+    run_for(sim, bms, irq, cap, 30);
+    sim.set_load_connected(true);
+    run_for(sim, bms, irq, cap, 50);
+    at_us[3] = sim.micros();
+    cap.trigger(ML5238_CAPTURE_MANUAL);
+    run_for(sim, bms, irq, cap, 30);
+
+    printf("%u samples at %.0f kHz, ring 4096, %u events, %u lost, pool %u of 16384 bytes\n\n", cap.samples(),
+           1e6 / sim.config().adc_ns, cap.events(), cap.lost(), cap.pool_used());
+    printf("%-15s %7s %7s %7s %6s %9s %9s %9s %9s %9s\n", "causes", "samples", "bytes", "raw", "window", "event->trg",
+           "before A", "min A", "at min us", "after A");
+    static int32_t mA[4096];
+    for (uint8_t i = 0; i < cap.events(); ++i) {
+        const ML5238_CaptureEvent &e = cap.event(i);
+        const uint16_t n = cap.decode(i, mA, 4096);
+        const double us_per = n > 1 ? (double)(e.last_us - e.first_us) / (n - 1) : 0.0;
+        uint16_t low = 0;
+        for (uint16_t k = 0; k < n; ++k)
+            if (mA[k] < mA[low]) low = k;
+        uint16_t at_min = 0;
+        while (low + at_min < n && mA[low + at_min] == mA[low]) ++at_min;
+        printf("%-15s %7u %7u %7u %5.1fms %8dus %9.1f %9.1f %9.0f %9.1f\n", causes(e.cause), n, e.bytes, 2 * n,
+               (e.last_us - e.first_us) * 1e-3, (int)(e.trigger_us - at_us[i < 4 ? i : 3]), mA[0] * 1e-3,
+               mA[low] * 1e-3, at_min * us_per, mA[n - 1] * 1e-3);
+    }
+    printf("\n");
+}
+
+// Constant cost ADC stand-in, so the loop measures the capture alone
+class AdcPort : public ML5238_Port {
+public:
+    AdcPort() : t(0) {}
+    void transfer(const uint8_t *, uint8_t *rx, uint8_t frames) override {
+        if (rx)
+            for (uint8_t i = 0; i < 2 * frames; ++i) rx[i] = 0;
+    }
+    uint16_t vmon_mV() override { return 0; }
+    uint16_t imon_mV() override { return (uint16_t)(1000 + (t++ & 7)); }
+    uint32_t micros() override { return t / 100; }
+    void delay_us(uint32_t us) override { t += us * 100; }
+
+    volatile uint32_t t;
+};
+
+static double ns_since(const timespec &a) {
+    timespec b;
+    clock_gettime(CLOCK_MONOTONIC, &b);
+    return (b.tv_sec - a.tv_sec) * 1e9 + (b.tv_nsec - a.tv_nsec);
+}
+
+static void overhead(uint32_t n) {
+    AdcPort port;
+    ML5238 bms(port);
+    bms.begin(ML5238_BenchConfig());
+    Capture cap(bms, port);
+    cap.arm(1000, 1000);
+    timespec a;
+    uint32_t sum = 0;
+    clock_gettime(CLOCK_MONOTONIC, &a);
+    for (uint32_t i = 0; i < n; ++i) sum += port.imon_mV();
+    const double bare = ns_since(a) / n;
+    clock_gettime(CLOCK_MONOTONIC, &a);
+    for (uint32_t i = 0; i < n; ++i) cap.sample();
+    const double armed = ns_since(a) / n;
+    printf("per sample: ADC read %.2f ns, sample() %.2f ns, %.2f ns on top, %u events (%u)\n", bare, armed,
+           armed - bare, cap.events(), sum & 1);
+}
+
+int main(int argc, char **argv) {
+    events();
+    overhead(argc > 1 ? (uint32_t)atoi(argv[1]) : 20000000);
+    return 0;
+}
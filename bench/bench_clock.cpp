@@ -0,0 +1,78 @@
+// SPI clock tuning on boards with different layout limits: the sweep, the chosen rate and the
+// control tick time before and after, then a board whose limit drifts down while running.
+// g++ -O2 -std=c++11 bench_clock.cpp ../sim/ML5238_sim.cpp ../*.cpp -o bench_clock
+// ./bench_clock [conservative hz]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../ML5238_clock.h"
+#include "../sim/ML5238_sim.h"
+#include "ML5238_profiles.h"
+
+using namespace drivers;
+
+static double tick_ms(ML5238_Sim &sim, ML5238 &bms) {
+    const uint64_t t0 = sim.now_ns();
+    for (int i = 0; i < 10; ++i) bms.tick();
+    return (double)(sim.now_ns() - t0) * 1e-7;
+}
+
+static void board(uint32_t limit_hz, uint32_t start_hz) {
+    ML5238_Pack pack(16);
+    ML5238_BenchSimConfig sc;
+    sc.spi_hz = start_hz;
+    sc.spi_limit_hz = limit_hz;
+    ML5238_Sim sim(pack, sc);
+    ML5238 bms(sim);
+    bms.begin(ML5238_BenchConfig());
+    const double before = tick_ms(sim, bms);
+
+    ML5238_ClockTuner tuner(bms, sim);
+    const uint32_t errors0 = sim.bit_errors();
+    const uint64_t t0 = sim.now_ns();
+    const uint32_t hz = tuner.tune();
+    const double sweep_ms = (double)(sim.now_ns() - t0) * 1e-6;
+    const double after = tick_ms(sim, bms);
+
+    printf("board limit %u kHz:", limit_hz / 1000);
+    for (uint8_t i = 0; i < tuner.rates(); ++i) printf(" %u%s", tuner.rate(i) / 1000, tuner.errors(i) ? "x" : "");
+    printf("\n  chosen %u kHz, sweep %.1f ms, %u bit errors in the sweep, tick %.2f -> %.2f ms\n", hz / 1000,
+           sweep_ms, sim.bit_errors() - errors0, before, after);
+}
+
+int main(int argc, char **argv) {
+    const uint32_t start_hz = argc > 1 ? (uint32_t)atol(argv[1]) : 250000;
+    printf("rates tried in kHz, x = bit errors; conservative clock %u kHz\n\n", start_hz / 1000);
+    board(300000, start_hz);
+    board(650000, start_hz);
+    board(2000000, start_hz);
+
+    // Limit falls from 900 to 550 kHz after 60 s, revalidation every 10 s
+    ML5238_Pack pack(16);
+    ML5238_BenchSimConfig sc;
+    sc.spi_hz = start_hz;
+    sc.spi_limit_hz = 900000;
+    ML5238_Sim sim(pack, sc);
+    ML5238 bms(sim);
+    bms.begin(ML5238_BenchConfig());
+    ML5238_ClockTuner tuner(bms, sim);
+    tuner.tune();
+    printf("\ndrift: tuned to %u kHz at a 900 kHz limit\n", tuner.hz() / 1000);
+    uint32_t bad_ticks = 0;
+    for (int s = 0; s < 180; ++s) {
+        if (s == 60) {
+            sim.set_spi_limit(550000);
+            printf("  %3d s: limit drops to 550 kHz\n", s);
+        }
+        for (int t = 0; t < 10; ++t) {
+            const uint32_t e = sim.bit_errors();
+            bms.tick();
+            if (sim.bit_errors() != e) ++bad_ticks;
+            sim.advance(100000000);
+        }
+        if (!tuner.service(sim.micros())) printf("  %3d s: echo errors, retuned to %u kHz\n", s, tuner.hz() / 1000);
+    }
+    printf("  ticks with corrupted frames: %u of 1800, retunes %u, violations %u\n", bad_ticks, tuner.retunes(),
+           sim.violations());
+    return 0;
+}
@@ -0,0 +1,120 @@
+// Periodic driver work as a cyclic executive: 1 kHz protection, a cell scan spread over 2 ms steps,
+// 10 Hz balancing and a 1 Hz current calibration in 1 ms minor frames, against tick() every 1 ms.
+// Deadline misses when the bus runs slower than the table assumes and a task set that does not fit.
+// g++ -O2 -std=c++11 bench_cyclic.cpp ../sim/ML5238_sim.cpp ../*.cpp -o bench_cyclic
+// ./bench_cyclic [seconds]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../ML5238_cyclic.h"
+#include "../sim/ML5238_sim.h"
+#include "ML5238_profiles.h"
+
+using namespace drivers;
+
+typedef ML5238_CyclicTable<1000, 1600> Table;
+
+static const uint32_t MINOR_US = 1000;
+static const uint32_t FRAME_US = 17;        // one frame at 1 MHz, rounded up
+
+static void protect(void *ctx) { ((ML5238 *)ctx)->protect_step(); }
+static void scan(void *ctx) { ((ML5238 *)ctx)->scan_step(2); }
+static void balance(void *ctx) { ((ML5238 *)ctx)->balance_step(); }
+static void cal_start(void *ctx) { ((ML5238 *)ctx)->start_calibration(); }
+static void cal_finish(void *ctx) { ((ML5238 *)ctx)->finish_calibration(); }
+
+// Worst cases: frames on the bus, then ADC samples, VMON settling and CPU time
+static void add_tasks(ML5238_Cyclic &cyc, ML5238 &bms, uint8_t scan_cells) {
+    const ML5238_Task tasks[] = {
+        { protect, &bms, "protect", 1000, 0, 1000, 3, 30 },
+        { scan, &bms, "scan", 1000u * scan_cells, 0, 1000u * scan_cells, (uint8_t)(5 + scan_cells),
+          scan_cells * 210u + 20 },
+        { balance, &bms, "balance", 100000, 0, 10000, 2, 20 },
+        { cal_start, &bms, "cal zero", 1000000, 0, 1000, 1, 10 },
+        { cal_finish, &bms, "cal take", 1000000, 2000, 5000, 1, 30 },
+    };
+    for (const ML5238_Task &t : tasks) cyc.add(t);
+}
+
+struct Rig {
+    explicit Rig(uint32_t spi_hz) : sim(pack, config(spi_hz)), bms(sim) {
+        for (uint8_t i = 0; i < pack.cells(); ++i) pack.cell(i).soc = 0.8 + 0.01 * ((i * 7) % 5);
+        bms.begin(ML5238_BenchConfig());
+        bms.set_fets(true, true);
+        sim.set_charger(true);
+        sim.set_load(5.0);
+    }
+    static ML5238_SimConfig config(uint32_t spi_hz) {
+        ML5238_BenchSimConfig sc;
+        sc.spi_hz = spi_hz;
+        return sc;
+    }
+
+    ML5238_Pack pack{ 16 };
+    ML5238_Sim sim;
+    ML5238 bms;
+};
+
+static void run(double seconds, uint32_t spi_hz) {
+    Rig r(spi_hz);
+    Table cyc(r.sim, MINOR_US, FRAME_US);
+    add_tasks(cyc, r.bms, 2);
+    if (!cyc.build()) {
+        printf("schedule rejected\n");
+        return;
+    }
+    const uint64_t end = r.sim.now_ns() + (uint64_t)(seconds * 1e9);
+    cyc.start(r.sim.micros());
+    while (r.sim.now_ns() < end)
+        if (!cyc.service(r.sim.micros())) r.sim.advance((uint64_t)(cyc.due_us() - r.sim.micros()) * 1000);
+
+    printf("cyclic executive, SPI at %.1f kHz: %u frames of %u us, %u jobs per %u ms cycle, "
+           "heaviest frame %u us\n", spi_hz * 1e-3, cyc.frames(), cyc.minor_us(), cyc.jobs(),
+           cyc.major_us() / 1000, cyc.load_max_us());
+    printf("  %-9s %8s %8s %8s %10s %10s %8s\n", "task", "jobs", "misses", "skipped", "deadline", "resp max",
+           "exec max");
+    for (uint8_t i = 0; i < cyc.tasks(); ++i) {
+        const ML5238_Task &t = cyc.task(i);
+        const ML5238_TaskStats &s = cyc.stats(i);
+        printf("  %-9s %8u %8u %8u %10u %10u %8u\n", t.name, s.jobs, s.misses, s.skipped, t.deadline_us,
+               s.response_max_us, s.exec_max_us);
+    }
+    printf("  frame overruns %u, SOC %u permille, violations %u\n\n", cyc.overruns(), r.bms.state().soc_permille,
+           r.sim.violations());
+}
+
+// The ad-hoc loop: tick() does everything whenever 1 ms has passed, ticks that fell behind are skipped
+static void run_tick(double seconds) {
+    Rig r(1000000);
+    const uint64_t end = r.sim.now_ns() + (uint64_t)(seconds * 1e9);
+    uint64_t due = r.sim.now_ns();
+    uint32_t ticks = 0, late = 0;
+    double resp_max = 0.0;
+    while (r.sim.now_ns() < end) {
+        if (r.sim.now_ns() < due) r.sim.advance(due - r.sim.now_ns());
+        r.bms.tick();
+        const double resp = (double)(r.sim.now_ns() - due) * 1e-3;
+        if (resp > resp_max) resp_max = resp;
+        if (resp > MINOR_US) ++late;
+        ++ticks;
+        while (due <= r.sim.now_ns()) due += MINOR_US * 1000ull;
+    }
+    printf("tick() every 1 ms: %u of %.0f ticks ran, %u past the 1000 us protection deadline, worst response "
+           "%.0f us\n\n", ticks, seconds * 1e6 / MINOR_US, late, resp_max);
+}
+
+int main(int argc, char **argv) {
+    const double seconds = argc > 1 ? atof(argv[1]) : 10.0;
+    run_tick(seconds);
+    run(seconds, 1000000);
+    // The table assumes 17 us frames, at 125 kHz they take 136 us and at 62.5 kHz 272 us
+    run(seconds, 125000);
+    run(seconds, 62500);
+
+    // Four cells per step take longer than a minor frame
+    Rig r(1000000);
+    Table cyc(r.sim, MINOR_US, FRAME_US);
+    add_tasks(cyc, r.bms, 4);
+    printf("4 cells per scan step: %s\n", cyc.build() ? "schedule built" : "rejected by build()");
+    return 0;
+}
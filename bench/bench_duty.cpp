@@ -0,0 +1,141 @@
+// Quiescent drain of PSV duty cycling against a 100 ms tick that never leaves normal mode, over a
+// simulated day: a pack in storage and one with a 10 A load for 5 minutes every 2 hours. Average
+// supply current of the ML5238 and the MCU, bursts, how late a load is noticed and the SOC error.
+// g++ -O2 -std=c++11 bench_duty.cpp ../sim/ML5238_sim.cpp ../*.cpp -o bench_duty
+// ./bench_duty [hours]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../ML5238_duty.h"
+#include "../sim/ML5238_sim.h"
+#include "ML5238_profiles.h"
+
+using namespace drivers;
+
+struct Result {
+    double avg_uA;
+    uint32_t bursts;
+    double late_max_s;          // load start to the first burst that sees it
+    double soc_err;             // percent points
+};
+
+struct Rig {
+    Rig() : sim(pack, ML5238_BenchSimConfig()), bms(sim) {
+        for (uint8_t i = 0; i < pack.cells(); ++i) pack.cell(i).soc = 0.6;
+        bms.begin(ML5238_BenchConfig());
+        bms.set_fets(true, true);
+        bms.tick();
+    }
+    double true_soc() const {
+        double s = 0.0;
+        for (uint8_t i = 0; i < pack.cells(); ++i) s += pack.cell(i).soc;
+        return s / pack.cells();
+    }
+    // Load on for 5 min every 2 h, starting after 1 h and off the burst grid
+    bool load_at(uint64_t ns, bool loads) const {
+        const uint64_t first = 3600373000000ull;
+        if (!loads || ns < first) return false;
+        return (ns - first) % 7200000000000ull < 300000000000ull;
+    }
+
+    ML5238_Pack pack{ 16 };
+    ML5238_Sim sim;
+    ML5238 bms;
+};
+
+static Result always_on(double hours, bool loads) {
+    Rig r;
+    ML5238_DutyConfig cfg;
+    ML5238_DutyEnergy e;
+    const uint64_t start = r.sim.now_ns(), end = start + (uint64_t)(hours * 3.6e12);
+    const double soc0 = r.true_soc() - r.bms.state().soc_permille * 1e-3;
+    bool on = false;
+    uint64_t load_ns = 0;
+    Result res = Result();
+    while (r.sim.now_ns() < end) {
+        const bool want = r.load_at(r.sim.now_ns() - start, loads);
+        if (want != on) {
+            r.sim.set_load(want ? -10.0 : 0.0);
+            on = want;
+            load_ns = r.sim.now_ns();
+        }
+        const uint64_t t0 = r.sim.now_ns();
+        r.bms.tick();
+        const uint64_t busy = r.sim.now_ns() - t0;
+        if (on && load_ns && r.bms.state().current_mA < -cfg.active_mA) {
+            const double late = (double)(r.sim.now_ns() - load_ns) * 1e-9;
+            if (late > res.late_max_s) res.late_max_s = late;
+            load_ns = 0;
+        }
+        ++res.bursts;
+        e.mcu_run_us += busy / 1000;
+        e.mcu_sleep_us += (100000000 - busy) / 1000;
+        e.normal_us += 100000;
+        r.sim.advance(100000000 - busy);
+    }
+    res.avg_uA = e.avg_uA(cfg);
+    res.soc_err = 100.0 * (r.true_soc() - r.bms.state().soc_permille * 1e-3 - soc0);
+    return res;
+}
+
+static Result duty(double hours, bool loads, uint32_t min_ms, uint32_t max_ms) {
+    Rig r;
+    ML5238_DutyConfig cfg;
+    cfg.min_period_ms = min_ms;
+    cfg.max_period_ms = max_ms;
+    ML5238_Duty d(r.bms, r.sim, cfg);
+    const uint64_t start = r.sim.now_ns(), end = start + (uint64_t)(hours * 3.6e12);
+    const double soc0 = r.true_soc() - r.bms.state().soc_permille * 1e-3;
+    d.start();
+    bool on = false;
+    uint64_t load_ns = 0;
+    Result res = Result();
+    while (r.sim.now_ns() < end) {
+        // Sleep until the next burst or the next load change, whichever comes first
+        uint64_t next = r.sim.now_ns() + (uint64_t)(d.due_us() - r.sim.micros()) * 1000;
+        const uint64_t step = 10000000;
+        for (uint64_t t = r.sim.now_ns(); t < next; t += step)
+            if (r.load_at(t - start, loads) != on) {
+                next = t;
+                break;
+            }
+        if (next > r.sim.now_ns()) r.sim.advance(next - r.sim.now_ns());
+        const bool want = r.load_at(r.sim.now_ns() - start, loads);
+        if (want != on) {
+            r.sim.set_load(want ? -10.0 : 0.0);
+            on = want;
+            load_ns = r.sim.now_ns();
+        }
+        const uint32_t active = d.active_bursts();
+        if (d.service(r.sim.micros()) && on && load_ns && d.active_bursts() != active) {
+            const double late = (double)(r.sim.now_ns() - load_ns) * 1e-9;
+            if (late > res.late_max_s) res.late_max_s = late;
+            load_ns = 0;
+        }
+    }
+    d.stop();
+    res.avg_uA = d.energy().avg_uA(cfg);
+    res.bursts = d.bursts();
+    res.soc_err = 100.0 * (r.true_soc() - r.bms.state().soc_permille * 1e-3 - soc0);
+    return res;
+}
+
+static void print(const char *name, const Result &s, const Result &l) {
+    printf("%-22s %9.1f %9u %9.2f | %9.1f %9u %9.1f %8.2f\n", name, s.avg_uA, s.bursts, s.soc_err, l.avg_uA, l.bursts,
+           l.late_max_s, l.soc_err);
+}
+
+int main(int argc, char **argv) {
+    const double hours = argc > 1 ? atof(argv[1]) : 24.0;
+    ML5238_DutyConfig cfg;
+    printf("%.0f h, ML5238 %u/%u uA normal/PSV, MCU %u uA running, %u uA asleep\n\n", hours,
+           ml5238::IDD_NORMAL_UA, ml5238::IDD_PSV_UA, cfg.mcu_run_uA, cfg.mcu_sleep_uA);
+    printf("%-22s %29s | %38s\n", "", "storage", "5 min 10 A load every 2 h");
+    printf("%-22s %9s %9s %9s | %9s %9s %9s %8s\n", "", "avg uA", "bursts", "SOC err", "avg uA", "bursts", "late s",
+           "SOC err");
+    print("100 ms tick", always_on(hours, false), always_on(hours, true));
+    print("PSV, 1 s", duty(hours, false, 1000, 1000), duty(hours, true, 1000, 1000));
+    print("PSV, 1 s .. 60 s", duty(hours, false, 1000, 60000), duty(hours, true, 1000, 60000));
+    print("PSV, 1 s .. 300 s", duty(hours, false, 1000, 300000), duty(hours, true, 1000, 300000));
+    return 0;
+}
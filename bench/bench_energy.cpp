@@ -0,0 +1,107 @@
+// Where the quiescent current goes: the energy account between the driver and the simulator for
+// the ways this tree runs an idle pack, an hour each. Average draw per consumer, time per power
+// state and how far the account's PSV and PDWN time is from the simulator's.
+// g++ -O2 -std=c++11 bench_energy.cpp ../sim/ML5238_sim.cpp ../*.cpp -o bench_energy
+// ./bench_energy [hours]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../ML5238_duty.h"
+#include "../ML5238_energy.h"
+#include "../ML5238_ship.h"
+#include "../ML5238_timer.h"
+#include "../sim/ML5238_sim.h"
+#include "ML5238_profiles.h"
+
+using namespace drivers;
+using namespace drivers::ml5238;
+
+enum { TICK, BALANCE, COMPARATORS, DRV_LEFT, DUTY, TIMERS, SHIP };
+
+static const char *const NAMES[] = { "100 ms tick", "tick, balancing", "tick, comparators", "tick, DRV not off",
+                                     "PSV duty 1..60 s", "PSV timers", "ship (PDWN)" };
+
+class NullStore : public ML5238_Store {
+public:
+    bool save(const uint8_t *, uint16_t) override { return true; }
+    bool load(uint8_t *, uint16_t) override { return false; }
+};
+
+static void rearm(ML5238_Batch &b, void *) { b.write(REG_RSENSE, RSENSE_ESC | RSENSE_ISC); }
+static void link(ML5238_Batch &b, void *) { b.read(REG_STATUS); }
+
+static void run(int mode, double hours) {
+    ML5238_Pack pack(16);
+    for (uint8_t i = 0; i < pack.cells(); ++i) pack.cell(i).soc = mode == BALANCE ? 0.85 + 0.03 * (i % 4) : 0.6;
+    ML5238_Sim sim(pack, ML5238_BenchSimConfig());
+    ML5238_Energy energy(sim);
+    ML5238 bms(energy);
+    bms.begin(ML5238_BenchConfig());
+    bms.set_fets(mode != SHIP, mode != SHIP);
+    bms.tick();
+    if (mode == COMPARATORS) {
+        // Charger connected, PSENSE held low against its pull-up
+        sim.set_charger(true);
+        bms.write(REG_PSENSE, PSENSE_EPSL | PSENSE_EPSH);
+        bms.write(REG_RSENSE, (uint8_t)(bms.shadow(REG_RSENSE) | RSENSE_ERS));
+    }
+
+    ML5238_Duty duty(bms, energy);
+    ML5238_Timers timers(bms, energy);
+    NullStore store;
+    ML5238_Ship ship(bms, energy, store);
+    if (mode == DUTY) duty.start();
+    if (mode == TIMERS) {
+        ML5238_Timer t[2] = { { rearm, nullptr, nullptr, "re-arm", 2000, 500, 1 },
+                              { link, nullptr, nullptr, "link", 3000, 1500, 1 } };
+        for (uint8_t i = 0; i < 2; ++i) timers.start((uint8_t)timers.add(t[i]), 0);
+        timers.set_power_save(true);
+    }
+    if (mode == SHIP && ship.enter(false, false) != ML5238_SHIP_OK) printf("ship mode refused\n");
+
+    energy.clear();
+    const uint64_t psv0 = sim.psv_ns(), pdwn0 = sim.pdwn_ns();
+    const uint64_t end = sim.now_ns() + (uint64_t)(hours * 3.6e12);
+    while (sim.now_ns() < end) {
+        if (mode == DUTY) {
+            sim.advance((uint64_t)(int32_t)(duty.due_us() - sim.micros()) * 1000);
+            duty.service(sim.micros());
+        } else if (mode == TIMERS) {
+            sim.advance((uint64_t)(int32_t)(timers.due_us() - sim.micros()) * 1000);
+            timers.service(sim.micros());
+        } else if (mode == SHIP) {
+            sim.advance(600000000000ull);
+        } else {
+            const uint64_t t0 = sim.now_ns();
+            bms.tick();
+            // The regression to catch: enhanced drive set again after every FET update
+            if (mode == DRV_LEFT) bms.write(REG_FET, (uint8_t)(bms.shadow(REG_FET) | FET_DRV));
+            sim.advance(100000000 - (sim.now_ns() - t0));
+        }
+        energy.update();
+    }
+    if (mode == DUTY) duty.stop();
+    energy.update();
+
+    const ML5238_EnergyCounters &c = energy.counters();
+    const double s = (double)c.total_us() * 1e-6;
+    printf("%-18s %8.1f %8.1f", NAMES[mode], c.avg_uA(), c.quiescent_uA());
+    for (uint8_t d = 0; d < ML5238_DRAW_COUNT; ++d)
+        if (d != ML5238_DRAW_BALANCE) printf(" %7.2f", c.draw_uAs[d] / s);
+    printf(" %8.1f", c.draw_uAs[ML5238_DRAW_BALANCE] / s * 1e-3);
+    const double err_ms = ((double)(c.state_us[ML5238_POWER_PSV] + c.state_us[ML5238_POWER_PDWN]) * 1e3 -
+                           (double)(sim.psv_ns() - psv0 + sim.pdwn_ns() - pdwn0)) * 1e-6;
+    printf(" %6.1f %6.1f %6.1f %8.3f\n", 100.0 * c.state_us[ML5238_POWER_NORMAL] * 1e-6 / s,
+           100.0 * c.state_us[ML5238_POWER_PSV] * 1e-6 / s, 100.0 * c.state_us[ML5238_POWER_PDWN] * 1e-6 / s, err_ms);
+}
+
+int main(int argc, char **argv) {
+    const double hours = argc > 1 ? atof(argv[1]) : 1.0;
+    const ML5238_EnergyConfig cfg;
+    printf("%.0f h each, IDD %u/%u uA/%u nA, FET %u uA, DRV %u uA, host %u uA awake\n\n", hours, IDD_NORMAL_UA,
+           IDD_PSV_UA, IDD_PDWN_NA, cfg.fet_uA, cfg.drv_uA, cfg.spi_uA);
+    printf("%-18s %8s %8s %7s %7s %7s %7s %7s %7s %7s %8s %6s %6s %6s %8s\n", "", "avg uA", "quiet", "chip", "FET",
+           "DRV", "PSENSE", "RSENSE", "SPI", "ADC", "bal mA", "norm%", "PSV%", "PDWN%", "state ms");
+    for (int mode = TICK; mode <= SHIP; ++mode) run(mode, hours);
+    return 0;
+}
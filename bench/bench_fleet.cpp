@@ -0,0 +1,73 @@
+// Fleet processing throughput across NUMA nodes: per module state in one block set up by the
+// main thread with floating workers, against per node partitions first touched by workers
+// pinned to that node. Rows add one node at a time. On a single node host pass a node count to
+// split the CPUs into pretend sockets, which checks the layout but not the memory effect.
+// g++ -O2 -std=c++11 -pthread bench_fleet.cpp ../host/ML5238_fleet.cpp ../host/ML5238_rt.cpp ../*.cpp -o bench_fleet
+// ./bench_fleet [modules] [seconds] [nodes]
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include "../host/ML5238_fleet.h"
+
+using namespace drivers;
+
+// A pack at rest or under load with one slowly drifting cell, from the module number and its
+// scan; every fourth module has 12 cells
+static uint16_t feed(uint32_t module, ML5238_State &s, void *) {
+    const uint16_t cells = ml5238::cells_mask(module & 3 ? 16 : 12);
+    uint32_t x = module * 2654435761u + s.time_us * 1664525u;
+    s.current_mA = (s.time_us >> 9) & 1 ? -30000 : 0;
+    for (uint8_t i = 0; i < 16; ++i) {
+        x = x * 1664525 + 1013904223;
+        s.cell_mV[i] = cells & (1U << i) ? (uint16_t)(3700 + (s.current_mA ? -45 : 0) + (x >> 29)) : 0;
+    }
+    const uint8_t drift = (uint8_t)(14 - (module & 3));
+    s.cell_mV[drift] = (uint16_t)(s.cell_mV[drift] - ((s.time_us >> 12) & 15));
+    ++s.time_us;
+    return cells;
+}
+
+static double run(ML5238_Fleet &fleet, const ML5238_Topology &topo, uint8_t placement, double seconds) {
+    if (!fleet.start(topo, 0, placement, feed, nullptr)) return 0.0;
+    // Warm up, then count
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    const uint64_t n0 = fleet.scans();
+    const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds((long)(seconds * 1000)));
+    const uint64_t n1 = fleet.scans();
+    const double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    fleet.stop();
+    return (double)(n1 - n0) / s;
+}
+
+int main(int argc, char **argv) {
+    const uint32_t modules = argc > 1 ? (uint32_t)atol(argv[1]) : 8000;
+    const double seconds = argc > 2 ? atof(argv[2]) : 2.0;
+    ML5238_Topology topo;
+    const bool numa = topo.load();
+    if (argc > 3) topo.split((unsigned)atoi(argv[3]));
+
+    printf("%u modules, %u bytes each, %.1f MB of state\n", modules, (unsigned)sizeof(ML5238_Module),
+           modules * sizeof(ML5238_Module) / 1048576.0);
+    for (unsigned n = 0; n < topo.nodes(); ++n) {
+        printf("node %d%s: CPUs", topo.node(n).id, numa && argc <= 3 ? "" : " (pretend)");
+        for (int c : topo.node(n).cpus) printf(" %d", c);
+        printf("\n");
+    }
+    printf("\n%-6s %8s %16s %16s %8s %10s\n", "nodes", "workers", "anywhere scans/s", "local scans/s", "gain",
+           "scaling");
+    double base = 0.0;
+    for (unsigned n = 1; n <= topo.nodes(); ++n) {
+        ML5238_Topology sub = topo;
+        sub.keep(n);
+        ML5238_Fleet fleet(modules);
+        const double any = run(fleet, sub, ML5238_FLEET_ANYWHERE, seconds);
+        const double local = run(fleet, sub, ML5238_FLEET_LOCAL, seconds);
+        if (n == 1) base = local;
+        printf("%-6u %8u %16.0f %16.0f %7.2fx %9.2fx\n", n, fleet.workers(), any, local, any > 0 ? local / any : 0.0,
+               base > 0 ? local / base : 0.0);
+    }
+    return 0;
+}
@@ -0,0 +1,72 @@
+// Register access guard: cost per check and the unsafe commands it stops on the simulator.
+// g++ -O2 -std=c++11 bench_guard.cpp ../sim/ML5238_sim.cpp ../*.cpp -o bench_guard
+// ./bench_guard [checks]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../ML5238_guard.h"
+#include "../sim/ML5238_sim.h"
+#include "ML5238_profiles.h"
+
+using namespace drivers;
+using namespace drivers::ml5238;
+
+int main(int argc, char **argv) {
+    const uint32_t n = argc > 1 ? (uint32_t)atol(argv[1]) : 20000000;
+
+    // Random commands against a guard that has seen a typical setup
+    ML5238_Guard g;
+    g.wrote(REG_RSENSE, RSENSE_ESC | RSENSE_ISC | RSENSE_ERS, 0);
+    g.wrote(REG_PSENSE, PSENSE_EPSL, 0);
+    static uint8_t reg[4096], val[4096];
+    uint32_t x = 12345, refused = 0;
+    for (uint32_t i = 0; i < 4096; ++i) {
+        x = x * 1664525 + 1013904223;
+        reg[i] = (uint8_t)((x >> 24) % 12);
+        val[i] = (uint8_t)(x >> 8);
+    }
+    const clock_t c0 = clock();
+    for (uint32_t i = 0; i < n; ++i) refused += g.check_write(reg[i & 4095], val[i & 4095], i) != ML5238_RULE_OK;
+    const double ns = (double)(clock() - c0) / CLOCKS_PER_SEC * 1e9 / n;
+    printf("%.2f ns per check (%u refused of %u)\n\n", ns, refused, n);
+
+    // Unsafe sequences through the driver
+    ML5238_Pack pack(16);
+    ML5238_Sim sim(pack, ML5238_BenchSimConfig());
+    ML5238 bms(sim);
+    ML5238_Guard guard;
+    bms.set_guard(&guard);
+    bms.begin(ML5238_BenchConfig());
+    bms.set_fets(true, true);
+
+    bms.write(REG_CBALH, 0x03);                             // SW16 next to SW15
+    bms.write(REG_CBALL, 0x80);
+    bms.write(REG_CBALH, 0x01);                             // SW9 next to SW8
+    bms.write(0x0B, 0);                                     // TEST
+    bms.read(0x0F);
+    bms.write(REG_PSENSE, PSENSE_EPSH | PSENSE_IPSH);       // interrupt with the enable
+    bms.write(REG_PSENSE, PSENSE_EPSH);
+    sim.delay_us(200);
+    bms.write(REG_PSENSE, PSENSE_EPSH | PSENSE_IPSH);       // 200 us later
+    bms.write(REG_POWER, POWER_PDWN);                       // FETs still on
+    bms.set_fets(false, false);
+    bms.write(REG_POWER, POWER_PDWN);                       // PSENSE not read
+    sim.set_charger(false);
+    bms.read(REG_PSENSE);
+    sim.set_pupin(true);
+    bms.read(REG_POWER);
+    bms.write(REG_POWER, POWER_PDWN);                       // /PUPIN low
+    bms.write(REG_FET, FET_DRV);
+    for (int i = 0; i < 3; ++i) {
+        sim.delay_us(6000);
+        bms.write(REG_FET, FET_DRV);                        // kept on past 10 ms
+    }
+    bms.tick();
+    const bool drv_cleared = !(bms.shadow(REG_FET) & FET_DRV);
+
+    printf("%-24s %8s\n", "rule", "refused");
+    for (uint8_t r = 1; r < ML5238_RULE_COUNT; ++r) printf("%-24s %8u\n", ML5238_Guard::rule_name(r), guard.refused_count(r));
+    printf("\nDRV cleared by tick: %s\nsimulator violations: %u\n", drv_cleared ? "yes" : "no", sim.violations());
+    return 0;
+}
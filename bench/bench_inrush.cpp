@@ -0,0 +1,154 @@
+// D_FET turn-on into inverter input capacitance: a plain set_fets() with the application retrying
+// after each short detection, against ML5238_Inrush with no DRV, the default 100 us and 500 us of
+// DRV. Per load the failed starts, the time until the load is up to 95% of the pack voltage, the
+// peak current and the energy the FETs took; then a hard short, which all must still cut off.
+// g++ -O2 -std=c++11 bench_inrush.cpp ../sim/ML5238_sim.cpp ../*.cpp -o bench_inrush
+// ./bench_inrush [attempts]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../ML5238_inrush.h"
+#include "../sim/ML5238_sim.h"
+#include "ML5238_profiles.h"
+
+using namespace drivers;
+using namespace drivers::ml5238;
+
+static ML5238_BenchSimConfig sim_cfg;
+
+struct Result {
+    bool up;
+    uint32_t trips;
+    double start_ms;            // turn-on request to the load at 95%, or to giving up
+    double peak_A;
+    double fet_J;
+};
+
+// Passes everything to the sim and keeps the largest discharge current, sampled every 10 us, so
+// the peak past the end of the IMON range shows as well
+class PeakPort : public ML5238_Port {
+public:
+    explicit PeakPort(ML5238_Sim &sim) : _sim(sim), peak_A(0.0) {}
+    void transfer(const uint8_t *tx, uint8_t *rx, uint8_t frames) override {
+        _sim.transfer(tx, rx, frames);
+        watch();
+    }
+    uint16_t vmon_mV() override { return _sim.vmon_mV(); }
+    uint16_t imon_mV() override {
+        const uint16_t mV = _sim.imon_mV();
+        watch();
+        return mV;
+    }
+    uint32_t micros() override { return _sim.micros(); }
+    void delay_us(uint32_t us) override {
+        for (; us > 10; us -= 10) {
+            _sim.delay_us(10);
+            watch();
+        }
+        _sim.delay_us(us);
+        watch();
+    }
+    uint32_t set_clock(uint32_t hz) override { return _sim.set_clock(hz); }
+
+private:
+    void watch() {
+        if (_sim.current() < peak_A) peak_A = _sim.current();
+    }
+    ML5238_Sim &_sim;
+
+public:
+    double peak_A;
+};
+
+struct Rig {
+    Rig(double uF, double load_A) : sim(pack, sim_cfg), port(sim), bms(port) {
+        for (uint8_t i = 0; i < pack.cells(); ++i) pack.cell(i).soc = 0.7;
+        bms.begin(ML5238_BenchConfig());
+        sim.set_load_capacitance(uF, 200.0);
+        sim.set_load(load_A);
+        target_V = 0.95 * pack.pack_V(0.0);
+    }
+    bool up() { return sim.load_V() >= target_V && (sim.peek(REG_FET) & FET_DF); }
+
+    ML5238_Pack pack{ 16 };
+    ML5238_Sim sim;
+    PeakPort port;
+    ML5238 bms;
+    double target_V;
+};
+
+// What an application does without help: turn on, check after 20 ms, retry after 20 ms more
+static Result plain(double uF, double load_A, uint8_t attempts) {
+    Rig r(uF, load_A);
+    Result res = Result();
+    const uint64_t t0 = r.sim.now_ns();
+    uint64_t up_ns = 0;
+    for (uint8_t a = 0; a < attempts && !res.up; ++a) {
+        r.bms.set_fets(true, true);
+        for (uint32_t t = 0; t < 20000; t += 10) {
+            r.port.delay_us(10);
+            if (!up_ns && r.up()) up_ns = r.sim.now_ns();
+        }
+        r.bms.read_status();
+        if (r.bms.state().faults & ML5238_FAULT_SC) {
+            ++res.trips;
+            up_ns = 0;
+            r.port.delay_us(20000);
+            r.bms.clear_faults();
+            continue;
+        }
+        res.up = r.up();
+    }
+    res.start_ms = (double)((res.up ? up_ns : r.sim.now_ns()) - t0) * 1e-6;
+    res.peak_A = r.port.peak_A;
+    res.fet_J = r.sim.fet_J();
+    return res;
+}
+
+static Result inrush(double uF, double load_A, uint8_t attempts, uint32_t drv_us) {
+    Rig r(uF, load_A);
+    ML5238_InrushConfig cfg;
+    cfg.attempts = attempts;
+    cfg.drv_us = drv_us;
+    ML5238_Inrush in(r.bms, r.port, cfg);
+    const uint64_t t0 = r.sim.now_ns();
+    const ML5238_InrushResult ir = in.turn_on(true);
+    Result res = Result();
+    res.trips = ir.trips;
+    if (ir.code == ML5238_INRUSH_OK)
+        for (uint32_t t = 0; t < 20000 && !r.up(); t += 10) r.port.delay_us(10);
+    res.up = r.up();
+    res.start_ms = (double)(r.sim.now_ns() - t0) * 1e-6;
+    res.peak_A = r.port.peak_A;
+    res.fet_J = r.sim.fet_J();
+    return res;
+}
+
+static void print(const char *load, const char *method, const Result &r) {
+    printf("%-19s %-20s %4s %6u %9.2f %8.0f %7.3f\n", load, method, r.up ? "up" : "off", r.trips, r.start_ms,
+           r.peak_A, r.fet_J);
+}
+
+static void compare(const char *load, double uF, double load_A, uint8_t attempts) {
+    print(load, "set_fets() + retry", plain(uF, load_A, attempts));
+    print("", "inrush, no DRV", inrush(uF, load_A, attempts, 0));
+    print("", "inrush, DRV 100 us", inrush(uF, load_A, attempts, 100));
+    print("", "inrush, DRV 500 us", inrush(uF, load_A, attempts, 500));
+}
+
+int main(int argc, char **argv) {
+    const uint8_t attempts = argc > 1 ? (uint8_t)atoi(argv[1]) : 3;
+    const ML5238_SimConfig &sc = sim_cfg;
+    printf("16 cells, SETSC %u mV, 1 mohm sense, tsc %u us, gate rise %u us (%u us with DRV), loop %u mohm, "
+           "%u attempts\n\n", setsc_mV(ML5238_BenchConfig().setsc), short_delay_us(sc.cdly_nF), sc.gate_rise_us,
+           sc.gate_rise_drv_us, sc.loop_mohm, attempts);
+    printf("%-19s %-20s %4s %6s %9s %8s %7s\n", "load", "turn-on", "", "trips", "start ms", "peak A", "FET J");
+    static const double UF[] = { 470, 2200, 4700, 10000 };
+    char name[32];
+    for (uint8_t k = 0; k < 4; ++k) {
+        snprintf(name, sizeof(name), "%5.0f uF, 5 A", UF[k]);
+        compare(name, UF[k], -5.0, attempts);
+    }
+    compare("hard short, 1000 A", 0.0, -1000.0, attempts);
+    return 0;
+}
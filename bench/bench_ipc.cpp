@@ -0,0 +1,182 @@
+// Load generator for the local command server: clients keep a window of pipelined requests
+// in flight, each a batch of register commands. The server and owner run on the simulator.
+// g++ -O2 -std=c++11 -pthread bench_ipc.cpp ../host/ML5238_server.cpp ../host/ML5238_client.cpp ../host/ML5238_rt.cpp ../host/ML5238_owner.cpp ../sim/ML5238_sim.cpp ../*.cpp -o bench_ipc
+// ./bench_ipc [clients] [requests per client] [commands per request] [pipeline depth]
+
+#include <chrono>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "../host/ML5238_client.h"
+#include "../host/ML5238_server.h"
+#include "../sim/ML5238_sim.h"
+#include "ML5238_profiles.h"
+
+using namespace drivers;
+using namespace drivers::ml5238;
+
+typedef std::chrono::steady_clock Clock;
+
+static const char *PATH = "/tmp/ml5238_bench.sock";
+
+// Status polling with an occasional IMON mode write
+static void fill(ML5238_MsgCommand *cmds, uint8_t n, unsigned seed) {
+    static const uint8_t REGS[] = {REG_STATUS, REG_PSENSE, REG_RSENSE, REG_IMON, REG_FET};
+    for (uint8_t k = 0; k < n; ++k) {
+        ML5238_MsgCommand &c = cmds[k];
+        c.reg = REGS[(seed + k) % 5];
+        c.op = c.reg == REG_IMON && (seed & 1) ? ML5238_OP_WRITE : ML5238_OP_READ;
+        c.arg = IMON_OUT;
+    }
+}
+
+static bool client(unsigned requests, uint8_t batch, unsigned depth, unsigned seed, unsigned &errors) {
+    ML5238_Client cl;
+    if (!cl.connect(PATH)) return false;
+    ML5238_MsgCommand cmds[ML5238_MSG_MAX_COMMANDS];
+    ML5238_MsgResult res[ML5238_MSG_MAX_COMMANDS];
+    ML5238_MsgHeader hdr;
+    unsigned sent = 0, received = 0;
+    while (received < requests) {
+        while (sent < requests && sent - received < depth) {
+            fill(cmds, batch, seed + sent);
+            if (!cl.send(cmds, batch)) return false;
+            ++sent;
+        }
+        if (!cl.receive(hdr, res)) return false;
+        for (uint8_t k = 0; k < hdr.count; ++k)
+            if (res[k].status != ML5238_MSG_OK) ++errors;
+        ++received;
+    }
+    return true;
+}
+
+// Bare socket, to send what ML5238_Client would not
+static int raw_connect() {
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = sockaddr_un();
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, PATH, sizeof(addr.sun_path) - 1);
+    if (fd >= 0 && ::connect(fd, (const sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Empty requests, more than the server keeps per round, arriving in one write: all answered in order
+static bool flood(ML5238_Server &server, uint16_t n) {
+    const int fd = raw_connect();
+    if (fd < 0) return false;
+    const uint32_t before = server.requests();
+    std::vector<ML5238_MsgHeader> hdr(n);
+    for (uint16_t i = 0; i < n; ++i) {
+        hdr[i].id = i;
+        hdr[i].count = 0;
+        hdr[i].flags = 0;
+    }
+    const ssize_t len = (ssize_t)(n * sizeof(ML5238_MsgHeader));
+    bool ok = ::send(fd, hdr.data(), (size_t)len, MSG_NOSIGNAL) == len;
+    for (uint16_t i = 0; ok && i < n; ++i) {
+        ML5238_MsgHeader r;
+        ok = recv(fd, &r, sizeof(r), MSG_WAITALL) == (ssize_t)sizeof(r) && r.id == i && !r.count;
+    }
+    close(fd);
+    return ok && server.requests() - before == n;
+}
+
+// A client that pipelines full requests until its socket is full and never reads a reply. Process
+// CPU time over 300 ms of that, with everything else idle; -1 if the client could not connect.
+static double stalled_cpu_pct() {
+    const int fd = raw_connect();
+    if (fd < 0) return -1.0;
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    uint8_t req[sizeof(ML5238_MsgHeader) + ML5238_MSG_MAX_COMMANDS * sizeof(ML5238_MsgCommand)];
+    ML5238_MsgHeader hdr;
+    hdr.count = ML5238_MSG_MAX_COMMANDS;
+    hdr.flags = 0;
+    ML5238_MsgCommand *cmds = reinterpret_cast<ML5238_MsgCommand *>(req + sizeof(hdr));
+    fill(cmds, ML5238_MSG_MAX_COMMANDS, 0);
+    // Whole requests only, until the server has stopped taking them for 50 ms
+    size_t at = 0;
+    for (unsigned id = 0, idle = 0; idle < 50;) {
+        if (!at) {
+            hdr.id = (uint16_t)id++;
+            memcpy(req, &hdr, sizeof(hdr));
+        }
+        const ssize_t r = ::send(fd, req + at, sizeof(req) - at, MSG_NOSIGNAL);
+        if (r > 0) {
+            at = (at + (size_t)r) % sizeof(req);
+            idle = 0;
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            ++idle;
+        }
+    }
+    const clock_t c0 = clock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    const double pct = (double)(clock() - c0) / CLOCKS_PER_SEC / 0.3 * 100.0;
+    close(fd);
+    return pct;
+}
+
+int main(int argc, char **argv) {
+    const unsigned clients = argc > 1 ? (unsigned)atoi(argv[1]) : 4;
+    const unsigned requests = argc > 2 ? (unsigned)atoi(argv[2]) : 5000;
+    const unsigned b = argc > 3 ? (unsigned)atoi(argv[3]) : 8;
+    const uint8_t batch = (uint8_t)(b < 1 ? 1 : (b > ML5238_MSG_MAX_COMMANDS ? ML5238_MSG_MAX_COMMANDS : b));
+    const unsigned depth = argc > 4 ? (unsigned)atoi(argv[4]) : 4;
+
+    ML5238_Pack pack(16);
+    ML5238_Sim sim(pack, ML5238_BenchSimConfig());
+    ML5238 bms(sim);
+    bms.begin(ML5238_BenchConfig());
+    ML5238_Owner owner(bms, 0);
+    ML5238_Server server(owner);
+    if (!server.open(PATH)) {
+        perror("server");
+        return 1;
+    }
+    owner.start();
+    std::thread srv(&ML5238_Server::run, &server);
+
+    const uint32_t frames0 = sim.frames();
+    const Clock::time_point t0 = Clock::now();
+    std::vector<std::thread> th;
+    std::vector<unsigned> errors(clients, 0);
+    std::vector<char> ok(clients, 0);
+    for (unsigned c = 0; c < clients; ++c)
+        th.push_back(std::thread([&, c] { ok[c] = client(requests, batch, depth, c * 7, errors[c]); }));
+    for (size_t i = 0; i < th.size(); ++i) th[i].join();
+    const double s = std::chrono::duration<double>(Clock::now() - t0).count();
+    const bool flood_ok = flood(server, 800);
+    const double stalled = stalled_cpu_pct();
+
+    server.stop();
+    srv.join();
+    owner.stop();
+
+    unsigned failed = 0, bad = 0;
+    for (unsigned c = 0; c < clients; ++c) {
+        failed += !ok[c];
+        bad += errors[c];
+    }
+    const double total = (double)clients * requests;
+    printf("%u clients, %u commands per request, depth %u\n\n", clients, batch, depth);
+    printf("requests/s      %10.0f\n", total / s);
+    printf("commands/s      %10.0f\n", total * batch / s);
+    printf("bursts/request  %10.3f\n", owner.bursts() / total);
+    printf("frames/command  %10.3f\n", (sim.frames() - frames0) / (total * batch));
+    printf("server rounds   %10u\n", server.rounds());
+    printf("failed clients  %10u\nerror results   %10u\n", failed, bad);
+    printf("empty flood     %10s\n", flood_ok ? "ok" : "FAILED");
+    printf("stalled reader  %9.0f%% CPU\n", stalled);
+    return failed || !flood_ok ? 1 : 0;
+}
@@ -0,0 +1,106 @@
+// /INTO under a charger and load bounce storm: every edge served against the adaptive switch to
+// polling. Quiet phase with occasional unplugs, a storm of bounces, then calm again; per phase
+// the STATUS reads, bus frames and share of bus time of the handler and the time /INTO stays low.
+// g++ -O2 -std=c++11 bench_irq.cpp ../sim/ML5238_sim.cpp ../*.cpp -o bench_irq
+// ./bench_irq [bounce period us] [poll us]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../ML5238_irq.h"
+#include "../sim/ML5238_sim.h"
+#include "ML5238_profiles.h"
+
+using namespace drivers;
+using namespace drivers::ml5238;
+
+struct Phase {
+    const char *name;
+    uint32_t ms;
+    uint32_t bounce_us;         // 0: one unplug and replug every event_ms
+    uint32_t event_ms;
+};
+
+static void run(const char *title, const ML5238_IrqConfig &cfg, const Phase *phases, uint8_t n) {
+    ML5238_Pack pack(16);
+    ML5238_Sim sim(pack, ML5238_BenchSimConfig());
+    ML5238 bms(sim);
+    bms.begin(ML5238_BenchConfig());
+    sim.set_charger(true);
+    sim.set_load_connected(true);
+    // Comparators first, interrupts once they have settled
+    bms.write(REG_PSENSE, PSENSE_EPSL);
+    bms.write(REG_RSENSE, RSENSE_ESC | RSENSE_ISC | RSENSE_ERS);
+    sim.delay_us(2000);
+    bms.write(REG_PSENSE, PSENSE_EPSL | PSENSE_IPSL);
+    bms.write(REG_RSENSE, RSENSE_ESC | RSENSE_ISC | RSENSE_ERS | RSENSE_IRS);
+    ML5238_Irq irq(bms, cfg);
+
+    printf("%s\n  %-7s %8s %8s %8s %8s %9s %10s %10s %6s\n", title, "phase", "edges", "reads", "frames", "flags",
+           "bus share", "low avg us", "low max us", "mode");
+    const uint64_t step_ns = 20000;
+    for (uint8_t p = 0; p < n; ++p) {
+        const Phase &ph = phases[p];
+        const ML5238_IrqStats s0 = irq.stats();
+        uint32_t edges = 0, lows = 0;
+        const uint64_t start = sim.now_ns(), end = start + (uint64_t)ph.ms * 1000000;
+        uint64_t bus_ns = 0, low_sum_ns = 0, low_max_ns = 0, low_since = start;
+        bool pin = sim.int_pin();
+        uint64_t next_flip = start;
+        bool plugged = true;
+        while (sim.now_ns() < end) {
+            const uint64_t now = sim.now_ns();
+            if (now >= next_flip) {
+                plugged = !plugged;
+                sim.set_charger(plugged);
+                sim.set_load_connected(plugged);
+                if (ph.bounce_us) next_flip += (uint64_t)ph.bounce_us * 1000;
+                else next_flip += plugged ? (uint64_t)ph.event_ms * 1000000 : 1000000;
+            }
+            // /INTO is active low: pin() true means asserted
+            const bool p2 = sim.int_pin();
+            if (p2 && !pin) {
+                ++edges;
+                low_since = now;
+                if (irq.irq_enabled()) irq.on_edge();
+            }
+            pin = p2;
+            const uint64_t t0 = sim.now_ns();
+            irq.service(sim.micros());
+            bus_ns += sim.now_ns() - t0;
+            const bool p3 = sim.int_pin();
+            if (pin && !p3) {
+                const uint64_t low = sim.now_ns() - low_since;
+                low_sum_ns += low;
+                if (low > low_max_ns) low_max_ns = low;
+                ++lows;
+            }
+            pin = p3;
+            if (sim.now_ns() - now < step_ns) sim.advance(step_ns - (sim.now_ns() - now));
+        }
+        const ML5238_IrqStats &s = irq.stats();
+        printf("  %-7s %8u %8u %8u %8u %8.1f%% %10.0f %10.0f %6s\n", ph.name, edges, s.status_reads - s0.status_reads,
+               s.frames - s0.frames, s.flags - s0.flags, 100.0 * bus_ns / (end - start),
+               lows ? low_sum_ns * 1e-3 / lows : 0.0, low_max_ns * 1e-3, irq.irq_enabled() ? "irq" : "poll");
+    }
+    printf("  switches to polling %u, back %u, violations %u\n\n", irq.stats().to_polling, irq.stats().to_interrupt,
+           sim.violations());
+}
+
+int main(int argc, char **argv) {
+    const uint32_t bounce_us = argc > 1 ? (uint32_t)atol(argv[1]) : 200;
+    ML5238_IrqConfig adaptive;
+    if (argc > 2) adaptive.poll_us = (uint32_t)atol(argv[2]);
+    ML5238_IrqConfig always = adaptive;
+    always.storm_per_s = 65535;
+
+    const Phase phases[] = {
+        { "quiet", 1000, 0, 200 },
+        { "storm", 2000, bounce_us, 0 },
+        { "calm", 2000, 0, 200 },
+    };
+    printf("bounce every %u us in the storm, poll every %u us, rates over %u ms\n\n", bounce_us, adaptive.poll_us,
+           adaptive.window_us / 1000);
+    run("every edge served", always, phases, 3);
+    run("adaptive", adaptive, phases, 3);
+    return 0;
+}
@@ -0,0 +1,154 @@
+// Many clients against one device: global mutex around the driver versus the single owner
+// thread with batched bursts. The port adds a host cost per transfer call and per frame
+// like a spidev ioctl at 1 MHz.
+// g++ -O2 -std=c++11 -pthread bench_owner.cpp ../host/ML5238_rt.cpp ../host/ML5238_owner.cpp ../sim/ML5238_sim.cpp ../*.cpp -o bench_owner
+// ./bench_owner [clients] [ops per client] [call_us]
+
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+#include "../host/ML5238_owner.h"
+#include "../sim/ML5238_sim.h"
+#include "ML5238_profiles.h"
+
+using namespace drivers;
+using namespace drivers::ml5238;
+
+typedef std::chrono::steady_clock Clock;
+
+static void spin_us(uint32_t us) {
+    const Clock::time_point end = Clock::now() + std::chrono::microseconds(us);
+    while (Clock::now() < end) {
+    }
+}
+
+class BusPort : public ML5238_Port {
+public:
+    BusPort(ML5238_Sim &sim, uint32_t call_us) : _sim(sim), _call_us(call_us), _calls(0) {}
+
+    void transfer(const uint8_t *tx, uint8_t *rx, uint8_t frames) override {
+        spin_us(_call_us + frames * 16);
+        _sim.transfer(tx, rx, frames);
+        ++_calls;
+    }
+    uint16_t vmon_mV() override { return _sim.vmon_mV(); }
+    uint16_t imon_mV() override { return _sim.imon_mV(); }
+    uint32_t micros() override { return _sim.micros(); }
+    void delay_us(uint32_t us) override { _sim.delay_us(us); }
+
+    uint32_t calls() const { return _calls; }
+
+private:
+    ML5238_Sim &_sim;
+    uint32_t _call_us;
+    uint32_t _calls;
+};
+
+// Mix of a client polling status, trimming the IMON mode and reading it back
+static uint8_t client_op(unsigned i, uint8_t &reg, uint8_t &val) {
+    switch (i % 4) {
+    case 0: reg = REG_STATUS; return 0;
+    case 1: reg = REG_PSENSE; return 0;
+    case 2: reg = REG_IMON; val = (uint8_t)(IMON_OUT | ((i >> 2) & 1)); return 1;
+    default: reg = REG_IMON; return 0;
+    }
+}
+
+struct Result {
+    double seconds;
+    uint32_t calls;
+    uint32_t frames;
+};
+
+static Result run_mutex(unsigned clients, unsigned ops, uint32_t call_us) {
+    ML5238_Pack pack(16);
+    ML5238_Sim sim(pack, ML5238_BenchSimConfig());
+    BusPort port(sim, call_us);
+    ML5238 bms(port);
+    bms.begin(ML5238_BenchConfig());
+    const uint32_t calls0 = port.calls(), frames0 = sim.frames();
+    std::mutex m;
+
+    const Clock::time_point t0 = Clock::now();
+    std::vector<std::thread> th;
+    for (unsigned c = 0; c < clients; ++c) {
+        th.push_back(std::thread([&, c] {
+            for (unsigned i = 0; i < ops; ++i) {
+                uint8_t reg = 0, val = 0;
+                const bool wr = client_op(i + c, reg, val) != 0;
+                std::lock_guard<std::mutex> lk(m);
+                if (wr) bms.write(reg, val);
+                else bms.read(reg);
+            }
+        }));
+    }
+    for (size_t i = 0; i < th.size(); ++i) th[i].join();
+    Result r = {std::chrono::duration<double>(Clock::now() - t0).count(), port.calls() - calls0,
+                sim.frames() - frames0};
+    return r;
+}
+
+static Result run_owner(unsigned clients, unsigned ops, uint32_t call_us, uint32_t &merged, uint32_t &reads) {
+    ML5238_Pack pack(16);
+    ML5238_Sim sim(pack, ML5238_BenchSimConfig());
+    BusPort port(sim, call_us);
+    ML5238 bms(port);
+    bms.begin(ML5238_BenchConfig());
+    const uint32_t calls0 = port.calls(), frames0 = sim.frames();
+    ML5238_Owner owner(bms, 0);
+    owner.start();
+
+    // A 10 kHz monitor reads the published state without touching the bus
+    std::atomic<bool> done(false);
+    reads = 0;
+    std::thread monitor([&] {
+        ML5238_Snapshot s;
+        while (!done.load(std::memory_order_relaxed)) {
+            owner.snapshot(s);
+            ++reads;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+
+    const Clock::time_point t0 = Clock::now();
+    std::vector<std::thread> th;
+    for (unsigned c = 0; c < clients; ++c) {
+        th.push_back(std::thread([&, c] {
+            for (unsigned i = 0; i < ops; ++i) {
+                uint8_t reg = 0, val = 0;
+                if (client_op(i + c, reg, val)) owner.write(reg, val);
+                else owner.read(reg);
+            }
+        }));
+    }
+    for (size_t i = 0; i < th.size(); ++i) th[i].join();
+    Result r = {std::chrono::duration<double>(Clock::now() - t0).count(), port.calls() - calls0,
+                sim.frames() - frames0};
+    done.store(true);
+    monitor.join();
+    owner.stop();
+    merged = owner.merged();
+    return r;
+}
+
+int main(int argc, char **argv) {
+    const unsigned clients = argc > 1 ? (unsigned)atoi(argv[1]) : 8;
+    const unsigned ops = argc > 2 ? (unsigned)atoi(argv[2]) : 2000;
+    const uint32_t call_us = argc > 3 ? (uint32_t)atoi(argv[3]) : 20;
+    const double total = (double)clients * ops;
+
+    printf("%u clients x %u ops, %u us per transfer call\n\n", clients, ops, call_us);
+    printf("%-8s %10s %10s %12s %10s\n", "mode", "ops/s", "calls/op", "frames/op", "merged");
+
+    const Result m = run_mutex(clients, ops, call_us);
+    printf("%-8s %10.0f %10.3f %12.3f %10s\n", "mutex", total / m.seconds, m.calls / total, m.frames / total, "-");
+
+    uint32_t merged = 0, reads = 0;
+    const Result o = run_owner(clients, ops, call_us, merged, reads);
+    printf("%-8s %10.0f %10.3f %12.3f %10u\n", "owner", total / o.seconds, o.calls / total, o.frames / total, merged);
+    printf("\nmonitor snapshots during owner run: %u\n", reads);
+    return 0;
+}
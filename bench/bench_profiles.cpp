@@ -0,0 +1,75 @@
+// End to end driver benchmark over standard load profiles, no hardware needed.
+// g++ -O2 -std=c++11 bench_profiles.cpp ../sim/ML5238_sim.cpp ../*.cpp -o bench_profiles
+// ./bench_profiles [tick_us] [cells]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ML5238_profiles.h"
+
+using namespace drivers;
+
+struct Scenario {
+    const char *name;
+    double start_soc;
+    double seconds;
+    ML5238_Twin::Profile profile;
+    void *ctx;
+};
+
+static void run(const Scenario &s, uint32_t tick_us, uint8_t cells, ML5238_CCCV *cccv) {
+    ML5238_Pack pack(cells);
+    // +-1.5% SOC spread and capacity tolerance, repeatable
+    for (uint8_t i = 0; i < pack.cells(); ++i) {
+        pack.cell(i).soc = s.start_soc + 0.003 * ((i * 7) % 11) - 0.015;
+        pack.cell(i).capacity_As *= 1.0 - 0.004 * ((i * 5) % 7);
+    }
+    ML5238_Sim sim(pack, ML5238_BenchSimConfig());
+    if (cccv) cccv->sim = &sim;
+    ML5238 bms(sim);
+    ML5238_BenchConfig cfg;
+    cfg.cells = cells;
+    bms.begin(cfg);
+    bms.set_fets(true, true);
+    ML5238_Twin twin(sim, bms, tick_us);
+
+    const clock_t c0 = clock();
+    twin.run(s.seconds, s.profile, s.ctx);
+    const double cpu = (double)(clock() - c0) / CLOCKS_PER_SEC;
+
+    const ML5238_TwinStats &t = twin.stats();
+    const uint32_t prot = t.ov_events + t.uv_events;
+    printf("%-14s %8.0f %10.1f %9.0f %8.0f %4u %8.1f %4u %8.3f %7.2f %7.2f\n", s.name, t.sim_s,
+           cpu * 1e6 / t.sim_s, t.sim_s / cpu, sim.frames() / t.sim_s, prot,
+           prot ? t.latency_max_s * 1e3 : 0.0, t.sc_events, t.sc_latency_max_s * 1e3,
+           t.soc_err_max * 100.0, t.ticks ? t.soc_err_sum / t.ticks * 100.0 : 0.0);
+}
+
+int main(int argc, char **argv) {
+    const uint32_t tick_us = argc > 1 ? (uint32_t)atol(argv[1]) : 10000;
+    const uint8_t cells = argc > 2 ? (uint8_t)atoi(argv[2]) : 16;
+
+    double half_c = -25.0;
+    ML5238_Pulse pulse = { -60.0, 0.0, 10.0, 30.0 };
+    ML5238_Drive drive = { 60.0 };
+    ML5238_CCCV cccv = { 0, 25.0, 4.15, 2.5 };
+    double fault_A = 25.0;
+    ML5238_Step shorted = { 1.0, -5.0, -300.0 };
+
+    const Scenario scenarios[] = {
+        { "idle",         0.50, 86400.0, profile_idle,     0 },
+        { "discharge C/2",0.90, 9000.0,  profile_constant, &half_c },
+        { "pulse",        0.80, 3600.0,  profile_pulse,    &pulse },
+        { "drive",        0.80, 3600.0,  profile_drive,    &drive },
+        { "charge CC/CV", 0.20, 10800.0, profile_cccv,     &cccv },
+        { "charger fault",0.90, 3600.0,  profile_constant, &fault_A },
+        { "short",        0.80, 5.0,     profile_step,     &shorted },
+    };
+
+    printf("tick %u us, %u cells\n", tick_us, cells);
+    printf("%-14s %8s %10s %9s %8s %4s %8s %4s %8s %7s %7s\n", "scenario", "sim s", "cpu us/s",
+           "x real", "frames/s", "prot", "max ms", "sc", "sc ms", "soc max", "soc avg");
+    for (unsigned i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i)
+        run(scenarios[i], tick_us, cells, scenarios[i].ctx == &cccv ? &cccv : 0);
+    return 0;
+}
@@ -0,0 +1,58 @@
+// Register map tables from ML5238_regs.def: log text of known register values against the
+// expected decode, then the cost of decode() per value.
+// g++ -O2 -std=c++11 bench_regs.cpp ../*.cpp -o bench_regs
+// ./bench_regs [decodes]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../ML5238_regs.h"
+
+using namespace drivers::ml5238;
+
+struct Known {
+    uint8_t reg;
+    uint8_t val;
+    const char *text;
+};
+
+static const Known KNOWN[] = {
+    { REG_NOOP, 0x00, "NOOP" },
+    { REG_NOOP, 0xA5, "NOOP DATA=165" },
+    { REG_VMON, VMON_OUT | 5, "VMON CN=5 OUT" },
+    { REG_IMON, IMON_OUT | IMON_GIM, "IMON GIM OUT" },
+    { REG_FET, FET_DF | FET_CF | FET_DRV, "FET DF CF DRV" },
+    { REG_PSENSE, PSENSE_EPSL | PSENSE_IPSL | PSENSE_RPSL, "PSENSE RPSL IPSL EPSL" },
+    { REG_RSENSE, RSENSE_ESC | RSENSE_ISC | RSENSE_SC, "RSENSE SC ISC ESC" },
+    { REG_POWER, POWER_PUPIN, "POWER PUPIN" },
+    { REG_STATUS, STATUS_DF | STATUS_RSC, "STATUS DF RSC" },
+    { REG_CBALH, 0x81, "CBALH SW9 SW16" },
+    { REG_CBALL, 0x0A, "CBALL SW2 SW4" },
+    { REG_SETSC, 3, "SETSC SC=3" },
+    { 0x0F, 0x12, "TEST=18" },
+};
+
+int main(int argc, char **argv) {
+    const uint32_t n = argc > 1 ? (uint32_t)atol(argv[1]) : 10000000;
+    const uint8_t count = (uint8_t)(sizeof(KNOWN) / sizeof(KNOWN[0]));
+    char buf[64];
+    uint8_t bad = 0;
+    for (uint8_t i = 0; i < count; ++i) {
+        const Known &k = KNOWN[i];
+        decode(k.reg, k.val, buf, sizeof(buf));
+        const bool ok = !strcmp(buf, k.text);
+        bad = (uint8_t)(bad + !ok);
+        printf("%-7s %02X  %-24s %s\n", reg_name(k.reg), k.val, buf, ok ? "" : k.text);
+    }
+    // A short buffer cuts the text and keeps the terminator
+    const uint8_t cut = decode(REG_FET, FET_DF | FET_CF, buf, 6);
+    const bool cut_ok = cut == 5 && !strcmp(buf, "FET D");
+    printf("\n%u of %u decodes as expected, short buffer %s\n", count - bad, count, cut_ok ? "ok" : "WRONG");
+
+    uint32_t sum = 0;
+    const clock_t c0 = clock();
+    for (uint32_t i = 0; i < n; ++i) sum += decode((uint8_t)(i % REG_COUNT), (uint8_t)(i * 37), buf, sizeof(buf));
+    printf("%.1f ns per decode (%u)\n", (double)(clock() - c0) / CLOCKS_PER_SEC * 1e9 / n, sum & 1);
+    return bad || !cut_ok ? 1 : 0;
+}
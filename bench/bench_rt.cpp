@@ -0,0 +1,84 @@
+// Owner thread tick lateness on a loaded Linux host, default scheduling against the real-time
+// mode: locked and prefaulted memory, the owner pinned to an isolated (or the last) CPU and
+// SCHED_FIFO. Load threads allocate, touch fresh pages and spin on every CPU meanwhile.
+// Without CAP_SYS_NICE / CAP_IPC_LOCK the steps that failed are shown and skipped.
+// g++ -O2 -std=c++11 -pthread bench_rt.cpp ../host/ML5238_rt.cpp ../host/ML5238_owner.cpp ../sim/ML5238_sim.cpp ../*.cpp -o bench_rt
+// ./bench_rt [seconds] [load threads] [priority]
+
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "../host/ML5238_owner.h"
+#include "../host/ML5238_rt.h"
+#include "../sim/ML5238_sim.h"
+#include "ML5238_profiles.h"
+
+using namespace drivers;
+
+typedef std::chrono::steady_clock Clock;
+
+static void load(std::atomic<bool> &run) {
+    while (run.load(std::memory_order_relaxed)) {
+        const size_t n = 4 << 20;
+        volatile uint8_t *p = (volatile uint8_t *)malloc(n);
+        if (p)
+            for (size_t i = 0; i < n; i += 4096) p[i] = (uint8_t)i;
+        free((void *)p);
+        const Clock::time_point end = Clock::now() + std::chrono::milliseconds(3);
+        while (Clock::now() < end) {
+        }
+    }
+}
+
+static void run(const char *name, double seconds, unsigned loaders, const ML5238_RtThread *rt, uint8_t mem) {
+    ML5238_Pack pack(16);
+    ML5238_Sim sim(pack, ML5238_BenchSimConfig());
+    ML5238 bms(sim);
+    bms.begin(ML5238_BenchConfig());
+    ML5238_Owner owner(bms, 1000);
+    if (rt) owner.set_rt(*rt);
+
+    std::atomic<bool> busy(true);
+    std::vector<std::thread> th;
+    for (unsigned i = 0; i < loaders; ++i) th.push_back(std::thread(load, std::ref(busy)));
+    owner.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds((long)(seconds * 1000)));
+    const uint8_t flags = owner.rt() | mem;
+    owner.stop();
+    busy = false;
+    for (std::thread &t : th) t.join();
+
+    const ML5238_LatencyHist &h = owner.tick_latency();
+    printf("%-8s %-20s %7u %7.1f %7u %7u %7u %7u %9u\n", name, ML5238_Rt::describe(flags), h.count(), h.avg_us(),
+           h.percentile_us(500), h.percentile_us(990), h.percentile_us(999), h.max_us(), h.above(1000));
+}
+
+int main(int argc, char **argv) {
+    const double seconds = argc > 1 ? atof(argv[1]) : 5.0;
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    const unsigned loaders = argc > 2 ? (unsigned)atoi(argv[2]) : (unsigned)(cpus > 0 ? cpus : 1);
+    const int priority = argc > 3 ? atoi(argv[3]) : 80;
+
+    // The last isolated CPU, else the last online one
+    int cpu = (int)(cpus > 0 ? cpus - 1 : 0);
+    const uint64_t iso = ML5238_Rt::isolated_cpus();
+    for (int c = 63; c >= 0; --c)
+        if (iso & (1ULL << c)) {
+            cpu = c;
+            break;
+        }
+    printf("1 ms owner tick, %u load threads, %ld CPUs, owner on CPU %d%s, priority %d\n\n", loaders, cpus, cpu,
+           iso ? " (isolated)" : "", priority);
+    printf("%-8s %-20s %7s %7s %7s %7s %7s %7s %9s\n", "mode", "applied", "ticks", "avg us", "p50", "p99", "p99.9",
+           "max", "> 1 ms");
+    run("default", seconds, loaders, nullptr, 0);
+    // Locking is process wide and stays, so this run goes last
+    const uint8_t mem = ML5238_Rt::lock_memory(16 << 20);
+    const ML5238_RtThread rt(cpu, priority);
+    run("rt", seconds, loaders, &rt, mem);
+    return 0;
+}
@@ -0,0 +1,117 @@
+// Protection latency behind diagnostic traffic: one FIFO against the class scheduler, with a
+// saturating diagnostic load, 1 kHz control bursts and protection jobs at random times.
+// g++ -O2 -std=c++11 bench_sched.cpp ../sim/ML5238_sim.cpp ../*.cpp -o bench_sched
+// ./bench_sched [seconds] [burst frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../ML5238_sched.h"
+#include "../sim/ML5238_sim.h"
+#include "ML5238_profiles.h"
+
+using namespace drivers;
+using namespace drivers::ml5238;
+
+static const char *const NAMES[ML5238_CLASS_COUNT] = { "protect", "control", "diag" };
+
+// Batches of one kind of traffic and their latency from the moment they were due
+struct Pool {
+    ML5238_Sim *sim;
+    ML5238_Batch batch[ML5238_Sched::QUEUE];
+    bool busy[ML5238_Sched::QUEUE];
+    uint64_t due_ns[ML5238_Sched::QUEUE];
+    uint32_t jobs;
+    uint64_t frames;
+    double lat_sum_us;
+    double lat_max_us;
+
+    Pool() : sim(nullptr), jobs(0), frames(0), lat_sum_us(0.0), lat_max_us(0.0) {
+        for (uint8_t i = 0; i < ML5238_Sched::QUEUE; ++i) busy[i] = false;
+    }
+    ML5238_Batch *get(uint64_t due) {
+        for (uint8_t i = 0; i < ML5238_Sched::QUEUE; ++i)
+            if (!busy[i]) {
+                busy[i] = true;
+                due_ns[i] = due;
+                batch[i].clear();
+                return &batch[i];
+            }
+        return nullptr;
+    }
+};
+
+static void release(ML5238_Batch &b, bool, void *ctx) {
+    Pool &p = *(Pool *)ctx;
+    const long i = &b - p.batch;
+    const double lat = (double)(p.sim->now_ns() - p.due_ns[i]) * 1e-3;
+    p.busy[i] = false;
+    ++p.jobs;
+    p.frames += b.size();
+    p.lat_sum_us += lat;
+    if (lat > p.lat_max_us) p.lat_max_us = lat;
+}
+
+// fifo: every job in one class and whole, as without the scheduler
+static void run(double seconds, uint8_t burst, bool fifo) {
+    ML5238_Pack pack(16);
+    ML5238_Sim sim(pack, ML5238_BenchSimConfig());
+    ML5238 bms(sim);
+    bms.begin(ML5238_BenchConfig());
+    ML5238_Sched sched(bms, sim, fifo ? ML5238_Batch::MAX_FRAMES : burst);
+    Pool pools[ML5238_CLASS_COUNT];
+    for (uint8_t c = 0; c < ML5238_CLASS_COUNT; ++c) pools[c].sim = &sim;
+
+    uint32_t x = 77;
+    const uint64_t end = sim.now_ns() + (uint64_t)(seconds * 1e9);
+    uint64_t next_control = sim.now_ns(), next_protect = sim.now_ns() + 5000000;
+    while (sim.now_ns() < end) {
+        // Diagnostics keep the bus busy with 32 frame NOOP echo bursts
+        ML5238_Batch *b;
+        while (sched.queued(fifo ? 0 : ML5238_CLASS_DIAG) < 2 && (b = pools[ML5238_CLASS_DIAG].get(sim.now_ns()))) {
+            for (uint8_t i = 0; i < ML5238_Batch::MAX_FRAMES; ++i) i & 1 ? b->read(REG_NOOP) : b->write(REG_NOOP, i);
+            sched.submit(*b, fifo ? 0 : ML5238_CLASS_DIAG, release, &pools[ML5238_CLASS_DIAG]);
+        }
+        if (sim.now_ns() >= next_control && (b = pools[ML5238_CLASS_CONTROL].get(next_control))) {
+            b->read(REG_STATUS);
+            b->write(REG_VMON, vmon_select((uint8_t)(x & 15)));
+            b->write(REG_CBALH, 0);
+            b->write(REG_CBALL, 0);
+            sched.submit(*b, fifo ? 0 : ML5238_CLASS_CONTROL, release, &pools[ML5238_CLASS_CONTROL]);
+            next_control += 1000000;
+        }
+        if (sim.now_ns() >= next_protect && (b = pools[ML5238_CLASS_PROTECT].get(next_protect))) {
+            b->write(REG_FET, 0);
+            b->read(REG_STATUS);
+            b->read(REG_RSENSE);
+            sched.submit(*b, fifo ? 0 : ML5238_CLASS_PROTECT, release, &pools[ML5238_CLASS_PROTECT]);
+            x = x * 1664525 + 1013904223;
+            next_protect += 1000000 + (x >> 12) % 9000000;
+        }
+        if (!sched.step()) sim.advance(1000);
+    }
+
+    printf("%s, %u frame bursts\n", fifo ? "one FIFO" : "scheduler", fifo ? ML5238_Batch::MAX_FRAMES : burst);
+    printf("  %-8s %8s %10s %10s %12s %12s\n", "traffic", "jobs", "frames/s", "bus share", "lat avg us", "lat max us");
+    for (uint8_t c = 0; c < ML5238_CLASS_COUNT; ++c) {
+        const Pool &p = pools[c];
+        const ML5238_ClassStats &s = sched.stats(c);
+        char share[16] = "-";
+        if (!fifo) snprintf(share, sizeof(share), "%.1f%%", 100.0 * s.bus_us / (seconds * 1e6));
+        printf("  %-8s %8u %10.0f %10s %12.0f %12.0f\n", NAMES[c], p.jobs, p.frames / seconds, share,
+               p.jobs ? p.lat_sum_us / p.jobs : 0.0, p.lat_max_us);
+    }
+    if (!fifo) {
+        // One lower class burst plus the protection job itself, at the frame time of the bus
+        const double frame_us = 16.0 + 0.5;
+        printf("  protect bound: (%u + 3) frames = %.0f us of bus time\n", burst, (burst + 3) * frame_us);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    const double seconds = argc > 1 ? atof(argv[1]) : 10.0;
+    const uint8_t burst = argc > 2 ? (uint8_t)atoi(argv[2]) : 8;
+    run(seconds, burst, true);
+    run(seconds, burst, false);
+    return 0;
+}
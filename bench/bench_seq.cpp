@@ -0,0 +1,121 @@
+// Measurement cycle as a descriptor chain: CPU involvement per cycle with tick() against the
+// chain on the software DMA engine, agreement of the results and the driver's cost per cycle.
+// g++ -O2 -std=c++11 bench_seq.cpp ../sim/ML5238_sim.cpp ../sim/ML5238_softdma.cpp ../*.cpp -o bench_seq
+// ./bench_seq [cycles]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../sim/ML5238_sim.h"
+#include "../sim/ML5238_softdma.h"
+#include "ML5238_profiles.h"
+
+using namespace drivers;
+
+// Counts what would wake the CPU when the driver does the work itself
+class CountingPort : public ML5238_Port {
+public:
+    explicit CountingPort(ML5238_Sim &sim) : sim(sim), transfers(0), frames(0), samples(0), waits(0) {}
+
+    void transfer(const uint8_t *tx, uint8_t *rx, uint8_t n) override {
+        ++transfers;
+        frames += n;
+        sim.transfer(tx, rx, n);
+    }
+    uint16_t vmon_mV() override { ++samples; return sim.vmon_mV(); }
+    uint16_t imon_mV() override { ++samples; return sim.imon_mV(); }
+    uint32_t micros() override { return sim.micros(); }
+    void delay_us(uint32_t us) override { ++waits; sim.delay_us(us); }
+
+    uint32_t events() const { return transfers + samples + waits; }
+
+    ML5238_Sim &sim;
+    uint32_t transfers;
+    uint32_t frames;
+    uint32_t samples;
+    uint32_t waits;
+};
+
+struct Rig {
+    Rig() : sim(pack, ML5238_BenchSimConfig()), port(sim), bms(port) {
+        for (uint8_t i = 0; i < pack.cells(); ++i) pack.cell(i).soc = 0.8 + 0.01 * ((i * 7) % 5);
+        bms.begin(ML5238_BenchConfig());
+        bms.set_fets(true, true);
+        sim.set_charger(true);
+        sim.set_load(5.0);
+    }
+
+    ML5238_Pack pack{ 16 };
+    ML5238_Sim sim;
+    CountingPort port;
+    ML5238 bms;
+};
+
+static void on_done(void *ctx) { ++*(uint32_t *)ctx; }
+
+int main(int argc, char **argv) {
+    const uint32_t cycles = argc > 1 ? (uint32_t)atol(argv[1]) : 10000;
+    const uint64_t period_ns = 100000000;
+
+    // Driver does every step
+    Rig a;
+    CountingPort &pa = a.port;
+    const uint32_t ev0 = pa.events(), fr0 = pa.frames, tr0 = pa.transfers;
+    uint64_t busy_a = 0;
+    for (uint32_t i = 0; i < cycles; ++i) {
+        const uint64_t t0 = a.sim.now_ns();
+        a.bms.tick();
+        busy_a += a.sim.now_ns() - t0;
+        a.sim.advance(period_ns - (a.sim.now_ns() - t0));
+    }
+
+    // Compiled once, run by the engine, the CPU sees the completion only
+    Rig b;
+    CountingPort &pb = b.port;
+    ML5238_SoftDma dma(pb);
+    ML5238_Chain chain;
+    b.bms.compile_cycle(chain);
+    const uint32_t ev1 = pb.events(), fr1 = pb.frames, tr1 = pb.transfers;
+    uint32_t notified = 0, balancing = 0;
+    uint64_t busy_b = 0;
+    double finish_s = 0.0;
+    for (uint32_t i = 0; i < cycles; ++i) {
+        const uint64_t t0 = b.sim.now_ns();
+        b.bms.start_cycle(dma, chain, on_done, &notified);
+        while (dma.service()) {
+            const int32_t left = (int32_t)(dma.due_us() - b.sim.micros());
+            if (left > 0) b.sim.advance((uint64_t)left * 1000);
+        }
+        busy_b += b.sim.now_ns() - t0;
+        const clock_t c0 = clock();
+        b.bms.finish_cycle(chain);
+        finish_s += (double)(clock() - c0) / CLOCKS_PER_SEC;
+        if (b.bms.state().balance) ++balancing;
+        b.sim.advance(period_ns - (b.sim.now_ns() - t0));
+    }
+    // Port calls the engine did not make are the driver's own writes after the cycle
+    const uint32_t cpu_b = pb.events() - ev1 - dma.bursts() - dma.samples();
+
+    printf("%u cycles of 16 cells, %u descriptors per chain, balancing in %u\n\n", cycles, chain.size(), balancing);
+    printf("%-26s %14s %14s\n", "", "tick()", "chain + DMA");
+    printf("%-26s %14.1f %14.1f\n", "CPU wakes per cycle", (double)(pa.events() - ev0) / cycles,
+           (double)(cpu_b + notified) / cycles);
+    printf("%-26s %14.1f %14.1f\n", "engine steps per cycle", 0.0, (double)dma.services() / cycles);
+    printf("%-26s %14.1f %14.1f\n", "SPI frames per cycle", (double)(pa.frames - fr0) / cycles,
+           (double)(pb.frames - fr1) / cycles);
+    printf("%-26s %14.1f %14.1f\n", "port transfers per cycle", (double)(pa.transfers - tr0) / cycles,
+           (double)(pb.transfers - tr1) / cycles);
+    printf("%-26s %14.2f %14.2f\n", "cycle time, ms", busy_a * 1e-6 / cycles, busy_b * 1e-6 / cycles);
+    printf("%-26s %14s %14.2f\n", "finish_cycle(), us", "", finish_s * 1e6 / cycles);
+    printf("%-26s %14u %14u\n", "notifications", 0u, notified);
+
+    int max_diff = 0;
+    for (uint8_t i = 0; i < 16; ++i) {
+        const int d = (int)a.bms.state().cell_mV[i] - (int)b.bms.state().cell_mV[i];
+        if (abs(d) > max_diff) max_diff = abs(d);
+    }
+    printf("\nresults: cells differ by up to %d mV, SOC %u vs %u permille, balance %04X vs %04X, "
+           "violations %u/%u\n", max_diff, a.bms.state().soc_permille, b.bms.state().soc_permille,
+           a.bms.state().balance, b.bms.state().balance, a.sim.violations(), b.sim.violations());
+    return 0;
+}
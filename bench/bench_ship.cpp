@@ -0,0 +1,143 @@
+// Ship mode through PDWN: refusals with a charger or /PUPIN, a stored pack woken by the charger
+// after storage, the boot time and SOC of resume() against a cold begin(), and random trials
+// that must never break a PDWN rule. Supply current per power state for reference.
+// g++ -O2 -std=c++11 bench_ship.cpp ../sim/ML5238_sim.cpp ../*.cpp -o bench_ship
+// ./bench_ship [trials]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../ML5238_ship.h"
+#include "../sim/ML5238_sim.h"
+#include "ML5238_profiles.h"
+
+using namespace drivers;
+
+// RAM standing in for a flash page
+class MemStore : public ML5238_Store {
+public:
+    MemStore() : writes(0), size(0) { memset(data, 0xFF, sizeof(data)); }
+    bool save(const uint8_t *d, uint16_t n) override {
+        if (n > sizeof(data)) return false;
+        memcpy(data, d, n);
+        size = n;
+        ++writes;
+        return true;
+    }
+    bool load(uint8_t *d, uint16_t n) override {
+        if (n > size) return false;
+        memcpy(d, data, n);
+        return true;
+    }
+
+    uint8_t data[64];
+    uint32_t writes;
+    uint16_t size;
+};
+
+struct Rig {
+    Rig(double soc) : sim(pack, ML5238_BenchSimConfig()), bms(sim) {
+        for (uint8_t i = 0; i < pack.cells(); ++i) pack.cell(i).soc = soc;
+        bms.begin(ML5238_BenchConfig());
+        bms.set_fets(true, true);
+        bms.tick();
+    }
+    double true_soc() const {
+        double s = 0.0;
+        for (uint8_t i = 0; i < pack.cells(); ++i) s += pack.cell(i).soc;
+        return s / pack.cells();
+    }
+
+    ML5238_Pack pack{ 16 };
+    ML5238_Sim sim;
+    ML5238 bms;
+};
+
+static const char *name(uint8_t code) {
+    static const char *names[] = { "OK", "FET", "CHARGER", "PUPIN", "STORE", "REFUSED" };
+    return code < sizeof(names) / sizeof(names[0]) ? names[code] : "?";
+}
+
+// Discharges for a while so the charge count has something OCV cannot see, then ships
+static void storage(double soc, double days) {
+    Rig r(soc);
+    MemStore store;
+    ML5238_Ship ship(r.bms, r.sim, store);
+    r.sim.set_load(-20.0);
+    for (int i = 0; i < 600; ++i) {
+        r.bms.tick();
+        r.sim.advance(100000000);
+    }
+    r.sim.set_load(0.0);
+    r.bms.tick();
+    const double before = r.true_soc();
+    const uint8_t code = ship.enter(true, true);
+    const bool down = r.sim.powered_down();
+    r.sim.advance((uint64_t)(days * 86400.0 * 1e9));
+    r.sim.set_charger(true);
+
+    // MCU reset: a fresh driver object, once resumed and once cold for comparison
+    ML5238 warm(r.sim);
+    ML5238_Ship boot(warm, r.sim, store);
+    const uint8_t reason = boot.resume(ML5238_BenchConfig());
+    warm.tick();
+    const double warm_err = 100.0 * (warm.state().soc_permille * 1e-3 - r.true_soc());
+    ML5238 cold(r.sim);
+    const uint64_t t0 = r.sim.now_ns();
+    cold.begin(ML5238_BenchConfig());
+    const double cold_us = (double)(r.sim.now_ns() - t0) * 1e-3;
+    cold.tick();
+    const double cold_err = 100.0 * (cold.state().soc_permille * 1e-3 - r.true_soc());
+    printf("%5.0f%% %5.0f d  %-8s %-5s %-7s %6.2f %6u %9.2f %7.0f %9.2f\n", 100.0 * before, days, name(code),
+           down ? "yes" : "no", reason == ML5238_WAKE_CHARGER ? "charger" : reason == ML5238_WAKE_PUPIN ? "pupin" : "cold",
+           (double)r.sim.pdwn_ns() * 1e-9 / 86400.0, boot.resume_us(), warm_err, cold_us, cold_err);
+}
+
+int main(int argc, char **argv) {
+    const uint32_t trials = argc > 1 ? (uint32_t)atoi(argv[1]) : 2000;
+
+    printf("IDD normal %u uA, PSV %u uA, PDWN %u nA\n\n", ml5238::IDD_NORMAL_UA, ml5238::IDD_PSV_UA,
+           ml5238::IDD_PDWN_NA);
+
+    {
+        Rig r(0.5);
+        MemStore store;
+        ML5238_Ship ship(r.bms, r.sim, store);
+        r.sim.set_charger(true);
+        const uint8_t charger = ship.enter(true, true);
+        const bool fets_back = (r.sim.peek(ml5238::REG_FET) & (ml5238::FET_CF | ml5238::FET_DF)) ==
+                               (ml5238::FET_CF | ml5238::FET_DF);
+        r.sim.set_charger(false);
+        r.sim.set_pupin(true);
+        const uint8_t pupin = ship.enter(true, false);
+        r.sim.set_pupin(false);
+        printf("charger connected: %s, FETs back %s; /PUPIN low: %s; store writes %u, down %s\n\n", name(charger),
+               fets_back ? "yes" : "no", name(pupin), store.writes, r.sim.powered_down() ? "yes" : "no");
+    }
+
+    printf("%6s %7s  %-8s %-5s %-7s %6s %6s %9s %7s %9s\n", "SOC", "stored", "enter", "down", "wake", "PDWN d",
+           "res us", "SOC err", "cold us", "SOC err");
+    storage(0.8, 30);
+    storage(0.5, 90);
+    storage(0.3, 365);
+
+    // Random conditions at entry: charger, /PUPIN, FETs wanted. OK must mean powered down, any
+    // refusal must leave the chip up with no PDWN rule broken.
+    srand(1);
+    uint32_t ok = 0, refused = 0, mismatch = 0, violations = 0;
+    for (uint32_t i = 0; i < trials; ++i) {
+        Rig r(0.2 + 0.6 * rand() / RAND_MAX);
+        MemStore store;
+        ML5238_Ship ship(r.bms, r.sim, store);
+        if (rand() % 3 == 0) r.sim.set_charger(true);
+        if (rand() % 4 == 0) r.sim.set_pupin(true);
+        const uint8_t code = ship.enter(rand() & 1, rand() & 1);
+        if (code == ML5238_SHIP_OK) ++ok;
+        else ++refused;
+        if ((code == ML5238_SHIP_OK) != r.sim.powered_down()) ++mismatch;
+        violations += r.sim.violations();
+    }
+    printf("\n%u trials: %u shipped, %u refused, %u state mismatches, %u violations\n", trials, ok, refused, mismatch,
+           violations);
+    return 0;
+}
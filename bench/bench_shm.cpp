@@ -0,0 +1,99 @@
+// Cost of getting the latest snapshot into another process: shared memory seqlock read versus
+// a request and reply over a Unix socket. The owner ticks the simulated pack meanwhile.
+// g++ -O2 -std=c++11 -pthread bench_shm.cpp ../host/ML5238_shm.cpp ../host/ML5238_rt.cpp ../host/ML5238_owner.cpp ../sim/ML5238_sim.cpp ../*.cpp -lrt -o bench_shm
+// ./bench_shm [reads] [tick_us]
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../host/ML5238_shm.h"
+#include "../sim/ML5238_sim.h"
+#include "ML5238_profiles.h"
+
+using namespace drivers;
+
+typedef std::chrono::steady_clock Clock;
+
+static const char *NAME = "/ml5238_bench";
+
+static double ns_since(Clock::time_point t0, unsigned n) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / n;
+}
+
+int main(int argc, char **argv) {
+    const unsigned reads = argc > 1 ? (unsigned)atoi(argv[1]) : 2000000;
+    const uint32_t tick_us = argc > 2 ? (uint32_t)atoi(argv[2]) : 1000;
+
+    ML5238_Pack pack(16);
+    ML5238_Sim sim(pack, ML5238_BenchSimConfig());
+    ML5238 bms(sim);
+    bms.begin(ML5238_BenchConfig());
+    ML5238_ShmWriter shm;
+    if (!shm.open(NAME)) {
+        perror("shm_open");
+        return 1;
+    }
+    ML5238_Owner owner(bms, tick_us);
+    owner.mirror(&shm);
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) != 0) {
+        perror("socketpair");
+        return 1;
+    }
+
+    const pid_t pid = fork();
+    if (pid == 0) {
+        // Consumer process
+        close(sv[0]);
+        ML5238_ShmReader rd;
+        if (!rd.open(NAME)) _exit(1);
+        ML5238_Snapshot s;
+        unsigned failed = 0, changed = 0;
+        uint32_t seq = 0;
+        Clock::time_point t0 = Clock::now();
+        for (unsigned i = 0; i < reads; ++i) {
+            if (!rd.read(s)) ++failed;
+            if (rd.sequence() != seq) {
+                seq = rd.sequence();
+                ++changed;
+            }
+        }
+        const double shm_ns = ns_since(t0, reads);
+
+        const unsigned requests = reads / 200;
+        char req = 0;
+        t0 = Clock::now();
+        for (unsigned i = 0; i < requests; ++i) {
+            if (write(sv[1], &req, 1) != 1 || read(sv[1], &s, sizeof(s)) != (ssize_t)sizeof(s)) _exit(1);
+        }
+        const double sock_ns = ns_since(t0, requests);
+        close(sv[1]);
+
+        printf("%-10s %12s %10s\n", "path", "ns/read", "failed");
+        printf("%-10s %12.0f %10u\n", "shm", shm_ns, failed);
+        printf("%-10s %12.0f %10s\n", "socket", sock_ns, "-");
+        printf("\n%u snapshot updates seen, cell 0 %u mV\n", changed, s.state.cell_mV[0]);
+        fflush(stdout);
+        _exit(0);
+    }
+
+    // Socket server answering from the in-process snapshot
+    close(sv[1]);
+    owner.start();
+    char req;
+    ML5238_Snapshot s;
+    while (read(sv[0], &req, 1) == 1) {
+        owner.snapshot(s);
+        if (write(sv[0], &s, sizeof(s)) != (ssize_t)sizeof(s)) break;
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    owner.stop();
+    shm.close();
+    ML5238_ShmWriter::unlink(NAME);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
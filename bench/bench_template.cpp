@@ -0,0 +1,166 @@
+// Per tick bus traffic as a compiled batch patched in place, against frame by frame access and a
+// batch rebuilt every tick. The port only copies the frames, so the numbers are driver CPU time.
+// g++ -O2 -std=c++11 bench_template.cpp ../*.cpp -o bench_template
+// ./bench_template [ticks]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../ML5238.h"
+#include "../ML5238_guard.h"
+
+using namespace drivers;
+using namespace drivers::ml5238;
+
+class NullPort : public ML5238_Port {
+public:
+    NullPort() : calls(0), us(0) {}
+    void transfer(const uint8_t *tx, uint8_t *rx, uint8_t frames) override {
+        // Byte by byte, like feeding the SPI data register
+        ++calls;
+        for (uint8_t i = 0; i < 2 * frames; ++i) buf[i] = tx[i];
+        if (rx)
+            for (uint8_t i = 0; i < 2 * frames; ++i) rx[i] = buf[i] ^ tx[i];
+    }
+    uint16_t vmon_mV() override { return 1850; }
+    uint16_t imon_mV() override { return 1000; }
+    uint32_t micros() override { return us += 10; }
+    void delay_us(uint32_t t) override { us += t; }
+
+    uint32_t calls;
+    uint32_t us;
+    uint8_t buf[2 * ML5238_Batch::MAX_FRAMES];
+};
+
+// STATUS, FET, balancing off, cell select, PSENSE, POWER, balancing back on
+static const uint8_t FRAMES = 9;
+
+static uint16_t bal_of(uint32_t t) { return (t >> 4) & 1 ? 0x1248 : 0x0491; }
+
+static double per_frame(ML5238 &bms, uint32_t ticks) {
+    const clock_t c0 = clock();
+    for (uint32_t t = 0; t < ticks; ++t) {
+        const uint16_t bal = bal_of(t);
+        bms.read(REG_STATUS);
+        bms.write(REG_FET, FET_CF | FET_DF);
+        bms.write(REG_CBALH, 0);
+        bms.write(REG_CBALL, 0);
+        bms.write(REG_VMON, vmon_select((uint8_t)(t & 15)));
+        bms.read(REG_PSENSE);
+        bms.read(REG_POWER);
+        bms.write(REG_CBALH, balance_h(bal));
+        bms.write(REG_CBALL, balance_l(bal));
+    }
+    return (double)(clock() - c0) / CLOCKS_PER_SEC * 1e9 / ticks;
+}
+
+static void build(ML5238_Batch &b, uint32_t t) {
+    const uint16_t bal = bal_of(t);
+    b.clear();
+    b.read(REG_STATUS);
+    b.write(REG_FET, FET_CF | FET_DF);
+    b.write(REG_CBALH, 0);
+    b.write(REG_CBALL, 0);
+    b.write(REG_VMON, vmon_select((uint8_t)(t & 15)));
+    b.read(REG_PSENSE);
+    b.read(REG_POWER);
+    b.write(REG_CBALH, balance_h(bal));
+    b.write(REG_CBALL, balance_l(bal));
+}
+
+static double rebuilt(ML5238 &bms, uint32_t ticks) {
+    ML5238_Batch b;
+    const clock_t c0 = clock();
+    for (uint32_t t = 0; t < ticks; ++t) {
+        build(b, t);
+        bms.run(b);
+    }
+    return (double)(clock() - c0) / CLOCKS_PER_SEC * 1e9 / ticks;
+}
+
+static double compiled(ML5238 &bms, uint32_t ticks) {
+    ML5238_Batch b;
+    build(b, 0);
+    b.compile();
+    const clock_t c0 = clock();
+    for (uint32_t t = 0; t < ticks; ++t) {
+        const uint16_t bal = bal_of(t);
+        b.set_data(4, vmon_select((uint8_t)(t & 15)));
+        b.set_data(7, balance_h(bal));
+        b.set_data(8, balance_l(bal));
+        bms.run(b);
+    }
+    return (double)(clock() - c0) / CLOCKS_PER_SEC * 1e9 / ticks;
+}
+
+// Cell select and current monitor only: no register with a guard rule, the guard is skipped
+static double compiled_free(ML5238 &bms, uint32_t ticks) {
+    ML5238_Batch b;
+    b.read(REG_STATUS);
+    b.write(REG_VMON, 0);
+    b.write(REG_IMON, IMON_OUT);
+    b.read(REG_PSENSE);
+    b.compile();
+    const clock_t c0 = clock();
+    for (uint32_t t = 0; t < ticks; ++t) {
+        b.set_data(1, vmon_select((uint8_t)(t & 15)));
+        bms.run(b);
+    }
+    return (double)(clock() - c0) / CLOCKS_PER_SEC * 1e9 / ticks;
+}
+
+static double rebuilt_free(ML5238 &bms, uint32_t ticks) {
+    ML5238_Batch b;
+    const clock_t c0 = clock();
+    for (uint32_t t = 0; t < ticks; ++t) {
+        b.clear();
+        b.read(REG_STATUS);
+        b.write(REG_VMON, vmon_select((uint8_t)(t & 15)));
+        b.write(REG_IMON, IMON_OUT);
+        b.read(REG_PSENSE);
+        bms.run(b);
+    }
+    return (double)(clock() - c0) / CLOCKS_PER_SEC * 1e9 / ticks;
+}
+
+// memcpy of the frames plus one port call
+static double floor_cost(NullPort &port, uint8_t frames, uint32_t ticks) {
+    uint8_t src[2 * ML5238_Batch::MAX_FRAMES], tx[2 * ML5238_Batch::MAX_FRAMES], rx[2 * ML5238_Batch::MAX_FRAMES];
+    memset(src, 0, sizeof(src));
+    ML5238_Port &p = port;
+    const clock_t c0 = clock();
+    for (uint32_t t = 0; t < ticks; ++t) {
+        src[1] = (uint8_t)t;
+        memcpy(tx, src, 2 * frames);
+        p.transfer(tx, rx, frames);
+    }
+    return (double)(clock() - c0) / CLOCKS_PER_SEC * 1e9 / ticks;
+}
+
+typedef double (*Run)(ML5238 &, uint32_t);
+
+static double measure(Run run, bool guarded, uint32_t ticks) {
+    NullPort port;
+    ML5238 bms(port);
+    ML5238_Guard guard;
+    if (guarded) bms.set_guard(&guard);
+    return run(bms, ticks);
+}
+
+int main(int argc, char **argv) {
+    const uint32_t ticks = argc > 1 ? (uint32_t)atol(argv[1]) : 5000000;
+
+    // 9 frames include FET and CBAL writes the guard checks, the 4 frames touch no guarded register
+    printf("%-22s %10s %10s %10s %10s\n", "ns per tick", "9 frames", "+ guard", "4 frames", "+ guard");
+    printf("%-22s %10.1f %10.1f %10s %10s\n", "read()/write()", measure(per_frame, false, ticks),
+           measure(per_frame, true, ticks), "", "");
+    printf("%-22s %10.1f %10.1f %10.1f %10.1f\n", "batch rebuilt", measure(rebuilt, false, ticks),
+           measure(rebuilt, true, ticks), measure(rebuilt_free, false, ticks), measure(rebuilt_free, true, ticks));
+    printf("%-22s %10.1f %10.1f %10.1f %10.1f\n", "compiled + patched", measure(compiled, false, ticks),
+           measure(compiled, true, ticks), measure(compiled_free, false, ticks), measure(compiled_free, true, ticks));
+    NullPort port;
+    printf("%-22s %10.1f %10s %10.1f %10s\n", "memcpy + transfer", floor_cost(port, FRAMES, ticks), "",
+           floor_cost(port, 4, ticks), "");
+    return 0;
+}
@@ -0,0 +1,106 @@
+// Wakes of four independent periodic timers in power save: comparator re-arm, link health,
+// telemetry flush and a register check, each waking on its own against the same timers with
+// slack coalesced into shared wakes and bursts. Wakes and bursts per hour, time out of PSV and
+// the worst lateness of each timer against its slack.
+// g++ -O2 -std=c++11 bench_timer.cpp ../sim/ML5238_sim.cpp ../*.cpp -o bench_timer
+// ./bench_timer [hours]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../ML5238_timer.h"
+#include "../sim/ML5238_sim.h"
+#include "ML5238_profiles.h"
+
+using namespace drivers;
+using namespace drivers::ml5238;
+
+struct Counts {
+    uint32_t flushed;
+    uint32_t link_errors;
+};
+
+static void rearm(ML5238_Batch &b, void *) { b.write(REG_RSENSE, RSENSE_ESC | RSENSE_ISC); }
+
+static void link(ML5238_Batch &b, void *) {
+    b.read(REG_STATUS);
+    b.read(REG_POWER);
+}
+
+static void link_done(const ML5238_Batch &b, uint8_t first, bool ok, void *ctx) {
+    // PSV was left for the wake, POWER must read back without it
+    if (!ok || (b.result((uint8_t)(first + 1)) & POWER_PSV)) ++((Counts *)ctx)->link_errors;
+}
+
+static void telemetry(ML5238_Batch &, void *ctx) { ++((Counts *)ctx)->flushed; }
+
+static void check(ML5238_Batch &b, void *) {
+    b.read(REG_SETSC);
+    b.read(REG_IMON);
+    b.read(REG_RSENSE);
+}
+
+struct Spec {
+    ML5238_TimerFn run;
+    ML5238_TimerDone done;
+    const char *name;
+    uint32_t period_ms;
+    uint32_t slack_ms;
+    uint8_t frames;
+    uint32_t phase_ms;
+};
+
+static const Spec SPECS[] = {
+    { rearm, nullptr, "re-arm", 2000, 500, 1, 300 },
+    { link, link_done, "link", 3000, 1500, 2, 1100 },
+    { telemetry, nullptr, "telemetry", 10000, 5000, 0, 2700 },
+    { check, nullptr, "check", 30000, 15000, 3, 7900 },
+};
+static const uint8_t N = sizeof(SPECS) / sizeof(SPECS[0]);
+
+static void run(double hours, bool coalesce) {
+    ML5238_Pack pack(16);
+    ML5238_Sim sim(pack, ML5238_BenchSimConfig());
+    ML5238 bms(sim);
+    bms.begin(ML5238_BenchConfig());
+    Counts counts = Counts();
+    ML5238_Timers timers(bms, sim);
+    for (uint8_t i = 0; i < N; ++i) {
+        ML5238_Timer t;
+        t.run = SPECS[i].run;
+        t.done = SPECS[i].done;
+        t.ctx = &counts;
+        t.name = SPECS[i].name;
+        t.period_ms = SPECS[i].period_ms;
+        t.slack_ms = coalesce ? SPECS[i].slack_ms : 0;
+        t.frames = SPECS[i].frames;
+        timers.start((uint8_t)timers.add(t), SPECS[i].phase_ms);
+    }
+    timers.set_power_save(true);
+    const uint64_t start = sim.now_ns(), end = start + (uint64_t)(hours * 3.6e12);
+    while (sim.now_ns() < end) {
+        const int32_t sleep = (int32_t)(timers.due_us() - sim.micros());
+        if (sleep > 0) sim.advance((uint64_t)sleep * 1000);
+        timers.service(sim.micros());
+    }
+    const double h = (double)(sim.now_ns() - start) / 3.6e12;
+    printf("%-10s %9.0f %9.0f %10.1f %8u", coalesce ? "coalesced" : "separate", timers.wakes() / h,
+           timers.bursts() / h, (double)timers.awake_us() * 1e-3 / h, counts.link_errors);
+    for (uint8_t i = 0; i < N; ++i)
+        printf(" %6.0f/%-6u", timers.stats(i).late_max_us * 1e-3, coalesce ? SPECS[i].slack_ms : 0);
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    const double hours = argc > 1 ? atof(argv[1]) : 4.0;
+    printf("%.0f h, timers:", hours);
+    for (uint8_t i = 0; i < N; ++i)
+        printf(" %s %u ms (%u frames)%s", SPECS[i].name, SPECS[i].period_ms, SPECS[i].frames, i + 1 < N ? "," : "\n\n");
+    printf("%-10s %9s %9s %10s %8s", "", "wakes/h", "bursts/h", "awake ms/h", "link err");
+    for (uint8_t i = 0; i < N; ++i) printf(" %13s", SPECS[i].name);
+    printf("\n%-10s %9s %9s %10s %8s", "", "", "", "", "");
+    for (uint8_t i = 0; i < N; ++i) printf(" %13s", "late/slack ms");
+    printf("\n");
+    run(hours, false);
+    run(hours, true);
+    return 0;
+}
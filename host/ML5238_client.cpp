@@ -0,0 +1,82 @@
+#include "ML5238_client.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace drivers {
+
+bool ML5238_Client::connect(const char *path) {
+    close();
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) return false;
+    strcpy(addr.sun_path, path);
+    _fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (_fd < 0) return false;
+    if (::connect(_fd, (const sockaddr *)&addr, sizeof(addr)) != 0) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ML5238_Client::close() {
+    if (_fd >= 0) ::close(_fd);
+    _fd = -1;
+}
+
+bool ML5238_Client::send(const ML5238_MsgCommand *cmds, uint8_t n, uint16_t *id) {
+    if (n > ML5238_MSG_MAX_COMMANDS) return false;
+    uint8_t buf[sizeof(ML5238_MsgHeader) + ML5238_MSG_MAX_COMMANDS * sizeof(ML5238_MsgCommand)];
+    ML5238_MsgHeader hdr;
+    hdr.id = _id++;
+    hdr.count = n;
+    hdr.flags = 0;
+    memcpy(buf, &hdr, sizeof(hdr));
+    memcpy(buf + sizeof(hdr), cmds, n * sizeof(ML5238_MsgCommand));
+    if (id) *id = hdr.id;
+    return write_all(buf, sizeof(hdr) + n * sizeof(ML5238_MsgCommand));
+}
+
+bool ML5238_Client::receive(ML5238_MsgHeader &hdr, ML5238_MsgResult *results) {
+    return read_all(&hdr, sizeof(hdr)) && read_all(results, hdr.count * sizeof(ML5238_MsgResult));
+}
+
+bool ML5238_Client::call(const ML5238_MsgCommand *cmds, uint8_t n, ML5238_MsgResult *results) {
+    uint16_t id;
+    ML5238_MsgHeader hdr;
+    return send(cmds, n, &id) && receive(hdr, results) && hdr.id == id;
+}
+
+bool ML5238_Client::read_all(void *buf, size_t len) {
+    uint8_t *p = static_cast<uint8_t *>(buf);
+    while (len) {
+        const ssize_t r = recv(_fd, p, len, 0);
+        if (r <= 0) {
+            if (r < 0 && errno == EINTR) continue;
+            return false;
+        }
+        p += r;
+        len -= (size_t)r;
+    }
+    return true;
+}
+
+bool ML5238_Client::write_all(const void *buf, size_t len) {
+    const uint8_t *p = static_cast<const uint8_t *>(buf);
+    while (len) {
+        const ssize_t r = ::send(_fd, p, len, MSG_NOSIGNAL);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += r;
+        len -= (size_t)r;
+    }
+    return true;
+}
+
+}  // namespace drivers
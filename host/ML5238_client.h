@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ML5238_proto.h"
+
+namespace drivers {
+
+// Blocking client of the ML5238_Server. send() and receive() may be interleaved to keep
+// several requests in flight, replies arrive in request order.
+class ML5238_Client {
+public:
+    ML5238_Client() : _fd(-1), _id(0) {}
+    ~ML5238_Client() { close(); }
+
+    bool connect(const char *path);
+    void close();
+
+    // Queues one request of up to ML5238_MSG_MAX_COMMANDS, returns its id through id
+    bool send(const ML5238_MsgCommand *cmds, uint8_t n, uint16_t *id = nullptr);
+    // Next reply, results must hold hdr.count entries (ML5238_MSG_MAX_COMMANDS is enough)
+    bool receive(ML5238_MsgHeader &hdr, ML5238_MsgResult *results);
+    // One request and its reply
+    bool call(const ML5238_MsgCommand *cmds, uint8_t n, ML5238_MsgResult *results);
+
+private:
+    bool read_all(void *buf, size_t len);
+    bool write_all(const void *buf, size_t len);
+
+    int _fd;
+    uint16_t _id;
+};
+
+}  // namespace drivers
@@ -0,0 +1,201 @@
+#include "ML5238_fleet.h"
+#include "ML5238_rt.h"
+#include <dirent.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace drivers {
+
+void ML5238_Topology::parse_cpulist(const char *s, std::vector<int> &out) {
+    char *e;
+    while (*s >= '0' && *s <= '9') {
+        const long a = strtol(s, &e, 10);
+        const long b = *e == '-' ? strtol(e + 1, &e, 10) : a;
+        for (long c = a; c <= b; ++c) out.push_back((int)c);
+        s = *e == ',' ? e + 1 : e;
+    }
+}
+
+bool ML5238_Topology::load(const char *root) {
+    _nodes.clear();
+    DIR *d = opendir(root);
+    if (d) {
+        while (dirent *de = readdir(d)) {
+            int id;
+            char tail;
+            if (sscanf(de->d_name, "node%d%c", &id, &tail) != 1) continue;
+            char path[256], buf[1024];
+            snprintf(path, sizeof(path), "%s/node%d/cpulist", root, id);
+            FILE *f = fopen(path, "r");
+            if (!f) continue;
+            Node n;
+            n.id = id;
+            if (fgets(buf, sizeof(buf), f)) parse_cpulist(buf, n.cpus);
+            fclose(f);
+            // Memory only nodes get no workers
+            if (!n.cpus.empty()) _nodes.push_back(n);
+        }
+        closedir(d);
+    }
+    for (size_t i = 1; i < _nodes.size(); ++i)
+        for (size_t j = i; j > 0 && _nodes[j].id < _nodes[j - 1].id; --j) std::swap(_nodes[j], _nodes[j - 1]);
+    if (!_nodes.empty()) return true;
+    split(1);
+    return false;
+}
+
+void ML5238_Topology::split(unsigned n) {
+    std::vector<int> all;
+    for (const Node &node : _nodes) all.insert(all.end(), node.cpus.begin(), node.cpus.end());
+    if (all.empty()) {
+        const long c = sysconf(_SC_NPROCESSORS_ONLN);
+        for (long i = 0; i < (c > 0 ? c : 1); ++i) all.push_back((int)i);
+    }
+    if (!n) n = 1;
+    if (n > all.size()) n = (unsigned)all.size();
+    _nodes.assign(n, Node());
+    for (unsigned i = 0; i < n; ++i) _nodes[i].id = (int)i;
+    // Contiguous runs, like sockets
+    for (size_t i = 0; i < all.size(); ++i) _nodes[i * n / all.size()].cpus.push_back(all[i]);
+}
+
+void ML5238_Topology::keep(unsigned n) {
+    if (n && n < _nodes.size()) _nodes.resize(n);
+}
+
+unsigned ML5238_Topology::cpus() const {
+    unsigned n = 0;
+    for (const Node &node : _nodes) n += (unsigned)node.cpus.size();
+    return n;
+}
+
+namespace {
+
+ML5238_Module *map_modules(uint32_t n) {
+    if (!n) return nullptr;
+    void *p = mmap(nullptr, (size_t)n * sizeof(ML5238_Module), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                   -1, 0);
+    if (p == MAP_FAILED) return nullptr;
+    // Constructing is the first touch, the pages land on the node of the calling thread
+    ML5238_Module *m = static_cast<ML5238_Module *>(p);
+    for (uint32_t i = 0; i < n; ++i) new (&m[i]) ML5238_Module();
+    return m;
+}
+
+void unmap_modules(ML5238_Module *m, uint32_t n) {
+    if (m) munmap(m, (size_t)n * sizeof(ML5238_Module));
+}
+
+}  // namespace
+
+ML5238_Fleet::ML5238_Fleet(uint32_t modules)
+    : _modules(modules), _block(nullptr), _feed(nullptr), _ctx(nullptr), _running(false) {}
+
+ML5238_Fleet::~ML5238_Fleet() {
+    stop();
+    release();
+}
+
+bool ML5238_Fleet::start(const ML5238_Topology &topo, unsigned workers_per_node, uint8_t placement,
+                         ML5238_FleetFeed feed, void *ctx) {
+    if (_running.load() || !topo.nodes() || !_modules || !feed) return false;
+    release();
+    _feed = feed;
+    _ctx = ctx;
+    const bool local = placement == ML5238_FLEET_LOCAL;
+
+    // Node shares in proportion to CPUs, then even ranges per worker
+    const unsigned cpus = topo.cpus();
+    uint32_t begin = 0, cpus_before = 0;
+    for (unsigned n = 0; n < topo.nodes(); ++n) {
+        const ML5238_Topology::Node &node = topo.node(n);
+        const unsigned c = (unsigned)node.cpus.size();
+        cpus_before += c;
+        const uint32_t end = (uint32_t)((uint64_t)_modules * cpus_before / cpus);
+        const unsigned w = workers_per_node ? workers_per_node : c;
+        for (unsigned i = 0; i < w; ++i) {
+            Part *p = new Part();
+            p->begin = begin + (uint32_t)((uint64_t)(end - begin) * i / w);
+            p->end = begin + (uint32_t)((uint64_t)(end - begin) * (i + 1) / w);
+            p->node = node.id;
+            p->cpu = local ? node.cpus[i % c] : -1;
+            p->mod = nullptr;
+            p->ready = false;
+            p->scans = 0;
+            _parts.push_back(p);
+        }
+        begin = end;
+    }
+    if (!local) {
+        _block = map_modules(_modules);
+        if (!_block) {
+            release();
+            return false;
+        }
+        for (Part *p : _parts) p->mod = _block + p->begin;
+    }
+
+    _running = true;
+    for (Part *p : _parts) p->thread = std::thread(&ML5238_Fleet::work, this, p, local);
+    for (Part *p : _parts)
+        while (!p->ready.load(std::memory_order_acquire)) std::this_thread::yield();
+    for (Part *p : _parts)
+        if (!p->mod && p->end > p->begin) {
+            stop();
+            release();
+            return false;
+        }
+    return true;
+}
+
+void ML5238_Fleet::stop() {
+    if (!_running.exchange(false)) return;
+    for (Part *p : _parts) p->thread.join();
+}
+
+void ML5238_Fleet::release() {
+    if (_block) unmap_modules(_block, _modules);
+    else
+        for (Part *p : _parts) unmap_modules(p->mod, p->end - p->begin);
+    for (Part *p : _parts) delete p;
+    _parts.clear();
+    _block = nullptr;
+}
+
+void ML5238_Fleet::work(Part *p, bool local) {
+    if (local) {
+        ML5238_Rt::apply(ML5238_RtThread(p->cpu, 0, 0));
+        p->mod = map_modules(p->end - p->begin);
+    }
+    p->ready.store(true, std::memory_order_release);
+    if (!p->mod) return;
+    const uint32_t n = p->end - p->begin;
+    while (_running.load(std::memory_order_relaxed)) {
+        for (uint32_t i = 0; i < n; ++i) {
+            ML5238_Module &m = p->mod[i];
+            // Unused inputs read 0, kept out of the median
+            const uint16_t cells = _feed(p->begin + i, m.state, _ctx);
+            m.anomaly.update(m.state, cells);
+            m.flagged = m.anomaly.flagged();
+            ++m.scans;
+        }
+        p->scans.fetch_add(n, std::memory_order_relaxed);
+    }
+}
+
+uint64_t ML5238_Fleet::scans() const {
+    uint64_t n = 0;
+    for (const Part *p : _parts) n += p->scans.load(std::memory_order_relaxed);
+    return n;
+}
+
+const ML5238_Module &ML5238_Fleet::module(uint32_t i) const {
+    for (const Part *p : _parts)
+        if (i >= p->begin && i < p->end && p->mod) return p->mod[i - p->begin];
+    return _parts.front()->mod[0];
+}
+
+}  // namespace drivers
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+#include "../ML5238.h"
+#include "../ML5238_anomaly.h"
+
+namespace drivers {
+
+// What the fleet keeps per module, a cache line multiple so neighbours never share a line
+struct alignas(64) ML5238_Module {
+    ML5238_State state;         // last scan
+    ML5238_Anomaly anomaly;
+    uint32_t scans;
+    uint16_t flagged;
+};
+
+// NUMA nodes and their CPUs from /sys/devices/system/node. Hosts without the node directory
+// read as one node holding every online CPU.
+class ML5238_Topology {
+public:
+    struct Node {
+        int id;
+        std::vector<int> cpus;
+    };
+
+    bool load(const char *root = "/sys/devices/system/node");
+    // n nodes of the online CPUs in turn, to try a layout on a smaller host
+    void split(unsigned n);
+    // Only the first n nodes
+    void keep(unsigned n);
+
+    unsigned nodes() const { return (unsigned)_nodes.size(); }
+    const Node &node(unsigned i) const { return _nodes[i]; }
+    unsigned cpus() const;
+
+    // "0-3,8-11" into CPU numbers
+    static void parse_cpulist(const char *s, std::vector<int> &out);
+
+private:
+    std::vector<Node> _nodes;
+};
+
+// Fills a module's new scan and returns its cell mask (ml5238::cells_mask()), called on the
+// worker of its partition
+typedef uint16_t (*ML5238_FleetFeed)(uint32_t module, ML5238_State &out, void *ctx);
+
+enum : uint8_t {
+    ML5238_FLEET_ANYWHERE,      // one block set up by the caller's thread, workers float
+    ML5238_FLEET_LOCAL,         // per partition blocks first touched by their pinned worker
+};
+
+// Per module processing spread over worker threads. Modules are split across the NUMA nodes in
+// proportion to their CPUs and across the workers of a node in contiguous ranges. In LOCAL
+// placement each worker pins itself to a CPU of its node and builds its range's state there,
+// so the kernel's first touch policy puts the pages on that node; no libnuma needed.
+class ML5238_Fleet {
+public:
+    explicit ML5238_Fleet(uint32_t modules);
+    ~ML5238_Fleet();
+
+    // workers_per_node 0 means one per CPU. False if already running.
+    bool start(const ML5238_Topology &topo, unsigned workers_per_node, uint8_t placement, ML5238_FleetFeed feed,
+               void *ctx);
+    void stop();
+
+    uint32_t modules() const { return _modules; }
+    unsigned workers() const { return (unsigned)_parts.size(); }
+    // Worker w's node, CPU (-1 when floating) and first and last + 1 module
+    int worker_node(unsigned w) const { return _parts[w]->node; }
+    int worker_cpu(unsigned w) const { return _parts[w]->cpu; }
+    uint32_t worker_begin(unsigned w) const { return _parts[w]->begin; }
+    uint32_t worker_end(unsigned w) const { return _parts[w]->end; }
+    uint64_t worker_scans(unsigned w) const { return _parts[w]->scans.load(std::memory_order_relaxed); }
+    uint64_t scans() const;
+    // Valid while running and after stop(); reads race with the owning worker while running
+    const ML5238_Module &module(uint32_t i) const;
+
+private:
+    struct Part {
+        uint32_t begin;
+        uint32_t end;
+        int node;
+        int cpu;
+        ML5238_Module *mod;
+        std::atomic<bool> ready;
+        std::thread thread;
+        std::atomic<uint64_t> scans;
+        uint8_t pad[64];        // keeps the next allocation off the line of scans
+    };
+
+    void work(Part *p, bool local);
+    void release();
+
+    uint32_t _modules;
+    std::vector<Part *> _parts;
+    ML5238_Module *_block;      // ANYWHERE placement
+    ML5238_FleetFeed _feed;
+    void *_ctx;
+    std::atomic<bool> _running;
+};
+
+}  // namespace drivers
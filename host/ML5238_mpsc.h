@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+
+namespace drivers {
+
+// Intrusive lock-free multi producer single consumer queue (Vyukov). T needs a member
+// std::atomic<T *> next and a default constructor. push() is wait-free, pop() belongs to
+// the single consumer and may return null while a push is half way through.
+template <class T>
+class ML5238_Mpsc {
+public:
+    ML5238_Mpsc() : _head(&_stub), _tail(&_stub) { _stub.next.store(nullptr, std::memory_order_relaxed); }
+
+    void push(T *n) {
+        n->next.store(nullptr, std::memory_order_relaxed);
+        T *prev = _head.exchange(n, std::memory_order_acq_rel);
+        prev->next.store(n, std::memory_order_release);
+    }
+
+    // Links first..last in one step, the consumer sees them back to back. Their next
+    // pointers must already chain first to last.
+    void push_chain(T *first, T *last) {
+        last->next.store(nullptr, std::memory_order_relaxed);
+        T *prev = _head.exchange(last, std::memory_order_acq_rel);
+        prev->next.store(first, std::memory_order_release);
+    }
+
+    T *pop() {
+        T *tail = _tail;
+        T *next = tail->next.load(std::memory_order_acquire);
+        if (tail == &_stub) {
+            if (!next) return nullptr;
+            _tail = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next) {
+            _tail = next;
+            return tail;
+        }
+        if (tail != _head.load(std::memory_order_acquire)) return nullptr;
+        push(&_stub);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next) {
+            _tail = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+    bool empty() const {
+        return _tail == &_stub ? _stub.next.load(std::memory_order_acquire) == nullptr : false;
+    }
+
+private:
+    std::atomic<T *> _head;
+    T *_tail;
+    T _stub;
+};
+
+}  // namespace drivers
@@ -0,0 +1,255 @@
+#include "ML5238_owner.h"
+#include "ML5238_shm.h"
+#include <string.h>
+
+namespace drivers {
+
+using namespace ml5238;
+
+namespace {
+
+// Registers whose back to back writes can collapse into the last one
+const uint16_t MERGEABLE = (1U << REG_NOOP) | (1U << REG_VMON) | (1U << REG_IMON) | (1U << REG_FET) |
+                           (1U << REG_CBALH) | (1U << REG_CBALL) | (1U << REG_SETSC);
+
+}  // namespace
+
+ML5238_Owner::ML5238_Owner(ML5238 &bms, uint32_t tick_us)
+    : _bms(bms), _tick(std::chrono::microseconds(tick_us)), _next_tick(Clock::now() + _tick),
+      _ticks(0), _npending(0), _write_frame(-1), _mirror(nullptr), _rt_flags(0), _running(false), _sleeping(false),
+      _commands(0), _bursts(0), _merged(0) {
+    for (uint8_t i = 0; i < REG_COUNT; ++i) _last_write[i] = _last_read[i] = -1;
+    publish();
+}
+
+ML5238_Owner::~ML5238_Owner() {
+    stop();
+}
+
+void ML5238_Owner::start() {
+    if (_running.exchange(true)) return;
+    _thread = std::thread(&ML5238_Owner::loop, this);
+}
+
+void ML5238_Owner::stop() {
+    if (!_running.exchange(false)) return;
+    {
+        std::lock_guard<std::mutex> lk(_mutex);
+        _cv.notify_one();
+    }
+    _thread.join();
+}
+
+void ML5238_Owner::loop() {
+    _rt_flags.store(ML5238_Rt::apply(_rt), std::memory_order_release);
+    while (_running.load(std::memory_order_acquire)) {
+        poll();
+        // Let runnable clients queue more work before paying for a sleep and wakeup
+        std::this_thread::yield();
+        if (!_queue.empty()) continue;
+        std::unique_lock<std::mutex> lk(_mutex);
+        _sleeping.store(true);
+        // Pairs with the fence in submit(): one side sees the other's store, no wakeup is lost
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_queue.empty() && _running.load()) {
+            if (_tick.count()) _cv.wait_until(lk, _next_tick);
+            else _cv.wait(lk);
+        }
+        _sleeping.store(false);
+    }
+    poll();
+}
+
+void ML5238_Owner::submit(ML5238_Command &c) {
+    c.done.store(false, std::memory_order_relaxed);
+    _queue.push(&c);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_sleeping.load()) {
+        std::lock_guard<std::mutex> lk(_mutex);
+        _cv.notify_one();
+    }
+}
+
+void ML5238_Owner::submit(ML5238_Command *cmds, uint16_t n) {
+    if (!n) return;
+    for (uint16_t i = 0; i < n; ++i) {
+        cmds[i].done.store(false, std::memory_order_relaxed);
+        cmds[i].next.store(i + 1 < n ? &cmds[i + 1] : nullptr, std::memory_order_relaxed);
+    }
+    _queue.push_chain(&cmds[0], &cmds[n - 1]);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_sleeping.load()) {
+        std::lock_guard<std::mutex> lk(_mutex);
+        _cv.notify_one();
+    }
+}
+
+void ML5238_Owner::wait(const ML5238_Command &c) const {
+    while (!c.done.load(std::memory_order_acquire)) std::this_thread::yield();
+}
+
+void ML5238_Owner::call(ML5238_Command &c) {
+    submit(c);
+    if (_running.load(std::memory_order_acquire)) wait(c);
+    else poll();
+}
+
+uint8_t ML5238_Owner::read(uint8_t reg) {
+    ML5238_Command c;
+    c.op = ML5238_OP_READ;
+    c.reg = reg;
+    call(c);
+    return c.result;
+}
+
+bool ML5238_Owner::write(uint8_t reg, uint8_t val) {
+    ML5238_Command c;
+    c.op = ML5238_OP_WRITE;
+    c.reg = reg;
+    c.val = val;
+    call(c);
+    return c.status == ML5238_CMD_OK;
+}
+
+void ML5238_Owner::set_fets(bool charge, bool discharge) {
+    ML5238_Command c;
+    c.op = ML5238_OP_FETS;
+    c.val = (uint8_t)((charge ? 1 : 0) | (discharge ? 2 : 0));
+    call(c);
+}
+
+void ML5238_Owner::set_balance(uint16_t mask) {
+    ML5238_Command c;
+    c.op = ML5238_OP_BALANCE;
+    c.mask = mask;
+    call(c);
+}
+
+void ML5238_Owner::clear_faults() {
+    ML5238_Command c;
+    c.op = ML5238_OP_CLEAR_FAULTS;
+    call(c);
+}
+
+void ML5238_Owner::poll() {
+    while (ML5238_Command *c = _queue.pop()) {
+        _commands.fetch_add(1, std::memory_order_relaxed);
+        if (c->op == ML5238_OP_READ || c->op == ML5238_OP_WRITE) {
+            if (c->reg >= REG_COUNT) {
+                c->result = 0;
+                c->status = ML5238_CMD_REFUSED;
+                c->done.store(true, std::memory_order_release);
+            } else if (!add(c)) {
+                flush();
+                add(c);
+            }
+        } else {
+            flush();
+            execute(c);
+        }
+    }
+    flush();
+
+    const Clock::time_point now = Clock::now();
+    if (_tick.count() && now >= _next_tick) {
+        _latency.record((uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(now - _next_tick).count());
+        _bms.tick();
+        ++_ticks;
+        _next_tick += _tick;
+        if (_next_tick < Clock::now()) _next_tick = Clock::now() + _tick;
+        publish();
+    }
+}
+
+bool ML5238_Owner::add(ML5238_Command *c) {
+    if (_npending >= MAX_PENDING) return false;
+    int8_t frame;
+    if (c->op == ML5238_OP_WRITE) {
+        // Only into the latest write, later writes to other registers keep their order
+        frame = (MERGEABLE & (1U << c->reg)) ? _last_write[c->reg] : -1;
+        if (frame >= 0 && frame == _write_frame) {
+            _batch.set_data((uint8_t)frame, c->val);
+            _merged.fetch_add(1, std::memory_order_relaxed);
+        } else if ((frame = _batch.write(c->reg, c->val)) < 0) {
+            return false;
+        }
+        _last_write[c->reg] = frame;
+        // Any write can change what a read sees, later reads go out after it
+        for (uint8_t i = 0; i < REG_COUNT; ++i) _last_read[i] = -1;
+        _write_frame = frame;
+    } else {
+        frame = _last_read[c->reg];
+        if (frame >= 0) _merged.fetch_add(1, std::memory_order_relaxed);
+        else if ((frame = _batch.read(c->reg)) < 0) return false;
+        _last_read[c->reg] = frame;
+        _last_write[c->reg] = -1;
+        // A later write must not move ahead of this read
+        _write_frame = -1;
+    }
+    _pending[_npending] = c;
+    _frame_of[_npending] = frame;
+    ++_npending;
+    return true;
+}
+
+void ML5238_Owner::flush() {
+    if (!_npending) return;
+    const bool ok = _bms.run(_batch);
+    _bursts.fetch_add(1, std::memory_order_relaxed);
+    for (uint8_t i = 0; i < _npending; ++i) {
+        ML5238_Command *c = _pending[i];
+        if (ok) {
+            c->result = c->op == ML5238_OP_READ ? _batch.result((uint8_t)_frame_of[i]) : 0;
+            c->status = ML5238_CMD_OK;
+        } else if (c->op == ML5238_OP_READ) {
+            // Refused as a whole: in submission order, each on its own, so only the offenders fail
+            c->result = _bms.read(c->reg);
+            c->status = ML5238_CMD_OK;
+        } else {
+            c->result = 0;
+            c->status = _bms.write(c->reg, c->val) ? ML5238_CMD_OK : ML5238_CMD_REFUSED;
+        }
+        c->done.store(true, std::memory_order_release);
+    }
+    _npending = 0;
+    _write_frame = -1;
+    _batch.clear();
+    for (uint8_t i = 0; i < REG_COUNT; ++i) _last_write[i] = _last_read[i] = -1;
+}
+
+void ML5238_Owner::execute(ML5238_Command *c) {
+    switch (c->op) {
+    case ML5238_OP_FETS:
+        _bms.set_fets((c->val & 1) != 0, (c->val & 2) != 0);
+        break;
+    case ML5238_OP_BALANCE:
+        _bms.set_balance(c->mask);
+        break;
+    case ML5238_OP_CLEAR_FAULTS:
+        _bms.clear_faults();
+        break;
+    case ML5238_OP_CALIBRATE:
+        _bms.calibrate_current();
+        break;
+    case ML5238_OP_POWER_SAVE:
+        _bms.set_power_save(c->val != 0);
+        break;
+    default:
+        break;
+    }
+    publish();
+    c->status = ML5238_CMD_OK;
+    c->done.store(true, std::memory_order_release);
+}
+
+void ML5238_Owner::publish() {
+    ML5238_Snapshot s;
+    memset(&s, 0, sizeof(s));
+    s.state = _bms.state();
+    for (uint8_t i = 0; i < REG_COUNT; ++i) s.reg[i] = _bms.shadow(i);
+    s.ticks = _ticks;
+    _snap.store(s);
+    if (_mirror) _mirror->publish(s);
+}
+
+}  // namespace drivers
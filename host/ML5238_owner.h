@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include "../ML5238.h"
+#include "ML5238_mpsc.h"
+#include "ML5238_rt.h"
+#include "ML5238_seqlock.h"
+
+namespace drivers {
+
+class ML5238_ShmWriter;
+
+struct ML5238_Snapshot {
+    ML5238_State state;
+    uint8_t reg[ml5238::REG_COUNT];     // last written register values
+    uint32_t ticks;
+};
+
+enum : uint8_t {
+    ML5238_OP_READ,
+    ML5238_OP_WRITE,
+    ML5238_OP_FETS,         // val bit 0 charge, bit 1 discharge
+    ML5238_OP_BALANCE,      // mask
+    ML5238_OP_CLEAR_FAULTS,
+    ML5238_OP_CALIBRATE,    // IMON zero correction
+    ML5238_OP_POWER_SAVE,   // val 1 enters PSV, 0 leaves it
+};
+
+enum : uint8_t {
+    ML5238_CMD_OK,
+    ML5238_CMD_REFUSED,     // TEST address or a ML5238_Guard rule, nothing was sent
+};
+
+// A request to the owner thread. The submitter keeps it alive until done is set.
+struct ML5238_Command {
+    std::atomic<ML5238_Command *> next;
+    std::atomic<bool> done;
+    uint8_t op;
+    uint8_t reg;
+    uint8_t val;
+    uint8_t result;     // read data, 0 for refused TEST addresses
+    uint8_t status;     // ML5238_CMD_*, set with done
+    uint16_t mask;
+
+    ML5238_Command() : next(nullptr), done(false), op(0), reg(0), val(0), result(0), status(0), mask(0) {}
+};
+
+// Single writer device daemon. Any thread submits commands through a lock-free queue; the owner
+// thread alone touches the driver. Register accesses queued meanwhile go out as one burst:
+// back to back writes of a plain register keep the last value, repeated reads with no write in
+// between share one frame. PSENSE, RSENSE and POWER writes are never merged since each write
+// carries its own write-0-to-clear or power state intent. Register writes bypass the driver state, use the
+// high level ops for FETs and balancing. After every tick and high level op the state is
+// published through a seqlock, so readers never wait on the bus. A burst the guard refuses is
+// retried one command at a time, so only the commands it refuses on their own fail.
+class ML5238_Owner {
+public:
+    ML5238_Owner(ML5238 &bms, uint32_t tick_us);
+    ~ML5238_Owner();
+
+    void start();
+    void stop();
+    // Serves queued commands and a due tick on the calling thread, start() loops on this
+    void poll();
+
+    void submit(ML5238_Command &c);
+    // Queues n commands as one unit; register accesses among them share a burst
+    void submit(ML5238_Command *cmds, uint16_t n);
+    void wait(const ML5238_Command &c) const;
+
+    uint8_t read(uint8_t reg);
+    // False if refused: TEST address or a ML5238_Guard rule
+    bool write(uint8_t reg, uint8_t val);
+    void set_fets(bool charge, bool discharge);
+    void set_balance(uint16_t mask);
+    void clear_faults();
+
+    void snapshot(ML5238_Snapshot &out) const { _snap.load(out); }
+    const ML5238_Seqlock<ML5238_Snapshot> &published() const { return _snap; }
+    // Also publish every snapshot to other processes, null stops it. Set before start().
+    void mirror(ML5238_ShmWriter *shm) { _mirror = shm; }
+    // Pinning, priority and stack prefault for the owner thread, set before start()
+    void set_rt(const ML5238_RtThread &t) { _rt = t; }
+    // What set_rt() achieved once the thread runs, ML5238_RT_* flags
+    uint8_t rt() const { return _rt_flags.load(std::memory_order_acquire); }
+    // Lateness of each tick against its due time, read after stop()
+    const ML5238_LatencyHist &tick_latency() const { return _latency; }
+
+    uint32_t commands() const { return _commands.load(std::memory_order_relaxed); }
+    uint32_t bursts() const { return _bursts.load(std::memory_order_relaxed); }
+    uint32_t merged() const { return _merged.load(std::memory_order_relaxed); }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    void call(ML5238_Command &c);
+    bool add(ML5238_Command *c);
+    void flush();
+    void execute(ML5238_Command *c);
+    void publish();
+    void loop();
+
+    static const uint8_t MAX_PENDING = 64;
+
+    ML5238 &_bms;
+    Clock::duration _tick;
+    Clock::time_point _next_tick;
+    uint32_t _ticks;
+
+    ML5238_Mpsc<ML5238_Command> _queue;
+    ML5238_Batch _batch;
+    ML5238_Command *_pending[MAX_PENDING];
+    int8_t _frame_of[MAX_PENDING];
+    uint8_t _npending;
+    int8_t _write_frame;
+    int8_t _last_write[ml5238::REG_COUNT];
+    int8_t _last_read[ml5238::REG_COUNT];
+
+    ML5238_Seqlock<ML5238_Snapshot> _snap;
+    ML5238_ShmWriter *_mirror;
+    ML5238_RtThread _rt;
+    std::atomic<uint8_t> _rt_flags;
+    ML5238_LatencyHist _latency;
+
+    std::thread _thread;
+    std::atomic<bool> _running;
+    std::atomic<bool> _sleeping;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+
+    std::atomic<uint32_t> _commands;
+    std::atomic<uint32_t> _bursts;
+    std::atomic<uint32_t> _merged;
+};
+
+}  // namespace drivers
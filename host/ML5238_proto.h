@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace drivers {
+
+// Local command protocol over a SOCK_STREAM Unix socket, host byte order. A request is a
+// header followed by count commands, the reply repeats the header with count results in the
+// same order. Clients may pipeline requests, replies come back in request order. All commands
+// of one request are queued to the owner as a unit, so their register accesses share a burst.
+struct ML5238_MsgHeader {
+    uint16_t id;        // echoed back
+    uint8_t count;
+    uint8_t flags;      // reserved, 0
+};
+
+struct ML5238_MsgCommand {
+    uint8_t op;         // ML5238_OP_*
+    uint8_t reg;
+    uint16_t arg;       // write value, FET bits, balance mask or PSV on/off
+};
+
+struct ML5238_MsgResult {
+    uint8_t status;     // ML5238_MSG_*
+    uint8_t data;       // register read data
+};
+
+enum : uint8_t {
+    ML5238_MSG_OK,
+    ML5238_MSG_BAD_OP,
+    ML5238_MSG_BAD_REG,     // TEST addresses are refused
+    ML5238_MSG_REFUSED,     // a ML5238_Guard rule refused the write, nothing was sent
+};
+
+static const uint8_t ML5238_MSG_MAX_COMMANDS = 64;
+
+}  // namespace drivers
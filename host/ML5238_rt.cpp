@@ -0,0 +1,107 @@
+#include "ML5238_rt.h"
+#include <alloca.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+namespace drivers {
+
+void ML5238_LatencyHist::clear() {
+    memset(_bucket, 0, sizeof(_bucket));
+    _count = 0;
+    _max_us = 0;
+    _sum_us = 0;
+}
+
+uint32_t ML5238_LatencyHist::percentile_us(uint16_t permille) const {
+    if (!_count) return 0;
+    const uint64_t want = ((uint64_t)_count * permille + 999) / 1000;
+    uint64_t seen = 0;
+    for (uint32_t us = 0; us <= LIMIT_US; ++us) {
+        seen += _bucket[us];
+        if (seen >= want && seen) return us < LIMIT_US ? us : _max_us;
+    }
+    return _max_us;
+}
+
+uint32_t ML5238_LatencyHist::above(uint32_t us) const {
+    if (us >= LIMIT_US) return 0;
+    uint32_t n = 0;
+    for (uint32_t i = us + 1; i <= LIMIT_US; ++i) n += _bucket[i];
+    return n;
+}
+
+namespace {
+
+// Not inlined so the frame really is stack_bytes deep
+__attribute__((noinline)) void touch_stack(uint32_t bytes) {
+    volatile uint8_t *p = (volatile uint8_t *)alloca(bytes);
+    for (uint32_t i = 0; i < bytes; i += 4096) p[i] = 0;
+}
+
+}  // namespace
+
+uint8_t ML5238_Rt::lock_memory(size_t heap_bytes) {
+    uint8_t flags = 0;
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) flags |= ML5238_RT_LOCKED;
+    // Freed memory stays in the heap and large blocks come from it too, no fresh pages later
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+    if (heap_bytes) {
+        uint8_t *p = (uint8_t *)malloc(heap_bytes);
+        if (p) {
+            for (size_t i = 0; i < heap_bytes; i += 4096) ((volatile uint8_t *)p)[i] = 0;
+            free(p);
+        }
+    }
+    return flags;
+}
+
+uint8_t ML5238_Rt::apply(const ML5238_RtThread &t) {
+    uint8_t flags = 0;
+    if (t.cpu >= 0 && t.cpu < CPU_SETSIZE) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(t.cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0) flags |= ML5238_RT_PINNED;
+    }
+    if (t.priority > 0) {
+        sched_param sp;
+        memset(&sp, 0, sizeof(sp));
+        sp.sched_priority = t.priority;
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp) == 0) flags |= ML5238_RT_FIFO;
+    }
+    if (t.stack_bytes) touch_stack(t.stack_bytes);
+    return flags;
+}
+
+uint64_t ML5238_Rt::isolated_cpus() {
+    FILE *f = fopen("/sys/devices/system/cpu/isolated", "r");
+    if (!f) return 0;
+    char buf[256];
+    uint64_t mask = 0;
+    if (fgets(buf, sizeof(buf), f)) {
+        // "2-3,6"
+        char *s = buf;
+        while (*s >= '0' && *s <= '9') {
+            const long a = strtol(s, &s, 10);
+            const long b = *s == '-' ? strtol(s + 1, &s, 10) : a;
+            for (long c = a; c <= b && c < 64; ++c) mask |= 1ULL << c;
+            if (*s == ',') ++s;
+        }
+    }
+    fclose(f);
+    return mask;
+}
+
+const char *ML5238_Rt::describe(uint8_t flags) {
+    static const char *const TEXT[8] = { "none", "locked", "pinned", "locked pinned",
+                                         "fifo", "locked fifo", "pinned fifo", "locked pinned fifo" };
+    return TEXT[flags & 7];
+}
+
+}  // namespace drivers
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace drivers {
+
+// Wake-up latency in 1 us buckets up to LIMIT_US, later ones land in the last bucket. Written by
+// one thread; read it once that thread is stopped.
+class ML5238_LatencyHist {
+public:
+    static const uint32_t LIMIT_US = 2000;
+
+    ML5238_LatencyHist() { clear(); }
+
+    void clear();
+    void record(uint32_t us) {
+        ++_bucket[us < LIMIT_US ? us : LIMIT_US];
+        ++_count;
+        _sum_us += us;
+        if (us > _max_us) _max_us = us;
+    }
+
+    uint32_t count() const { return _count; }
+    uint32_t max_us() const { return _max_us; }
+    double avg_us() const { return _count ? (double)_sum_us / _count : 0.0; }
+    // Smallest latency at or above the given share of the samples, permille 500 is the median
+    uint32_t percentile_us(uint16_t permille) const;
+    // Samples above us
+    uint32_t above(uint32_t us) const;
+
+private:
+    uint32_t _bucket[LIMIT_US + 1];
+    uint32_t _count;
+    uint32_t _max_us;
+    uint64_t _sum_us;
+};
+
+// What one real-time thread asks for. cpu -1 keeps the affinity, priority 0 keeps SCHED_OTHER.
+struct ML5238_RtThread {
+    int cpu;
+    int priority;               // SCHED_FIFO 1..99
+    uint32_t stack_bytes;       // stack touched up front so it never faults later
+
+    ML5238_RtThread(int cpu = -1, int priority = 0, uint32_t stack_bytes = 64 * 1024)
+        : cpu(cpu), priority(priority), stack_bytes(stack_bytes) {}
+};
+
+enum : uint8_t {
+    ML5238_RT_LOCKED = 1,       // mlockall() current and future pages
+    ML5238_RT_PINNED = 2,
+    ML5238_RT_FIFO = 4,
+};
+
+// Opt-in real-time setup for Linux hosts. Every step can fail without privileges (CAP_IPC_LOCK,
+// CAP_SYS_NICE, RLIMIT_MEMLOCK, RLIMIT_RTPRIO); the calls report what took effect as RT flags
+// and leave the rest as it was, so a plain user run still works.
+class ML5238_Rt {
+public:
+    // Locks all pages of the process, stops malloc from trimming or mmap'ing, then touches
+    // heap_bytes of heap so later allocations up to that size do not fault. Call once, early.
+    static uint8_t lock_memory(size_t heap_bytes);
+    // Pins and prioritises the calling thread and prefaults its stack
+    static uint8_t apply(const ML5238_RtThread &t);
+    // CPUs listed in /sys/devices/system/cpu/isolated as a mask of the first 64, 0 if none
+    static uint64_t isolated_cpus();
+    // "locked pinned fifo" or "none"
+    static const char *describe(uint8_t flags);
+};
+
+}  // namespace drivers
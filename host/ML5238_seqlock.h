@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+
+namespace drivers {
+
+// Single writer sequence lock for a trivially copyable T. The payload is kept in relaxed atomic
+// words so concurrent copies are well defined; readers retry instead of blocking the writer.
+template <class T>
+class ML5238_Seqlock {
+public:
+    ML5238_Seqlock() : _seq(0) {
+        for (size_t i = 0; i < WORDS; ++i) _w[i].store(0, std::memory_order_relaxed);
+    }
+
+    void store(const T &v) {
+        uint32_t buf[WORDS] = {};
+        memcpy(buf, &v, sizeof(T));
+        const uint32_t s = _seq.load(std::memory_order_relaxed);
+        _seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; ++i) _w[i].store(buf[i], std::memory_order_relaxed);
+        _seq.store(s + 2, std::memory_order_release);
+    }
+
+    // Takes over a lock a previous writer left, e.g. in shared memory after a restart. The sequence
+    // keeps counting up, so a reader that sampled an old value cannot see it again over a torn
+    // copy. False if that writer stopped halfway, the payload is then torn until the next store().
+    bool resume() {
+        const uint32_t s = _seq.load(std::memory_order_relaxed);
+        _seq.store((s + 1) & ~1U, std::memory_order_release);
+        return !(s & 1);
+    }
+
+    // One attempt, false if a write was in progress or finished meanwhile
+    bool try_load(T &out) const {
+        uint32_t buf[WORDS];
+        const uint32_t s0 = _seq.load(std::memory_order_acquire);
+        if (s0 & 1) return false;
+        for (size_t i = 0; i < WORDS; ++i) buf[i] = _w[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (_seq.load(std::memory_order_relaxed) != s0) return false;
+        memcpy(&out, buf, sizeof(T));
+        return true;
+    }
+
+    void load(T &out) const {
+        while (!try_load(out)) {
+        }
+    }
+
+    // Even while no write is in progress, advances by 2 per store()
+    uint32_t sequence() const { return _seq.load(std::memory_order_acquire); }
+
+private:
+    static const size_t WORDS = (sizeof(T) + 3) / 4;
+
+    std::atomic<uint32_t> _seq;
+    std::atomic<uint32_t> _w[WORDS];
+};
+
+}  // namespace drivers
@@ -0,0 +1,206 @@
+#include "ML5238_server.h"
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace drivers {
+
+using namespace ml5238;
+
+ML5238_Server::ML5238_Server(ML5238_Owner &owner)
+    : _owner(owner), _listen(-1), _running(false), _nclients(0), _npool(0), _npending(0), _requests(0),
+      _rounds(0) {
+    _path[0] = 0;
+}
+
+bool ML5238_Server::open(const char *path) {
+    close();
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) return false;
+    strcpy(addr.sun_path, path);
+
+    _listen = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (_listen < 0) return false;
+    unlink(path);
+    if (bind(_listen, (const sockaddr *)&addr, sizeof(addr)) != 0 || listen(_listen, MAX_CLIENTS) != 0) {
+        close();
+        return false;
+    }
+    strcpy(_path, path);
+    return true;
+}
+
+void ML5238_Server::close() {
+    while (_nclients) drop((uint8_t)(_nclients - 1));
+    if (_listen >= 0) ::close(_listen);
+    if (_path[0]) unlink(_path);
+    _listen = -1;
+    _path[0] = 0;
+}
+
+void ML5238_Server::run() {
+    _running.store(true);
+    while (_running.load()) step(100);
+}
+
+bool ML5238_Server::has_request(const Client &c) const {
+    if (c.in_len < sizeof(ML5238_MsgHeader)) return false;
+    ML5238_MsgHeader hdr;
+    memcpy(&hdr, c.in, sizeof(hdr));
+    // A protocol error is for collect() to handle
+    if (hdr.count > ML5238_MSG_MAX_COMMANDS) return true;
+    // Without room for the reply the request waits, POLLOUT wakes the loop once the client reads
+    return c.in_len >= sizeof(hdr) + hdr.count * sizeof(ML5238_MsgCommand) &&
+           (size_t)(OUT_SIZE - c.out_len) >= sizeof(hdr) + hdr.count * sizeof(ML5238_MsgResult);
+}
+
+void ML5238_Server::step(int timeout_ms) {
+    if (_listen < 0) return;
+    bool ready = false;
+    pollfd fds[1 + MAX_CLIENTS];
+    const uint8_t n = _nclients;
+    fds[0].fd = _listen;
+    fds[0].events = POLLIN;
+    for (uint8_t i = 0; i < n; ++i) {
+        const Client &c = _client[i];
+        fds[1 + i].fd = c.fd;
+        // A full input buffer leaves the rest in the socket until collect() takes some
+        fds[1 + i].events = (short)((c.in_len < IN_SIZE ? POLLIN : 0) | (c.out_len ? POLLOUT : 0));
+        ready = ready || has_request(c);
+    }
+    if (poll(fds, 1 + n, ready ? 0 : timeout_ms) < 0 && errno != EINTR) return;
+
+    // Backwards, drop() moves the last client into the freed slot
+    for (uint8_t i = n; i-- > 0;) {
+        const short ev = fds[1 + i].revents;
+        bool ok = true;
+        if (ev & POLLIN) ok = receive(_client[i]);
+        else if (ev & (POLLERR | POLLHUP)) ok = false;
+        if (ok && (ev & POLLOUT)) ok = send(_client[i]);
+        if (!ok) drop(i);
+    }
+    if (fds[0].revents & POLLIN) accept_clients();
+
+    _npool = 0;
+    _npending = 0;
+    for (uint8_t i = 0; i < _nclients; ++i) collect(i);
+    if (_npending) complete();
+}
+
+void ML5238_Server::accept_clients() {
+    while (_nclients < MAX_CLIENTS) {
+        const int fd = accept4(_listen, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        Client &c = _client[_nclients++];
+        c.fd = fd;
+        c.in_len = c.out_len = c.parsed = 0;
+    }
+}
+
+bool ML5238_Server::receive(Client &c) {
+    while (c.in_len < IN_SIZE) {
+        const ssize_t r = recv(c.fd, c.in + c.in_len, IN_SIZE - c.in_len, 0);
+        if (r > 0) c.in_len = (uint16_t)(c.in_len + r);
+        else if (r == 0) return false;
+        else return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    return true;
+}
+
+bool ML5238_Server::send(Client &c) {
+    while (c.out_len) {
+        const ssize_t r = ::send(c.fd, c.out, c.out_len, MSG_NOSIGNAL);
+        if (r < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        memmove(c.out, c.out + r, c.out_len - (size_t)r);
+        c.out_len = (uint16_t)(c.out_len - r);
+    }
+    return true;
+}
+
+void ML5238_Server::drop(uint8_t ci) {
+    ::close(_client[ci].fd);
+    --_nclients;
+    if (ci != _nclients) memcpy(&_client[ci], &_client[_nclients], sizeof(Client));
+}
+
+void ML5238_Server::collect(uint8_t ci) {
+    Client &c = _client[ci];
+    c.parsed = 0;
+    uint16_t room = (uint16_t)(OUT_SIZE - c.out_len);
+    while (c.in_len - c.parsed >= (int)sizeof(ML5238_MsgHeader)) {
+        ML5238_MsgHeader hdr;
+        memcpy(&hdr, c.in + c.parsed, sizeof(hdr));
+        if (hdr.count > ML5238_MSG_MAX_COMMANDS) {
+            // Protocol error, the next poll sees the hangup
+            shutdown(c.fd, SHUT_RDWR);
+            c.in_len = c.parsed = 0;
+            return;
+        }
+        const uint16_t len = (uint16_t)(sizeof(hdr) + hdr.count * sizeof(ML5238_MsgCommand));
+        const uint16_t reply = (uint16_t)(sizeof(hdr) + hdr.count * sizeof(ML5238_MsgResult));
+        if (c.in_len - c.parsed < len || reply > room || _npool + hdr.count > POOL || _npending >= POOL) return;
+
+        Pending &p = _pending[_npending++];
+        p.client = ci;
+        p.first = _npool;
+        p.hdr = hdr;
+        const uint8_t *m = c.in + c.parsed + sizeof(hdr);
+        for (uint8_t k = 0; k < hdr.count; ++k, m += sizeof(ML5238_MsgCommand)) {
+            ML5238_MsgCommand mc;
+            memcpy(&mc, m, sizeof(mc));
+            ML5238_Command &cmd = _pool[_npool];
+            cmd.op = mc.op;
+            cmd.reg = mc.reg;
+            cmd.val = (uint8_t)mc.arg;
+            cmd.mask = mc.arg;
+            cmd.result = 0;
+            // Invalid commands still go through the owner, which completes them untouched
+            uint8_t st = ML5238_MSG_OK;
+            if (mc.op > ML5238_OP_POWER_SAVE) st = ML5238_MSG_BAD_OP;
+            else if ((mc.op == ML5238_OP_READ || mc.op == ML5238_OP_WRITE) && mc.reg >= REG_COUNT)
+                st = ML5238_MSG_BAD_REG;
+            _status[_npool++] = st;
+        }
+        c.parsed = (uint16_t)(c.parsed + len);
+        room = (uint16_t)(room - reply);
+    }
+}
+
+void ML5238_Server::complete() {
+    _owner.submit(_pool, _npool);
+    for (uint16_t i = 0; i < _npool; ++i) _owner.wait(_pool[i]);
+    ++_rounds;
+
+    for (uint16_t r = 0; r < _npending; ++r) {
+        const Pending &p = _pending[r];
+        Client &c = _client[p.client];
+        memcpy(c.out + c.out_len, &p.hdr, sizeof(p.hdr));
+        c.out_len = (uint16_t)(c.out_len + sizeof(p.hdr));
+        for (uint8_t k = 0; k < p.hdr.count; ++k) {
+            ML5238_MsgResult res;
+            const ML5238_Command &cmd = _pool[p.first + k];
+            res.status = _status[p.first + k];
+            if (res.status == ML5238_MSG_OK && cmd.status == ML5238_CMD_REFUSED) res.status = ML5238_MSG_REFUSED;
+            res.data = res.status == ML5238_MSG_OK ? cmd.result : 0;
+            memcpy(c.out + c.out_len, &res, sizeof(res));
+            c.out_len = (uint16_t)(c.out_len + sizeof(res));
+        }
+        ++_requests;
+    }
+    for (uint8_t i = _nclients; i-- > 0;) {
+        Client &c = _client[i];
+        if (c.parsed) {
+            memmove(c.in, c.in + c.parsed, c.in_len - c.parsed);
+            c.in_len = (uint16_t)(c.in_len - c.parsed);
+            c.parsed = 0;
+        }
+        if (c.out_len && !send(c)) drop(i);
+    }
+}
+
+}  // namespace drivers
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include "ML5238_owner.h"
+#include "ML5238_proto.h"
+
+namespace drivers {
+
+// Unix socket front end of the ML5238_Owner. Each loop step collects every complete request
+// from every client, queues all their commands to the owner as one unit and writes the
+// replies, so requests arriving together from several clients also share a burst.
+class ML5238_Server {
+public:
+    static const uint8_t MAX_CLIENTS = 16;
+
+    explicit ML5238_Server(ML5238_Owner &owner);
+    ~ML5238_Server() { close(); }
+
+    // Binds and listens on path, an old socket file is replaced. False on a system error.
+    bool open(const char *path);
+    void close();
+
+    // One poll step, waits up to timeout_ms for traffic
+    void step(int timeout_ms);
+    // Steps until stop() from another thread
+    void run();
+    void stop() { _running.store(false); }
+
+    uint32_t requests() const { return _requests; }
+    uint32_t rounds() const { return _rounds; }
+    uint8_t clients() const { return _nclients; }
+
+private:
+    static const uint16_t IN_SIZE = 4096;
+    static const uint16_t OUT_SIZE = 4096;
+    static const uint16_t POOL = 512;
+
+    struct Client {
+        int fd;
+        uint16_t in_len;
+        uint16_t out_len;
+        uint16_t parsed;        // bytes of in taken by this round
+        uint8_t in[IN_SIZE];
+        uint8_t out[OUT_SIZE];
+    };
+
+    // A request of this round, its commands are pool[first, first + count)
+    struct Pending {
+        uint8_t client;
+        uint16_t first;
+        ML5238_MsgHeader hdr;
+    };
+
+    void accept_clients();
+    bool receive(Client &c);
+    void collect(uint8_t ci);
+    void complete();
+    bool send(Client &c);
+    void drop(uint8_t ci);
+    bool has_request(const Client &c) const;
+
+    ML5238_Owner &_owner;
+    int _listen;
+    char _path[108];
+    std::atomic<bool> _running;
+
+    Client _client[MAX_CLIENTS];
+    uint8_t _nclients;
+
+    ML5238_Command _pool[POOL];
+    uint8_t _status[POOL];
+    uint16_t _npool;
+    Pending _pending[POOL];
+    uint16_t _npending;
+
+    uint32_t _requests;
+    uint32_t _rounds;
+};
+
+}  // namespace drivers
@@ -0,0 +1,93 @@
+#include "ML5238_shm.h"
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace drivers {
+
+namespace {
+
+const unsigned READ_TRIES = 1000;
+
+}  // namespace
+
+bool ML5238_ShmWriter::open(const char *name) {
+    close();
+    _fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (_fd < 0) return false;
+    if (ftruncate(_fd, sizeof(ML5238_ShmSegment)) != 0) {
+        close();
+        return false;
+    }
+    void *p = mmap(nullptr, sizeof(ML5238_ShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (p == MAP_FAILED) {
+        close();
+        return false;
+    }
+    _seg = static_cast<ML5238_ShmSegment *>(p);
+    // A restarted writer keeps the sequence of the live segment, readers may still be mapped
+    const bool live = _seg->magic.load(std::memory_order_acquire) == ML5238_ShmSegment::MAGIC &&
+                      _seg->version == ML5238_ShmSegment::VERSION && _seg->size == sizeof(ML5238_Snapshot);
+    if (live) {
+        if (!_seg->snap.resume()) _seg->snap.store(ML5238_Snapshot());
+        return true;
+    }
+    _seg->magic.store(0, std::memory_order_release);
+    new (&_seg->snap) ML5238_Seqlock<ML5238_Snapshot>();
+    _seg->version = ML5238_ShmSegment::VERSION;
+    _seg->size = sizeof(ML5238_Snapshot);
+    _seg->magic.store(ML5238_ShmSegment::MAGIC, std::memory_order_release);
+    return true;
+}
+
+void ML5238_ShmWriter::close() {
+    if (_seg) munmap(_seg, sizeof(ML5238_ShmSegment));
+    if (_fd >= 0) ::close(_fd);
+    _seg = nullptr;
+    _fd = -1;
+}
+
+void ML5238_ShmWriter::unlink(const char *name) {
+    shm_unlink(name);
+}
+
+bool ML5238_ShmReader::open(const char *name) {
+    close();
+    _fd = shm_open(name, O_RDONLY, 0);
+    if (_fd < 0) return false;
+    struct stat st;
+    if (fstat(_fd, &st) != 0 || (size_t)st.st_size < sizeof(ML5238_ShmSegment)) {
+        close();
+        return false;
+    }
+    void *p = mmap(nullptr, sizeof(ML5238_ShmSegment), PROT_READ, MAP_SHARED, _fd, 0);
+    if (p == MAP_FAILED) {
+        close();
+        return false;
+    }
+    _seg = static_cast<const ML5238_ShmSegment *>(p);
+    if (_seg->magic.load(std::memory_order_acquire) != ML5238_ShmSegment::MAGIC ||
+        _seg->version != ML5238_ShmSegment::VERSION || _seg->size != sizeof(ML5238_Snapshot)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ML5238_ShmReader::close() {
+    if (_seg) munmap(const_cast<ML5238_ShmSegment *>(_seg), sizeof(ML5238_ShmSegment));
+    if (_fd >= 0) ::close(_fd);
+    _seg = nullptr;
+    _fd = -1;
+}
+
+bool ML5238_ShmReader::read(ML5238_Snapshot &out) const {
+    if (!_seg) return false;
+    for (unsigned i = 0; i < READ_TRIES; ++i)
+        if (_seg->snap.try_load(out)) return true;
+    return false;
+}
+
+}  // namespace drivers
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include "ML5238_owner.h"
+
+namespace drivers {
+
+// POSIX shared memory segment holding the latest ML5238_Snapshot behind a seqlock. One process
+// writes, any number map it read only and copy the snapshot out without a syscall. Writer and
+// readers must be built with the same ML5238_Snapshot layout, checked through version and size.
+struct ML5238_ShmSegment {
+    static const uint32_t MAGIC = 0x38323335;   // "5238"
+    static const uint32_t VERSION = 2;
+
+    std::atomic<uint32_t> magic;    // set last, once the segment is initialised
+    uint32_t version;
+    uint32_t size;
+    ML5238_Seqlock<ML5238_Snapshot> snap;
+};
+
+class ML5238_ShmWriter {
+public:
+    ML5238_ShmWriter() : _seg(nullptr), _fd(-1) {}
+    ~ML5238_ShmWriter() { close(); }
+
+    // Creates or reuses the named segment ("/ml5238"), false on a system error
+    bool open(const char *name);
+    void close();
+    // Also removes the name, mapped readers keep their view
+    static void unlink(const char *name);
+
+    void publish(const ML5238_Snapshot &s) { if (_seg) _seg->snap.store(s); }
+    bool is_open() const { return _seg != nullptr; }
+
+private:
+    ML5238_ShmSegment *_seg;
+    int _fd;
+};
+
+class ML5238_ShmReader {
+public:
+    ML5238_ShmReader() : _seg(nullptr), _fd(-1) {}
+    ~ML5238_ShmReader() { close(); }
+
+    // False if the segment is missing, not yet initialised or from another build
+    bool open(const char *name);
+    void close();
+
+    // Latest snapshot, false if not open or the writer kept it busy for too long
+    bool read(ML5238_Snapshot &out) const;
+    // Advances on every publish, a reader can skip unchanged snapshots
+    uint32_t sequence() const { return _seg ? _seg->snap.sequence() : 0; }
+    bool is_open() const { return _seg != nullptr; }
+
+private:
+    const ML5238_ShmSegment *_seg;
+    int _fd;
+};
+
+}  // namespace drivers
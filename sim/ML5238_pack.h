@@ -0,0 +1,126 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include "../ML5238_defs.h"
+
+namespace drivers {
+
+struct ML5238_CellParams {
+    double capacity_Ah;
+    double r25_ohm;             // internal resistance at 25C
+    double r_tempco;            // relative resistance increase per C below 25C
+    double self_discharge_day;  // fraction of capacity lost per day at 25C
+    double heat_J_K;            // thermal mass
+    double cooling_W_K;         // heat transfer to ambient
+
+    ML5238_CellParams()
+        : capacity_Ah(50.0), r25_ohm(0.0015), r_tempco(0.015), self_discharge_day(0.0003),
+          heat_J_K(900.0), cooling_W_K(0.8) {}
+};
+
+struct ML5238_Cell {
+    double soc;         // 0..1
+    double temp_C;
+    double capacity_As;
+    double r25_ohm;
+    double sd_per_s;
+    double heat_J_K;
+    double cooling_W_K;
+};
+
+// Series string of up to 16 cells with OCV, internal resistance, self discharge and a lumped
+// thermal node per cell. Current is pack current, charge positive.
+class ML5238_Pack {
+public:
+    explicit ML5238_Pack(uint8_t cells, const ML5238_CellParams &p = ML5238_CellParams())
+        : _cells(cells > ml5238::CELLS_MAX ? ml5238::CELLS_MAX : cells), _ambient_C(25.0),
+          _balance_ohm(2 * 18.0 + ml5238::RBL_TYP_OHM), _r_tempco(p.r_tempco), _balance_J(0.0) {
+        for (uint8_t i = 0; i < ml5238::CELLS_MAX; ++i) {
+            ML5238_Cell &c = _cell[i];
+            c.soc = 0.5;
+            c.temp_C = _ambient_C;
+            c.capacity_As = p.capacity_Ah * 3600.0;
+            c.r25_ohm = p.r25_ohm;
+            c.sd_per_s = p.self_discharge_day / 86400.0;
+            c.heat_J_K = p.heat_J_K;
+            c.cooling_W_K = p.cooling_W_K;
+        }
+    }
+
+    uint8_t cells() const { return _cells; }
+    ML5238_Cell &cell(uint8_t i) { return _cell[i]; }
+    const ML5238_Cell &cell(uint8_t i) const { return _cell[i]; }
+
+    void set_ambient(double C) { _ambient_C = C; }
+    double ambient() const { return _ambient_C; }
+    // Series resistance of the balancing path: 2 x RCEL + RBL of the application circuit
+    void set_balance_ohm(double ohm) { _balance_ohm = ohm; }
+    double balance_ohm() const { return _balance_ohm; }
+    double balance_J() const { return _balance_J; }
+
+    // Pack cell index 0 = lowest connected cell
+    double resistance(uint8_t i) const {
+        const ML5238_Cell &c = _cell[i];
+        double k = 1.0 + _r_tempco * (25.0 - c.temp_C);
+        return c.r25_ohm * (k < 0.5 ? 0.5 : k);
+    }
+
+    double terminal_V(uint8_t i, double current_A) const {
+        return ocv(_cell[i].soc) + current_A * resistance(i);
+    }
+
+    double pack_V(double current_A) const {
+        double v = 0.0;
+        for (uint8_t i = 0; i < _cells; ++i) v += terminal_V(i, current_A);
+        return v;
+    }
+
+    double balance_A(uint8_t i) const { return ocv(_cell[i].soc) / _balance_ohm; }
+
+    // balance bit i bleeds pack cell i
+    void step(double dt_s, double current_A, uint16_t balance) {
+        if (dt_s <= 0.0) return;
+        for (uint8_t i = 0; i < _cells; ++i) {
+            ML5238_Cell &c = _cell[i];
+            double i_cell = current_A;
+            double heat_W = current_A * current_A * resistance(i);
+            if (balance & (1U << i)) {
+                const double ib = balance_A(i);
+                i_cell -= ib;
+                // Most of the bleed power heats the external resistors and the IC, not the cell
+                _balance_J += ib * ib * _balance_ohm * dt_s;
+            }
+            // Self discharge doubles every 10C
+            const double sd = c.sd_per_s * exp2((c.temp_C - 25.0) / 10.0);
+            c.soc += (i_cell * dt_s) / c.capacity_As - sd * c.soc * dt_s;
+            if (c.soc < 0.0) c.soc = 0.0;
+            if (c.soc > 1.0) c.soc = 1.0;
+            // Relaxation towards the steady state temperature, exact for long steps
+            const double t_eq = _ambient_C + heat_W / c.cooling_W_K;
+            const double k = dt_s * c.cooling_W_K / c.heat_J_K;
+            c.temp_C = t_eq + (c.temp_C - t_eq) * (k < 0.01 ? 1.0 - k : exp(-k));
+        }
+    }
+
+    // Typical NMC open circuit voltage, piecewise linear in 10% steps
+    static double ocv(double soc) {
+        static const double V[11] = { 3.000, 3.450, 3.550, 3.600, 3.650, 3.700,
+                                      3.780, 3.870, 3.960, 4.060, 4.180 };
+        if (soc <= 0.0) return V[0];
+        if (soc >= 1.0) return V[10];
+        const double x = soc * 10.0;
+        const int i = (int)x;
+        return V[i] + (V[i + 1] - V[i]) * (x - i);
+    }
+
+private:
+    uint8_t _cells;
+    double _ambient_C;
+    double _balance_ohm;
+    double _r_tempco;
+    double _balance_J;
+    ML5238_Cell _cell[ml5238::CELLS_MAX];
+};
+
+}  // namespace drivers
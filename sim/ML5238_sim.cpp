@@ -0,0 +1,319 @@
+#include "ML5238_sim.h"
+
+namespace drivers {
+
+using namespace ml5238;
+
+ML5238_Sim::ML5238_Sim(ML5238_Pack &pack, const ML5238_SimConfig &cfg)
+    : _pack(pack), _cfg(cfg), _first(0), _psl(false), _psh(false), _rs(false), _load_A(0.0),
+      _charger(false), _load_connected(true), _pupin_low(false), _pdwn(false),
+      _pdwn_pending(false), _sc(false), _cap_uF(0.0), _bleed_ms(0.0), _cap_V(0.0), _gate(0.0),
+      _inrush_A(0.0), _fet_J(0.0), _cap_ns(0), _now_ns(0), _pack_ns(0), _sc_trip_ns(0), _trip_ns(0),
+      _psv_since_ns(0), _psv_ns(0), _pdwn_since_ns(0), _pdwn_ns(0), _frames(0), _violations(0),
+      _trips(0), _wakes(0), _bit_errors(0), _ber_q32(0), _rng(0x5238) {
+    const uint16_t mask = cells_mask(pack.cells());
+    while (_first < CELLS_MAX && !(mask & (1U << _first))) ++_first;
+    for (uint8_t i = 0; i < REG_COUNT; ++i) _r[i] = REG_RESET[i];
+    set_clock(_cfg.spi_hz);
+}
+
+uint32_t ML5238_Sim::set_clock(uint32_t hz) {
+    if (hz < 10000) hz = 10000;
+    if (hz > 4000000) hz = 4000000;
+    _cfg.spi_hz = hz;
+    _frame_ns = (uint32_t)(16000000000ULL / hz) + 500;
+    // Error rate per bit rises a decade every 12.5% over the board limit, from 1e-4
+    _ber_q32 = 0;
+    if (_cfg.spi_limit_hz && hz > _cfg.spi_limit_hz) {
+        const double ber = 1e-4 * pow(10.0, 8.0 * ((double)hz / _cfg.spi_limit_hz - 1.0));
+        _ber_q32 = ber >= 0.5 ? 0x80000000UL : (uint32_t)(ber * 4294967296.0);
+    }
+    return hz;
+}
+
+uint8_t ML5238_Sim::line(uint8_t v) {
+    if (!_ber_q32) return v;
+    for (uint8_t b = 0; b < 8; ++b) {
+        _rng ^= _rng << 13;
+        _rng ^= _rng >> 17;
+        _rng ^= _rng << 5;
+        if (_rng < _ber_q32) {
+            v ^= (uint8_t)(1U << b);
+            ++_bit_errors;
+        }
+    }
+    return v;
+}
+
+double ML5238_Sim::current() const {
+    if (_pdwn) return 0.0;
+    if (_inrush_A != 0.0) return _inrush_A + (_load_A < 0.0 ? _load_A * _cap_V / _pack.pack_V(0.0) : 0.0);
+    if (_load_A < 0.0 && (_r[REG_FET] & FET_DF)) return _load_A;
+    if (_load_A > 0.0 && (_r[REG_FET] & FET_CF)) return _load_A;
+    return 0.0;
+}
+
+void ML5238_Sim::flush() {
+    if (_now_ns <= _pack_ns) return;
+    const uint16_t bal = (uint16_t)((balance() & cells_mask(_pack.cells())) >> _first);
+    _pack.step((double)(_now_ns - _pack_ns) * 1e-9, current(), _pdwn ? 0 : bal);
+    _pack_ns = _now_ns;
+}
+
+void ML5238_Sim::set_load_capacitance(double uF, double bleed_ms) {
+    settle(_now_ns);
+    _cap_uF = uF;
+    _bleed_ms = bleed_ms;
+    if (!uF) {
+        _cap_V = _inrush_A = 0.0;
+        update_short();
+    }
+}
+
+void ML5238_Sim::settle(uint64_t end) {
+    if (!_cap_uF) return;
+    const double vp = _pack.pack_V(0.0), r_on = _cfg.loop_mohm * 1e-3;
+    while (_cap_ns < end) {
+        if (_pdwn || !(_r[REG_FET] & FET_DF)) {
+            _gate = 0.0;
+            _inrush_A = 0.0;
+            if (_bleed_ms > 0.0) _cap_V *= exp(-(double)(end - _cap_ns) * 1e-6 / _bleed_ms);
+            _cap_ns = end;
+            break;
+        }
+        if (_gate >= 1.0 && vp - _cap_V < 1e-3) {
+            _cap_V = vp;
+            _inrush_A = 0.0;
+            _cap_ns = end;
+            break;
+        }
+        // 1 us steps through the inrush
+        const uint64_t step = end - _cap_ns < 1000 ? end - _cap_ns : 1000;
+        const double dt = step * 1e-9;
+        const double rise_us = (_r[REG_FET] & FET_DRV) ? _cfg.gate_rise_drv_us : _cfg.gate_rise_us;
+        _gate = rise_us > 0 ? _gate + dt * 1e6 / rise_us : 1.0;
+        if (_gate > 1.0) _gate = 1.0;
+        const double i = _gate > 0.0 ? (vp - _cap_V) * _gate / r_on : 0.0;
+        // What the loop at full enhancement does not drop is across the channel
+        _fet_J += i * (vp - _cap_V) * (1.0 - _gate) * dt;
+        _cap_V += i * dt / (_cap_uF * 1e-6);
+        _cap_ns += step;
+        _inrush_A = -i;
+        if (_now_ns < _cap_ns) _now_ns = _cap_ns;
+        update_short();
+        if (_sc && _sc_trip_ns <= _cap_ns) {
+            flush();
+            trip();
+        }
+    }
+    update_short();
+}
+
+void ML5238_Sim::advance(uint64_t ns) {
+    const uint64_t end = _now_ns + ns;
+    settle(end);
+    if (_sc && _sc_trip_ns <= end) {
+        if (_sc_trip_ns > _now_ns) _now_ns = _sc_trip_ns;
+        flush();
+        trip();
+    }
+    _now_ns = end;
+    if (_now_ns - _pack_ns >= (uint64_t)_cfg.max_step_us * 1000) flush();
+}
+
+void ML5238_Sim::transfer(const uint8_t *tx, uint8_t *rx, uint8_t frames) {
+    for (uint8_t f = 0; f < frames; ++f) {
+        advance(_frame_ns);
+        ++_frames;
+        const uint8_t cmd = tx[2 * f];
+        const uint8_t reg = spi_reg(cmd);
+        uint8_t out = 0;
+        if (!_pdwn) {
+            // Only data bits flip, command bytes are assumed to arrive intact
+            if (reg >= REG_COUNT) ++_violations;
+            else if (cmd & SPI_READ) out = line(peek(reg));
+            else write(reg, line(tx[2 * f + 1]));
+        }
+        if (rx) {
+            rx[2 * f] = 0;
+            rx[2 * f + 1] = out;
+        }
+    }
+}
+
+uint8_t ML5238_Sim::peek(uint8_t reg) const {
+    if (reg >= REG_COUNT) return 0;
+    uint8_t v = _r[reg];
+    switch (reg) {
+    case REG_PSENSE:
+        if (_psl) v |= PSENSE_PSL;
+        if (_psh) v |= PSENSE_PSH;
+        break;
+    case REG_RSENSE:
+        if (_rs) v |= RSENSE_RS;
+        if (_sc) v |= RSENSE_SC;
+        break;
+    case REG_POWER:
+        if (_pupin_low) v |= POWER_PUPIN;
+        break;
+    case REG_STATUS: {
+        const uint8_t ps = _r[REG_PSENSE], rs = _r[REG_RSENSE];
+        v = _r[REG_FET] & (FET_DF | FET_CF);
+        if (psv()) v |= STATUS_PSV;
+        if (ps & PSENSE_RPSL) v |= STATUS_RPSL;
+        if (ps & PSENSE_RPSH) v |= STATUS_RPSH;
+        if (rs & RSENSE_RRS) v |= STATUS_RRS;
+        if (rs & RSENSE_RSC) v |= STATUS_RSC;
+        if (v & (STATUS_RPSL | STATUS_RPSH | STATUS_RRS | STATUS_RSC)) v |= STATUS_INT;
+        break;
+    }
+    default:
+        break;
+    }
+    return v;
+}
+
+void ML5238_Sim::write(uint8_t reg, uint8_t val) {
+    // Pack current and bleed paths only change with these
+    if (reg == REG_FET || reg == REG_CBALH || reg == REG_CBALL || reg == REG_POWER) flush();
+    const uint8_t old = _r[reg];
+    // Write-0-to-clear flags keep their value on 1, gated flags are fixed to 0 while disabled
+    _r[reg] = (uint8_t)((val & REG_WRITABLE[reg]) | (old & REG_W0C[reg] & val));
+    _r[reg] &= (uint8_t)~(REG_GATED_LOW[reg] & ~(_r[reg] >> 1));
+
+    if (reg == REG_CBALH || reg == REG_CBALL) {
+        if (!balance_legal(balance())) ++_violations;
+    } else if (reg == REG_POWER) {
+        if ((_r[reg] & POWER_PSV) && !(old & POWER_PSV)) _psv_since_ns = _now_ns;
+        if (!(_r[reg] & POWER_PSV) && (old & POWER_PSV)) _psv_ns += _now_ns - _psv_since_ns;
+        if ((_r[reg] & POWER_PDWN) && !(old & POWER_PDWN)) {
+            if (_r[REG_FET] & (FET_DF | FET_CF)) ++_violations;
+            if (_pupin_low) _pdwn_pending = true;
+            else enter_pdwn();
+            return;
+        }
+    }
+    update_inputs();
+    update_short();
+}
+
+void ML5238_Sim::update_inputs() {
+    const bool on = !_pdwn && !psv();
+    const uint8_t ps = _r[REG_PSENSE], rs = _r[REG_RSENSE];
+    const bool psl = on && (ps & PSENSE_EPSL) && !_charger;
+    const bool psh = on && (ps & PSENSE_EPSH) && !_charger;
+    const bool rsd = on && (rs & RSENSE_ERS) && !_load_connected;
+    if (psl && !_psl && (ps & PSENSE_IPSL)) _r[REG_PSENSE] |= PSENSE_RPSL;
+    if (psh && !_psh && (ps & PSENSE_IPSH)) _r[REG_PSENSE] |= PSENSE_RPSH;
+    if (rsd && !_rs && (rs & RSENSE_IRS)) _r[REG_RSENSE] |= RSENSE_RRS;
+    _psl = psl;
+    _psh = psh;
+    _rs = rsd;
+}
+
+void ML5238_Sim::update_short() {
+    const double isense_mV = -current() * _cfg.rsense_uohm * 1e-3;
+    const bool sc = !_pdwn && (_r[REG_RSENSE] & RSENSE_ESC) && isense_mV > setsc_mV(_r[REG_SETSC]);
+    if (sc && !_sc) _sc_trip_ns = _now_ns + short_delay_us(_cfg.cdly_nF) * 1000;
+    _sc = sc;
+}
+
+void ML5238_Sim::trip() {
+    _r[REG_FET] &= (uint8_t)~(FET_DF | FET_CF);
+    if (_r[REG_RSENSE] & RSENSE_ISC) _r[REG_RSENSE] |= RSENSE_RSC;
+    ++_trips;
+    _trip_ns = _now_ns;
+    update_short();
+}
+
+void ML5238_Sim::enter_pdwn() {
+    flush();
+    _pdwn = true;
+    _pdwn_pending = false;
+    _pdwn_since_ns = _now_ns;
+    if (psv()) _psv_ns += _now_ns - _psv_since_ns;
+    update_inputs();
+    update_short();
+}
+
+void ML5238_Sim::wake() {
+    flush();
+    _pdwn = false;
+    _pdwn_ns += _now_ns - _pdwn_since_ns;
+    for (uint8_t i = 0; i < REG_COUNT; ++i) _r[i] = REG_RESET[i];
+    ++_wakes;
+    update_inputs();
+    update_short();
+}
+
+void ML5238_Sim::set_load(double current_A) {
+    if (current_A == _load_A) return;
+    flush();
+    _load_A = current_A;
+    update_short();
+}
+
+void ML5238_Sim::set_charger(bool connected) {
+    if (connected == _charger) return;
+    flush();
+    _charger = connected;
+    if (_pdwn && connected) wake();
+    update_inputs();
+}
+
+void ML5238_Sim::set_load_connected(bool connected) {
+    if (connected == _load_connected) return;
+    flush();
+    _load_connected = connected;
+    update_inputs();
+}
+
+void ML5238_Sim::set_pupin(bool low) {
+    _pupin_low = low;
+    if (_pdwn && low) wake();
+    else if (!low && _pdwn_pending) enter_pdwn();
+}
+
+uint64_t ML5238_Sim::psv_ns() const {
+    return _psv_ns + (!_pdwn && psv() ? _now_ns - _psv_since_ns : 0);
+}
+
+uint64_t ML5238_Sim::pdwn_ns() const {
+    return _pdwn_ns + (_pdwn ? _now_ns - _pdwn_since_ns : 0);
+}
+
+uint16_t ML5238_Sim::adc(double mV) {
+    const uint32_t full = (1UL << _cfg.adc_bits) - 1;
+    double code = mV * full / _cfg.vref_mV + 0.5;
+    if (code < 0.0) code = 0.0;
+    if (code > full) code = full;
+    // Nearest mV, as the code itself: truncating here reads low by half a mV on average
+    return (uint16_t)(((uint32_t)code * _cfg.vref_mV + full / 2) / full);
+}
+
+uint16_t ML5238_Sim::vmon_mV() {
+    advance(_cfg.adc_ns);
+    const uint8_t v = _r[REG_VMON];
+    if (_pdwn || psv() || !(v & VMON_OUT)) return adc(0.0);
+    const uint8_t c = v & VMON_CN_MASK;
+    if (c < _first || c >= _first + _pack.cells()) return adc(0.0);
+    double cell_V = _pack.terminal_V((uint8_t)(c - _first), current());
+    // Balanced cell reads as the voltage difference between the two ports of the switch
+    if (balance() & (1U << c)) cell_V *= RBL_TYP_OHM / _pack.balance_ohm();
+    return adc(cell_V * 1000.0 / VMON_GAIN_DIV);
+}
+
+uint16_t ML5238_Sim::imon_mV() {
+    advance(_cfg.adc_ns);
+    const uint8_t v = _r[REG_IMON];
+    if (_pdwn || psv() || !(v & IMON_OUT)) return adc(0.0);
+    const double gain = (v & IMON_GIM) ? IMON_GAIN_HI : IMON_GAIN_LO;
+    const double ref_mV = (v & IMON_GIM) ? 20.0 : 100.0;
+    const double zero_mV = IMON_OFFSET_MV + _cfg.imon_offset_mV;
+    if (v & IMON_ZERO) return adc(zero_mV);
+    if (v & IMON_GCAL1) return adc(ref_mV);
+    if (v & IMON_GCAL0) return adc(zero_mV + ref_mV * gain);
+    return adc(zero_mV + current() * _cfg.rsense_uohm * 1e-3 * gain);
+}
+
+}  // namespace drivers
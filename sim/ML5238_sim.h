@@ -0,0 +1,144 @@
+#pragma once
+
+#include <stdint.h>
+#include "../ML5238.h"
+#include "../ML5238_regs.h"
+#include "ML5238_pack.h"
+
+namespace drivers {
+
+struct ML5238_SimConfig {
+    uint16_t rsense_uohm;
+    uint16_t cdly_nF;
+    uint32_t spi_hz;
+    uint16_t adc_ns;            // MCU ADC conversion time per sample
+    uint16_t adc_bits;
+    uint16_t vref_mV;           // VREF output used as ADC reference
+    int16_t  imon_offset_mV;    // IMON amplifier offset removed by zero correction
+    uint32_t max_step_us;       // longest pack integration step without an event
+    uint32_t spi_limit_hz;      // board layout: data bits start to flip above this clock
+    // D_FET turn-on into a load capacitance: the gate takes this long to full enhancement, the
+    // channel conductance rises with it up to the loop resistance of cells, wiring, capacitor ESR
+    // and FET fully on
+    uint16_t gate_rise_us;
+    uint16_t gate_rise_drv_us;  // with DRV set
+    uint16_t loop_mohm;
+
+    ML5238_SimConfig()
+        : rsense_uohm(3000), cdly_nF(1), spi_hz(ml5238::SPI_MAX_HZ), adc_ns(10000), adc_bits(12),
+          vref_mV(3300), imon_offset_mV(4), max_step_us(100000), spi_limit_hz(ml5238::SPI_MAX_HZ),
+          gate_rise_us(2000), gate_rise_drv_us(200), loop_mohm(100) {}
+};
+
+// Register level model of the ML5238 driving a ML5238_Pack. The simulated clock only advances
+// through bus traffic, ADC samples and delay_us(), so a driver runs as fast as the host allows.
+class ML5238_Sim : public ML5238_Port {
+public:
+    ML5238_Sim(ML5238_Pack &pack, const ML5238_SimConfig &cfg = ML5238_SimConfig());
+
+    void transfer(const uint8_t *tx, uint8_t *rx, uint8_t frames) override;
+    uint16_t vmon_mV() override;
+    uint16_t imon_mV() override;
+    uint32_t micros() override { return (uint32_t)(_now_ns / 1000); }
+    void delay_us(uint32_t us) override { advance((uint64_t)us * 1000); }
+    // 10 kHz..4 MHz, the datasheet allows up to 1 MHz
+    uint32_t set_clock(uint32_t hz) override;
+
+    // Environment. Load current is what the load or charger would draw, charge positive;
+    // it only flows through the FET that is on.
+    void set_load(double current_A);
+    void set_charger(bool connected);
+    void set_load_connected(bool connected);
+    void set_pupin(bool low);
+    // Capacitance on the load side, charged through D_FET, bled off with the time constant while
+    // the FET is off. 0 removes it.
+    void set_load_capacitance(double uF, double bleed_ms);
+    double load_V() const { return _cap_V; }
+    double inrush() const { return _inrush_A; }
+    // Energy the FETs took while not fully enhanced
+    double fet_J() const { return _fet_J; }
+    // Board margin drifting, e.g. with temperature
+    void set_spi_limit(uint32_t hz) {
+        _cfg.spi_limit_hz = hz;
+        set_clock(_cfg.spi_hz);
+    }
+
+    void advance(uint64_t ns);
+
+    ML5238_Pack &pack() { return _pack; }
+    const ML5238_Pack &pack() const { return _pack; }
+    const ML5238_SimConfig &config() const { return _cfg; }
+    double current() const;
+    double load() const { return _load_A; }
+    uint64_t now_ns() const { return _now_ns; }
+    uint8_t peek(uint8_t reg) const;
+    bool int_pin() const { return (peek(ml5238::REG_STATUS) & ml5238::STATUS_INT) != 0; }
+    bool powered_down() const { return _pdwn; }
+    uint16_t balance() const { return (uint16_t)(_r[ml5238::REG_CBALH] << 8 | _r[ml5238::REG_CBALL]); }
+    // Chip cell index of pack cell 0
+    uint8_t first_cell() const { return _first; }
+
+    uint32_t frames() const { return _frames; }
+    uint32_t bit_errors() const { return _bit_errors; }
+    uint32_t violations() const { return _violations; }
+    uint32_t short_trips() const { return _trips; }
+    uint64_t last_trip_ns() const { return _trip_ns; }
+    uint32_t wakes() const { return _wakes; }
+    uint64_t psv_ns() const;
+    uint64_t pdwn_ns() const;
+
+private:
+    void flush();
+    // Steps the load capacitance to end, the short detection can trip on the way
+    void settle(uint64_t end);
+    void write(uint8_t reg, uint8_t val);
+    void update_inputs();
+    void update_short();
+    void trip();
+    void enter_pdwn();
+    void wake();
+    uint16_t adc(double mV);
+    // Data byte as it arrives at the other end at the current clock
+    uint8_t line(uint8_t v);
+    bool psv() const { return (_r[ml5238::REG_POWER] & ml5238::POWER_PSV) != 0; }
+
+    ML5238_Pack &_pack;
+    ML5238_SimConfig _cfg;
+    uint8_t _first;
+    uint8_t _r[ml5238::REG_COUNT];  // R/W bits and latched interrupt bits
+    bool _psl;
+    bool _psh;
+    bool _rs;
+    double _load_A;
+    bool _charger;
+    bool _load_connected;
+    bool _pupin_low;
+    bool _pdwn;
+    bool _pdwn_pending;
+    bool _sc;
+    double _cap_uF;
+    double _bleed_ms;
+    double _cap_V;
+    double _gate;               // D_FET enhancement 0..1
+    double _inrush_A;
+    double _fet_J;
+    uint64_t _cap_ns;
+    uint64_t _now_ns;
+    uint64_t _pack_ns;
+    uint64_t _sc_trip_ns;
+    uint64_t _trip_ns;
+    uint64_t _psv_since_ns;
+    uint64_t _psv_ns;
+    uint64_t _pdwn_since_ns;
+    uint64_t _pdwn_ns;
+    uint32_t _frame_ns;
+    uint32_t _frames;
+    uint32_t _violations;
+    uint32_t _trips;
+    uint32_t _wakes;
+    uint32_t _bit_errors;
+    uint32_t _ber_q32;          // bit error probability, 1/2^32
+    uint32_t _rng;
+};
+
+}  // namespace drivers
@@ -0,0 +1,67 @@
+#include "ML5238_softdma.h"
+
+namespace drivers {
+
+bool ML5238_SoftDma::start(ML5238_Chain &chain, ML5238_DmaDone done, void *ctx) {
+    if (_chain) return false;
+    _chain = &chain;
+    _done = done;
+    _ctx = ctx;
+    _pc = 0;
+    _waiting = false;
+    return true;
+}
+
+bool ML5238_SoftDma::service() {
+    if (!_chain) return false;
+    ++_services;
+    if (_waiting) {
+        if ((int32_t)(_port.micros() - _due_us) < 0) return true;
+        _waiting = false;
+    }
+    ML5238_Chain &c = *_chain;
+    uint8_t tx[2 * ML5238_Chain::MAX_DESCS];
+    uint8_t rx[2 * ML5238_Chain::MAX_DESCS];
+    while (_pc < c.size()) {
+        const ML5238_Desc &d = c.desc(_pc);
+        switch (d.op) {
+        case ML5238_DESC_SPI: {
+            uint8_t n = 0;
+            while (_pc + n < c.size() && c.desc(_pc + n).op == ML5238_DESC_SPI) {
+                tx[2 * n] = c.desc(_pc + n).arg;
+                tx[2 * n + 1] = (uint8_t)c.desc(_pc + n).data;
+                ++n;
+            }
+            _port.transfer(tx, rx, n);
+            for (uint8_t i = 0; i < n; ++i) c.set_rx(_pc + i, rx[2 * i + 1]);
+            _pc += n;
+            ++_bursts;
+            break;
+        }
+        case ML5238_DESC_WAIT:
+            ++_pc;
+            _due_us = _port.micros() + d.data;
+            _waiting = true;
+            return true;
+        case ML5238_DESC_VMON:
+            c.set_sample(d.arg, _port.vmon_mV());
+            ++_samples;
+            ++_pc;
+            break;
+        case ML5238_DESC_IMON:
+            c.set_sample(d.arg, _port.imon_mV());
+            ++_samples;
+            ++_pc;
+            break;
+        default:
+            _pc = c.size();
+            break;
+        }
+    }
+    // END or the end of the descriptors
+    _chain = nullptr;
+    if (_done) _done(_ctx);
+    return false;
+}
+
+}  // namespace drivers
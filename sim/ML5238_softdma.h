@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include "../ML5238.h"
+
+namespace drivers {
+
+// Software stand-in for the MCU's timer triggered DMA, on top of a ML5238_Port. service() plays
+// the engine: it runs descriptors until the next wait and is called again once that wait is
+// due, the way a timer compare would retrigger the hardware. Runs of SPI descriptors go out as
+// one port transfer, like a DMA burst.
+class ML5238_SoftDma : public ML5238_DmaEngine {
+public:
+    explicit ML5238_SoftDma(ML5238_Port &port)
+        : _port(port), _chain(nullptr), _done(nullptr), _ctx(nullptr), _pc(0), _due_us(0), _waiting(false),
+          _bursts(0), _samples(0), _services(0) {}
+
+    bool start(ML5238_Chain &chain, ML5238_DmaDone done, void *ctx) override;
+    bool busy() const override { return _chain != nullptr; }
+
+    // Runs what is due, false once idle
+    bool service();
+    // micros() at which the pending wait ends
+    uint32_t due_us() const { return _due_us; }
+
+    // Engine activity, none of it on the CPU with a hardware engine
+    uint32_t bursts() const { return _bursts; }
+    uint32_t samples() const { return _samples; }
+    uint32_t services() const { return _services; }
+
+private:
+    ML5238_Port &_port;
+    ML5238_Chain *_chain;
+    ML5238_DmaDone _done;
+    void *_ctx;
+    uint8_t _pc;
+    uint32_t _due_us;
+    bool _waiting;
+    uint32_t _bursts;
+    uint32_t _samples;
+    uint32_t _services;
+};
+
+}  // namespace drivers
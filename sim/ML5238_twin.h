@@ -0,0 +1,130 @@
+#pragma once
+
+#include <stdint.h>
+#include "../ML5238.h"
+#include "ML5238_sim.h"
+
+namespace drivers {
+
+struct ML5238_TwinStats {
+    double   sim_s;
+    uint32_t ticks;
+    uint32_t overruns;          // ticks whose bus and ADC time exceeded the period
+    uint32_t ov_events;
+    uint32_t uv_events;
+    double   latency_max_s;     // true cell limit crossing to FET off
+    double   latency_sum_s;
+    uint32_t sc_events;
+    double   sc_latency_max_s;  // LSI short trip to the driver reporting ML5238_FAULT_SC
+    double   soc_err_max;       // |driver SOC - mean true SOC|, 0..1
+    double   soc_err_sum;
+};
+
+// Runs a ML5238 driver against the simulator at a fixed control period. The profile returns
+// the current the load or charger wants at time t, charge positive.
+class ML5238_Twin {
+public:
+    typedef double (*Profile)(double t_s, void *ctx);
+
+    ML5238_Twin(ML5238_Sim &sim, ML5238 &bms, uint32_t tick_us = 10000)
+        : _sim(sim), _bms(bms), _tick_ns((uint64_t)tick_us * 1000), _ov_since(-1.0), _uv_since(-1.0),
+          _trips(sim.short_trips()) {
+        _stats = ML5238_TwinStats();
+    }
+
+    void run(double seconds, Profile profile, void *ctx) {
+        const double end = now_s() + seconds;
+        while (now_s() < end) step(profile(now_s(), ctx));
+    }
+
+    void step(double load_A) {
+        const uint64_t start = _sim.now_ns();
+        _sim.set_charger(load_A > 0.0);
+        _sim.set_load(load_A);
+        bool ov, uv;
+        limits(ov, uv);
+        const uint8_t before = _sim.peek(ml5238::REG_FET);
+        _bms.tick();
+        const uint8_t after = _sim.peek(ml5238::REG_FET);
+        const uint8_t faults = _bms.state().faults;
+        watch(ov, faults & ML5238_FAULT_OV, before & ml5238::FET_CF, after & ml5238::FET_CF, start, _ov_since,
+              _stats.ov_events);
+        watch(uv, faults & ML5238_FAULT_UV, before & ml5238::FET_DF, after & ml5238::FET_DF, start, _uv_since,
+              _stats.uv_events);
+        const uint64_t used = _sim.now_ns() - start;
+        if (used < _tick_ns) _sim.advance(_tick_ns - used);
+        else ++_stats.overruns;
+        ++_stats.ticks;
+        _stats.sim_s += (double)(_sim.now_ns() - start) * 1e-9;
+        observe();
+    }
+
+    double now_s() const { return (double)_sim.now_ns() * 1e-9; }
+
+    double true_soc() const {
+        const ML5238_Pack &p = _sim.pack();
+        double s = 0.0;
+        for (uint8_t i = 0; i < p.cells(); ++i) s += p.cell(i).soc;
+        return p.cells() ? s / p.cells() : 0.0;
+    }
+
+    const ML5238_TwinStats &stats() const { return _stats; }
+
+private:
+    // True cell voltages against the driver limits, with the current flowing at tick start
+    void limits(bool &ov, bool &uv) const {
+        const ML5238_Pack &p = _sim.pack();
+        const double i = _sim.current();
+        double vmax = 0.0, vmin = 10.0;
+        for (uint8_t c = 0; c < p.cells(); ++c) {
+            const double v = p.terminal_V(c, i);
+            if (v > vmax) vmax = v;
+            if (v < vmin) vmin = v;
+        }
+        ov = vmax * 1000.0 >= _bms.config().cell_ov_mV;
+        uv = vmin * 1000.0 <= _bms.config().cell_uv_mV;
+    }
+
+    void observe() {
+        if (_sim.short_trips() != _trips && (_bms.state().faults & ML5238_FAULT_SC)) {
+            // The driver sees RSC in the STATUS read at the start of its tick
+            const uint32_t us = _bms.state().time_us - (uint32_t)(_sim.last_trip_ns() / 1000);
+            const double l = us * 1e-6;
+            if (l > _stats.sc_latency_max_s) _stats.sc_latency_max_s = l;
+            ++_stats.sc_events;
+            _trips = _sim.short_trips();
+        }
+
+        double err = _bms.state().soc_permille / 1000.0 - true_soc();
+        if (err < 0.0) err = -err;
+        if (err > _stats.soc_err_max) _stats.soc_err_max = err;
+        _stats.soc_err_sum += err;
+    }
+
+    // Latency runs from the first tick start with the limit crossed to the FET write, so it has
+    // a resolution of one period. A trip on measurement error before the true crossing counts
+    // from the start of its tick.
+    void watch(bool crossed, bool fault, bool was_on, bool is_on, uint64_t start, double &since,
+               uint32_t &events) {
+        if ((crossed || fault) && was_on && since < 0.0) since = (double)start * 1e-9;
+        if (since >= 0.0 && !is_on) {
+            const double l = now_s() - since;
+            if (l > _stats.latency_max_s) _stats.latency_max_s = l;
+            _stats.latency_sum_s += l;
+            ++events;
+            since = -1.0;
+        } else if (!crossed) {
+            since = -1.0;
+        }
+    }
+
+    ML5238_Sim &_sim;
+    ML5238 &_bms;
+    uint64_t _tick_ns;
+    double _ov_since;
+    double _uv_since;
+    uint32_t _trips;
+    ML5238_TwinStats _stats;
+};
+
+}  // namespace drivers
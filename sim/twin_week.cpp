@@ -0,0 +1,47 @@
+// One simulated week of a 16 cell module: daily CC charge, evening discharge, rest.
+// g++ -O2 -std=c++11 twin_week.cpp ML5238_sim.cpp ../*.cpp -o twin_week
+
+#include <stdio.h>
+#include <time.h>
+#include "ML5238_twin.h"
+
+using namespace drivers;
+
+static double daily(double t_s, void *) {
+    const double h = t_s / 3600.0 - 24.0 * (int)(t_s / 86400.0);
+    if (h < 6.0) return 8.0;                    // night charge
+    if (h >= 18.0 && h < 21.0) return -12.0;    // evening load
+    return 0.0;
+}
+
+int main() {
+    ML5238_Pack pack(16);
+    for (uint8_t i = 0; i < pack.cells(); ++i) {
+        pack.cell(i).soc = 0.45 + 0.004 * i;
+        pack.cell(i).capacity_As *= 1.0 - 0.003 * (i % 5);
+    }
+    ML5238_Sim sim(pack);
+    ML5238 bms(sim);
+    bms.begin(ML5238_Config());
+    bms.set_fets(true, true);
+    ML5238_Twin twin(sim, bms, 100000);
+
+    const clock_t c0 = clock();
+    twin.run(7 * 86400.0, daily, 0);
+    const double cpu = (double)(clock() - c0) / CLOCKS_PER_SEC;
+
+    const ML5238_TwinStats &s = twin.stats();
+    printf("simulated %.0f s in %.2f s cpu, %.0fx real time\n", s.sim_s, cpu, s.sim_s / cpu);
+    printf("ticks %u overruns %u bus frames %u violations %u\n", s.ticks, s.overruns, sim.frames(),
+           sim.violations());
+    printf("balancing %.0f J, OV events %u, UV events %u, max latency %.3f s\n", pack.balance_J(),
+           s.ov_events, s.uv_events, s.latency_max_s);
+    printf("SOC error max %.3f mean %.4f\n", s.soc_err_max, s.ticks ? s.soc_err_sum / s.ticks : 0.0);
+    double lo = 1.0, hi = 0.0;
+    for (uint8_t i = 0; i < pack.cells(); ++i) {
+        if (pack.cell(i).soc < lo) lo = pack.cell(i).soc;
+        if (pack.cell(i).soc > hi) hi = pack.cell(i).soc;
+    }
+    printf("cell SOC spread %.4f\n", hi - lo);
+    return 0;
+}